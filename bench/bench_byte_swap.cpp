@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bytestream/byte_swap.hpp"
+#include "bench_helpers.hpp"
+
+// Byte at a time, as a serialiser swapping each element on its own does
+template <size_t Size>
+static void copy_swapped_bytewise(uint8_t *dst, const uint8_t *src, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < Size; ++b) {
+            dst[i * Size + b] = src[i * Size + Size - 1 - b];
+        }
+    }
+}
+
+template <size_t Size>
+static void bench_size() {
+    for (const size_t bytes : {1024, 64 * 1024, 1 << 20, 16 << 20}) {
+        const size_t count = bytes / Size;
+        const auto source = random_payload(bytes + 1, 0);
+        std::vector<uint8_t> destination(bytes + 1);
+        // Off by one from the allocation, so neither side is aligned
+        const uint8_t *src = source.data() + 1;
+        uint8_t *dst = destination.data() + 1;
+
+        const double copy = time_per_call([&] {
+            std::memcpy(dst, src, bytes - 1);
+            do_not_optimise(dst);
+        });
+        const double bytewise = time_per_call([&] {
+            copy_swapped_bytewise<Size>(dst, src, count - 1);
+            do_not_optimise(dst);
+        });
+        const double swapped = time_per_call([&] {
+            bytestream::detail::copy_swapped<Size>(dst, src, count - 1);
+            do_not_optimise(dst);
+        });
+        std::printf("%6zu %10zu %10.2f %10.2f %10.2f\n", Size, bytes, gigabytes_per_second(bytes, copy),
+                    gigabytes_per_second(bytes, bytewise), gigabytes_per_second(bytes, swapped));
+    }
+}
+
+int main() {
+    std::printf("Byte swapping copy, unaligned (GB/s)\n");
+    std::printf("%6s %10s %10s %10s %10s\n", "size", "bytes", "memcpy", "bytewise", "swapped");
+    bench_size<2>();
+    bench_size<4>();
+    bench_size<8>();
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bytestream/COBS.hpp"
+#include "bench_helpers.hpp"
+
+static void bench_encode() {
+    std::printf("COBS encode (GB/s of payload)\n");
+    std::printf("%10s %12s %10s %10s %8s\n", "size", "zeros", "generic", "span", "speedup");
+
+    for (const size_t size : {64, 1024, 4096, 65536, 1 << 20}) {
+        for (const unsigned zero_one_in : {0u, 1000u, 64u, 4u}) {
+            const auto payload = random_payload(size, zero_one_in);
+            std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+
+            const double generic = time_per_call([&] {
+                do_not_optimise(cobs_encode_frame(payload.begin(), payload.end(), encoded.begin()));
+            });
+            const double span = time_per_call([&] {
+                do_not_optimise(cobs_encode_frame(payload, encoded.data()));
+            });
+
+            char zeros[16];
+            std::snprintf(zeros, sizeof zeros, zero_one_in ? "1 in %u" : "none", zero_one_in);
+            std::printf("%10zu %12s %10.2f %10.2f %7.1fx\n", size, zeros,
+                        gigabytes_per_second(size, generic), gigabytes_per_second(size, span), generic / span);
+        }
+    }
+}
+
+static void bench_decode() {
+    std::printf("\nCOBS decode (GB/s of payload)\n");
+    std::printf("%10s %12s %10s %10s %10s %8s\n", "size", "zeros", "generic", "span", "in place", "speedup");
+
+    for (const size_t size : {64, 1024, 4096, 65536, 1 << 20}) {
+        for (const unsigned zero_one_in : {0u, 1000u, 64u, 4u}) {
+            const auto payload = random_payload(size, zero_one_in);
+            std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+            encoded.resize(cobs_encode_frame(payload, encoded.data()));
+            std::vector<uint8_t> decoded(encoded.size());
+            std::vector<uint8_t> scratch(encoded.size());
+
+            const double generic = time_per_call([&] {
+                do_not_optimise(cobs_decode_frame(encoded.begin(), encoded.end(), decoded.begin()));
+            });
+            const double span = time_per_call([&] {
+                do_not_optimise(cobs_decode_frame(encoded, decoded.data()));
+            });
+            // In place decoding destroys its input, so each call starts by restoring it
+            const double restore = time_per_call([&] {
+                std::memcpy(scratch.data(), encoded.data(), encoded.size());
+                do_not_optimise(scratch.data());
+            });
+            const double in_place = time_per_call([&] {
+                std::memcpy(scratch.data(), encoded.data(), encoded.size());
+                do_not_optimise(cobs_decode_frame_in_place(scratch));
+            }) - restore;
+
+            char zeros[16];
+            std::snprintf(zeros, sizeof zeros, zero_one_in ? "1 in %u" : "none", zero_one_in);
+            std::printf("%10zu %12s %10.2f %10.2f %10.2f %7.1fx\n", size, zeros,
+                        gigabytes_per_second(size, generic), gigabytes_per_second(size, span),
+                        gigabytes_per_second(size, in_place), generic / span);
+        }
+    }
+}
+
+int main() {
+    bench_encode();
+    bench_decode();
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "bytestream/COBS.hpp"
+#include "bytestream/parallel_cobs.hpp"
+#include "bench_helpers.hpp"
+
+// Scaling from 1 to N threads, with the sequential span codec as the baseline
+int main() {
+    const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("Parallel COBS (GB/s of payload, speedup over sequential in brackets)\n");
+
+    for (const size_t size : {1 << 20, 4 << 20, 16 << 20}) {
+        for (const unsigned zero_one_in : {0u, 1000u, 64u}) {
+            const auto payload = random_payload(size, zero_one_in);
+            std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+            encoded.resize(cobs_encode_frame(payload, encoded.data()));
+            std::vector<uint8_t> scratch(cobs_encoded_max_length(size));
+
+            const double sequential_encode = time_per_call([&] {
+                do_not_optimise(cobs_encode_frame(payload, scratch.data()));
+            });
+            const double sequential_decode = time_per_call([&] {
+                do_not_optimise(cobs_decode_frame(encoded, scratch.data()));
+            });
+
+            char zeros[16];
+            std::snprintf(zeros, sizeof zeros, zero_one_in ? "1 in %u" : "none", zero_one_in);
+            std::printf("\n%zu MB, zeros %s: sequential encode %.2f, decode %.2f\n", size >> 20, zeros,
+                        gigabytes_per_second(size, sequential_encode), gigabytes_per_second(size, sequential_decode));
+            std::printf("%8s %18s %18s\n", "threads", "encode", "decode");
+
+            for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+                worker_pool pool(threads);
+                const double encode = time_per_call([&] {
+                    do_not_optimise(cobs_encode_frame_parallel(payload, scratch.data(), pool));
+                });
+                const double decode = time_per_call([&] {
+                    do_not_optimise(cobs_decode_frame_parallel(encoded, scratch.data(), pool));
+                });
+                std::printf("%8u %10.2f (%4.1fx) %10.2f (%4.1fx)\n", threads,
+                            gigabytes_per_second(size, encode), sequential_encode / encode,
+                            gigabytes_per_second(size, decode), sequential_decode / decode);
+                if (threads < max_threads && threads * 2 > max_threads) {
+                    threads = max_threads / 2; // finish on the full thread count
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "bytestream/delta_record.hpp"
+#include "bench_helpers.hpp"
+
+static std::vector<uint8_t> as_bytes(const std::vector<float> &values) {
+    std::vector<uint8_t> bytes(values.size() * sizeof(float));
+    std::memcpy(bytes.data(), values.data(), bytes.size());
+    return bytes;
+}
+
+// Encoding an f32[1024] record against the last, and decoding it again, alternating between two
+// records so every one differs. Also the bytes sent over the whole record.
+int main() {
+    std::printf("Delta records of an f32[1024] (GB/s of record)\n");
+    std::printf("%10s %10s %10s %12s\n", "change", "wire/raw", "encode", "round trip");
+
+    constexpr size_t count = 1024;
+    constexpr bool big = std::endian::native == std::endian::big;
+    const std::vector<size_t> element_sizes{4};
+    std::mt19937 rng(1);
+    std::vector<float> first(count);
+    for (auto &value : first) {
+        value = static_cast<float>(rng() % 1000) / 100;
+    }
+
+    for (const char *change : {"one", "drift", "random"}) {
+        auto second = first;
+        if (change[0] == 'o') {
+            second[count / 2] += 1;
+        } else {
+            for (auto &value : second) {
+                value = change[0] == 'd' ? value * 1.0001f : static_cast<float>(rng());
+            }
+        }
+        const std::vector<std::vector<uint8_t>> records{as_bytes(first), as_bytes(second)};
+        const std::vector<size_t> offsets{0, records[0].size()};
+
+        delta_encoder encoder(element_sizes, big);
+        std::vector<uint8_t> delta;
+        size_t n = 0;
+        encoder.encode(records[n++ % 2], offsets, false, delta);
+        const double encode = time_per_call([&] {
+            encoder.encode(records[n++ % 2], offsets, false, delta);
+            do_not_optimise(delta.data());
+        });
+        const double ratio = static_cast<double>(delta.size()) / static_cast<double>(records[0].size());
+
+        delta_decoder decoder(element_sizes, big);
+        encoder.reset();
+        const double round_trip = time_per_call([&] {
+            encoder.encode(records[n++ % 2], offsets, false, delta);
+            if (decoder.decode(delta) != delta_decoder::outcome::applied) {
+                std::printf("delta record not applied\n");
+                std::exit(1);
+            }
+            do_not_optimise(decoder.record().data());
+        });
+
+        std::printf("%10s %10.3f %10.2f %12.2f\n", change, ratio, gigabytes_per_second(records[0].size(), encode),
+                    gigabytes_per_second(records[0].size(), round_trip));
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+//
+// Minimal timing helpers shared by the benchmarks.
+//
+
+#ifndef BYTESTREAM_BENCH_HELPERS_HPP
+#define BYTESTREAM_BENCH_HELPERS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Keeps the optimiser from discarding a result.
+template <typename T>
+inline void do_not_optimise(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs fn repeatedly for at least min_time and returns the mean time per call in seconds.
+template <typename F>
+double time_per_call(F &&fn, std::chrono::duration<double> min_time = std::chrono::milliseconds(200)) {
+    using clock = std::chrono::steady_clock;
+    fn(); // warm up caches and branch predictors
+    size_t iterations = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+        fn();
+        ++iterations;
+        elapsed = clock::now() - start;
+    } while (elapsed < min_time);
+    return std::chrono::duration<double>(elapsed).count() / static_cast<double>(iterations);
+}
+
+inline double gigabytes_per_second(size_t bytes, double seconds) {
+    return static_cast<double>(bytes) / seconds / 1e9;
+}
+
+// Random payload in which roughly one byte in zero_one_in is zero (0 means no zeros at all).
+inline std::vector<uint8_t> random_payload(size_t size, unsigned zero_one_in, unsigned seed = 1) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> payload(size);
+    for (auto &byte : payload) {
+        byte = static_cast<uint8_t>(rng() % 255 + 1);
+        if (zero_one_in && rng() % zero_one_in == 0) {
+            byte = 0;
+        }
+    }
+    return payload;
+}
+
+#endif //BYTESTREAM_BENCH_HELPERS_HPP
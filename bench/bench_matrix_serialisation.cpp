@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bytestream/serialisation_plan.hpp"
+#include "bytestream/strided_copy.hpp"
+#include "bench_helpers.hpp"
+
+// Splits four-plane cells into planes an element at a time, for comparison with the kernels
+template <typename T>
+static void deinterleave_scalar(T *dst, size_t plane_length, const T *src, size_t cells) {
+    for (size_t i = 0; i < cells; ++i) {
+        for (size_t p = 0; p < 4; ++p) {
+            dst[p * plane_length + i] = src[i * 4 + p];
+        }
+    }
+}
+
+template <typename T>
+static void bench_planar(const char *type_name) {
+    for (const size_t width : {64, 640, 1920}) {
+        const size_t height = width * 9 / 16;
+        const size_t cells = width * height;
+        std::vector<T> matrix(cells * 4);
+        for (size_t i = 0; i < matrix.size(); ++i) {
+            matrix[i] = static_cast<T>(i);
+        }
+        std::vector<T> scalar(matrix.size());
+        std::vector<T> vector(matrix.size());
+
+        const auto kernel = bytestream::detail::deinterleave_elements_for<sizeof(T)>(false);
+        const auto run_kernel = [&] {
+            kernel(reinterpret_cast<uint8_t *>(vector.data()), cells * sizeof(T),
+                   reinterpret_cast<const uint8_t *>(matrix.data()), cells, 4);
+        };
+        deinterleave_scalar(scalar.data(), cells, matrix.data(), cells);
+        run_kernel();
+        if (scalar != vector) {
+            std::printf("planar output differs at %zux%zu\n", width, height);
+            std::exit(1);
+        }
+
+        const size_t bytes = matrix.size() * sizeof(T);
+        const double before = time_per_call([&] {
+            deinterleave_scalar(scalar.data(), cells, matrix.data(), cells);
+            do_not_optimise(scalar.data());
+        });
+        const double after = time_per_call([&] {
+            run_kernel();
+            do_not_optimise(vector.data());
+        });
+        std::printf("%8s %7zux%-4zu %12.2f %12.2f %7.1fx\n", type_name, width, height,
+                    gigabytes_per_second(bytes, before), gigabytes_per_second(bytes, after), before / after);
+    }
+}
+
+// A float32 jit matrix with its rows padded out, as Jitter may lay them out. Before, bs.tobytes
+// copied it row by row into the field's vector and then serialised that into a fresh buffer.
+// Then it serialised from the matrix in place into the previous bang's buffer, and loaded the
+// matrix into the field afterwards for later bangs; now it keeps the field's bytes from the
+// record instead.
+int main() {
+    std::printf("One-plane float32 matrix to one variable field, big endian\n");
+    std::printf("%12s %12s %12s %12s %8s\n", "dim", "copy (GB/s)", "then load", "then keep", "speedup");
+
+    for (const size_t width : {64, 640, 1920}) {
+        const size_t height = width * 9 / 16;
+        const size_t padded_width = (width + 15) / 16 * 16 + 16;
+        std::vector<float> matrix(padded_width * height);
+        for (size_t i = 0; i < matrix.size(); ++i) {
+            matrix[i] = static_cast<float>(i) * 0.5f;
+        }
+        const auto *data = reinterpret_cast<const uint8_t *>(matrix.data());
+        const auto row_stride = static_cast<ptrdiff_t>(padded_width * sizeof(float));
+
+        std::vector<float> field;
+        serialisation_plan plan(std::endian::native != std::endian::big);
+        plan.add_variable(field);
+        serialisation_plan::strided_source source;
+        source.data = data;
+        source.bytes = matrix.size() * sizeof(float);
+        source.dimcount = 2;
+        source.dim = {width, height};
+        source.stride = {sizeof(float), row_stride};
+
+        const auto load = [&] {
+            field.resize(width * height);
+            for (size_t row = 0; row < height; ++row) {
+                const float *start = matrix.data() + row * padded_width;
+                std::copy(start, start + width, field.begin() + static_cast<ptrdiff_t>(row * width));
+            }
+        };
+        const auto copy_then_write = [&] {
+            load();
+            std::vector<uint8_t> out;
+            plan.write(out);
+            return out;
+        };
+
+        std::vector<uint8_t> reused;
+        plan.write(reused, {&source, 1});
+        if (copy_then_write() != reused) {
+            std::printf("in-place output differs at %zux%zu\n", width, height);
+            return 1;
+        }
+        field.clear();
+
+        const size_t bytes = width * height * sizeof(float);
+        const double before = time_per_call([&] { do_not_optimise(copy_then_write().data()); });
+        const double loaded = time_per_call([&] {
+            plan.write(reused, {&source, 1});
+            do_not_optimise(reused.data());
+            load();
+            do_not_optimise(field.data());
+        });
+        std::vector<uint8_t> kept;
+        const double after = time_per_call([&] {
+            plan.write(reused, {&source, 1});
+            do_not_optimise(reused.data());
+            kept.assign(reused.begin() + static_cast<ptrdiff_t>(plan.prefix_size(0)), reused.end());
+            do_not_optimise(kept.data());
+        });
+        std::printf("%7zux%-4zu %12.2f %12.2f %12.2f %7.1fx\n", width, height, gigabytes_per_second(bytes, before),
+                    gigabytes_per_second(bytes, loaded), gigabytes_per_second(bytes, after), before / after);
+    }
+
+    std::printf("\nFour-plane matrix split into planes, native byte order\n");
+    std::printf("%8s %12s %12s %12s %8s\n", "type", "dim", "scalar", "kernel", "speedup");
+    bench_planar<uint8_t>("char");
+    bench_planar<float>("float32");
+}
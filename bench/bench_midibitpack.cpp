@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <span>
+#include <vector>
+
+#include "midibitpack.hpp"
+#include "bench_helpers.hpp"
+
+// Byte by byte, the way a patch of [expr] objects does it
+static size_t pack_bytewise(const std::vector<uint8_t> &input, uint8_t *output) {
+    uint8_t *out = output;
+    for (size_t i = 0; i < input.size(); i += 7) {
+        const size_t n = std::min<size_t>(7, input.size() - i);
+        uint8_t *header = out++;
+        *header = 0;
+        for (size_t j = 0; j < n; ++j) {
+            *header |= static_cast<uint8_t>((input[i + j] >> 7) << j);
+            *out++ = input[i + j] & 0x7F;
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+// Packing and unpacking, and the streaming decoder taking whole frames
+int main() {
+    std::printf("MIDI 7-bit packing (GB/s of payload)\n");
+    std::printf("%10s %10s %10s %10s %10s\n", "size", "pack ref", "pack", "unpack", "decoder");
+
+    for (const size_t size : {64, 1024, 4096, 65536, 1 << 20}) {
+        const auto payload = random_payload(size, 0);
+        std::vector<uint8_t> packed(midi_packed_length(size));
+        std::vector<uint8_t> unpacked(size);
+
+        const double pack_ref = time_per_call([&] {
+            do_not_optimise(pack_bytewise(payload, packed.data()));
+        });
+        const double pack = time_per_call([&] {
+            do_not_optimise(midi_pack(payload, packed.data()));
+        });
+        const double unpack = time_per_call([&] {
+            do_not_optimise(midi_unpack(packed, unpacked.data()));
+        });
+        if (unpacked != payload) {
+            std::printf("unpacked payload differs for %zu bytes\n", size);
+            return 1;
+        }
+
+        std::vector<uint8_t> frame(midi_sysex_encoded_length(size));
+        frame.resize(midi_sysex_encode_frame(payload, frame.data()));
+        MIDISysExDecoder decoder;
+        size_t decoded = 0;
+        const double decode = time_per_call([&] {
+            decoder.process(frame, [&decoded](std::span<const uint8_t> f) { decoded += f.size(); });
+        });
+        do_not_optimise(decoded);
+
+        std::printf("%10zu %10.2f %10.2f %10.2f %10.2f\n", size, gigabytes_per_second(size, pack_ref),
+                    gigabytes_per_second(size, pack), gigabytes_per_second(size, unpack),
+                    gigabytes_per_second(size, decode));
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <bit>
+#include <cstdio>
+#include <variant>
+#include <vector>
+
+#include "zpp_bits.h"
+
+#include "bytestream/serialisation_plan.hpp"
+#include "bench_helpers.hpp"
+
+// Stand-in for the externals' storage: a variant of typed vectors, serialised field by field the
+// way bs.tobytes did before it had a plan. Max types are kept out so this builds on its own.
+template <typename T>
+struct field {
+    std::vector<T> data;
+
+    constexpr static auto serialize(auto &archive, field &self) {
+        return archive(zpp::bits::unsized(self.data));
+    }
+};
+
+using field_variant = std::variant<field<uint8_t>, field<int16_t>, field<uint32_t>, field<float>, field<double>>;
+
+struct any_field {
+    field_variant v;
+
+    constexpr static auto serialize(auto &archive, any_field &self) {
+        return std::visit([&archive](auto &f) { return archive(f); }, self.v);
+    }
+};
+
+enum class Endianness { Big, Little, Network, Native };
+
+static void serialise_per_field(std::vector<any_field> &fields, Endianness endianness, std::vector<uint8_t> &out) {
+    switch (endianness) {
+        case Endianness::Big:
+            zpp::bits::out{out, zpp::bits::endian::big{}}(zpp::bits::unsized(fields)).or_throw();
+            break;
+        case Endianness::Little:
+            zpp::bits::out{out, zpp::bits::endian::little{}}(zpp::bits::unsized(fields)).or_throw();
+            break;
+        case Endianness::Network:
+            zpp::bits::out{out, zpp::bits::endian::network{}}(zpp::bits::unsized(fields)).or_throw();
+            break;
+        case Endianness::Native:
+            zpp::bits::out{out}(zpp::bits::unsized(fields)).or_throw();
+            break;
+    }
+}
+
+// A schema of count fields cycling through the types, each elements long
+static std::vector<any_field> make_schema(size_t count, size_t elements) {
+    std::vector<any_field> fields;
+    for (size_t i = 0; i < count; ++i) {
+        switch (i % 5) {
+            case 0: fields.push_back({field<uint8_t>{std::vector<uint8_t>(elements, 1)}}); break;
+            case 1: fields.push_back({field<int16_t>{std::vector<int16_t>(elements, -2)}}); break;
+            case 2: fields.push_back({field<uint32_t>{std::vector<uint32_t>(elements, 3)}}); break;
+            case 3: fields.push_back({field<float>{std::vector<float>(elements, 4.5f)}}); break;
+            default: fields.push_back({field<double>{std::vector<double>(elements, 5.25)}}); break;
+        }
+    }
+    return fields;
+}
+
+// Time for one bang's serialisation, into a fresh buffer as bs.tobytes does, big endian
+int main() {
+    std::printf("Serialisation per bang, big endian (ns)\n");
+    std::printf("%8s %10s %12s %12s %8s\n", "fields", "elements", "per field", "plan", "speedup");
+
+    for (const size_t elements : {1, 16}) {
+        for (const size_t count : {1, 16, 256}) {
+            auto fields = make_schema(count, elements);
+
+            serialisation_plan plan(std::endian::native != std::endian::big);
+            for (auto &f : fields) {
+                std::visit([&plan](auto &typed) { plan.add_fixed(typed.data.data(), typed.data.size()); }, f.v);
+            }
+
+            std::vector<uint8_t> check_before;
+            std::vector<uint8_t> check_after;
+            serialise_per_field(fields, Endianness::Big, check_before);
+            plan.write(check_after);
+            if (check_before != check_after) {
+                std::printf("plan output differs for %zu fields of %zu\n", count, elements);
+                return 1;
+            }
+
+            const double before = time_per_call([&] {
+                std::vector<uint8_t> out;
+                serialise_per_field(fields, Endianness::Big, out);
+                do_not_optimise(out.data());
+            });
+            const double after = time_per_call([&] {
+                std::vector<uint8_t> out;
+                plan.write(out);
+                do_not_optimise(out.data());
+            });
+            std::printf("%8zu %10zu %12.1f %12.1f %7.1fx\n", count, elements, before * 1e9, after * 1e9,
+                        before / after);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <vector>
+
+#include "bytestream/SLIP.hpp"
+#include "bench_helpers.hpp"
+
+int main() {
+    std::printf("SLIP (GB/s of payload)\n");
+    std::printf("%10s %12s %10s %10s %10s %10s\n", "size", "specials", "enc ref", "enc span", "dec ref", "dec span");
+
+    for (const size_t size : {64, 1024, 4096, 65536, 1 << 20}) {
+        for (const unsigned special_one_in : {0u, 1000u, 64u, 4u}) {
+            // random_payload places zeros; move them onto SLIP_END so they need escaping
+            auto payload = random_payload(size, special_one_in);
+            for (auto &byte : payload) {
+                if (byte == SLIP_END || byte == SLIP_ESC) {
+                    byte = 1;
+                } else if (byte == 0) {
+                    byte = SLIP_END;
+                }
+            }
+            std::vector<uint8_t> encoded(slip_encoded_max_length(size));
+            std::vector<uint8_t> decoded(size);
+
+            const double encode_ref = time_per_call([&] {
+                do_not_optimise(slip_encode_frame(payload.begin(), payload.end(), encoded.begin()));
+            });
+            const double encode_span = time_per_call([&] {
+                do_not_optimise(slip_encode_frame(payload, encoded.data()));
+            });
+            encoded.resize(slip_encode_frame(payload, encoded.data()));
+            const double decode_ref = time_per_call([&] {
+                do_not_optimise(slip_decode_frame(encoded.begin(), encoded.end(), decoded.begin()));
+            });
+            const double decode_span = time_per_call([&] {
+                do_not_optimise(slip_decode_frame(encoded, decoded.data()));
+            });
+
+            char specials[16];
+            std::snprintf(specials, sizeof specials, special_one_in ? "1 in %u" : "none", special_one_in);
+            std::printf("%10zu %12s %10.2f %10.2f %10.2f %10.2f\n", size, specials,
+                        gigabytes_per_second(size, encode_ref), gigabytes_per_second(size, encode_span),
+                        gigabytes_per_second(size, decode_ref), gigabytes_per_second(size, decode_span));
+        }
+    }
+    return 0;
+}
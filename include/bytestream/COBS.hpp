@@ -5,9 +5,16 @@
 #ifndef COBS_HPP
 #define COBS_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <iterator>
 #include <optional>
+#include <span>
+
+#include "byte_scan.hpp"
+#include "frame_buffer.hpp"
 
 template <typename InputIt, typename OutputIt>
 constexpr OutputIt cobs_encode_frame(InputIt first, InputIt last, OutputIt output) {
@@ -47,6 +54,121 @@ constexpr size_t cobs_encode_frame(InputIt first, size_t size, OutputIt output)
     return std::distance(output, cobs_encode_frame(first, first + size, output));
 }
 
+// Fast path for contiguous input, fed incrementally: push() the frame in as many pieces as is
+// convenient, then finish() it. Produces the same bytes as the iterator version given the
+// concatenated pieces, but finds each block boundary with a vectorised zero scan and writes
+// the block with a single memcpy. output must have room for cobs_encoded_max_length() of the
+// total pushed.
+class COBSEncoder {
+    uint8_t *output;
+    uint8_t *block_start;
+    uint8_t *out;
+public:
+    explicit COBSEncoder(uint8_t *output) : output(output), block_start(output), out(output + 1) {}
+
+    void push(std::span<const uint8_t> input) {
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+
+        while (first != last) {
+            auto block_length = static_cast<size_t>(out - block_start - 1);
+            if (block_length == 0xFE) {
+                // A full block is only closed once more input arrives; if none does, finish()
+                // closes it without opening another, exactly as the iterator version does.
+                *block_start = 0xFF;
+                block_start = out++;
+                block_length = 0;
+            }
+
+            const uint8_t *window_end = first + std::min<ptrdiff_t>(last - first, 0xFE - block_length);
+            const uint8_t *run_end = bytestream::detail::find_any<0>(first, window_end);
+            const auto run_length = static_cast<size_t>(run_end - first);
+            if (run_length < 16 && last - first >= 16) {
+                // Dense zeros: copy a fixed 16 bytes and let the next block overwrite the excess.
+                // The output never runs more than one code byte plus the 0xFF overheads ahead of
+                // the input, so this stays within cobs_encoded_max_length while 16 input bytes remain.
+                std::memcpy(out, first, 16);
+            } else if (run_length) {
+                std::memcpy(out, first, run_length);
+            }
+            out += run_length;
+            first = run_end;
+
+            if (run_end != window_end) {
+                *block_start = static_cast<uint8_t>(out - block_start);
+                block_start = out++;
+                ++first; // the zero that ended this block
+            }
+        }
+    }
+
+    // Closes the last block and appends the delimiter. Returns the encoded size.
+    size_t finish() {
+        *block_start = static_cast<uint8_t>(out - block_start);
+        *out++ = 0;
+        return static_cast<size_t>(out - output);
+    }
+
+    // Ends one piece of a frame that is encoded as independent pieces (see parallel_cobs.hpp).
+    // The input pushed so far must end on a block boundary, either just after a zero or with a
+    // full block; nothing is written beyond the returned size, so the next piece's encoding may
+    // start right there.
+    size_t finish_segment() {
+        if (out - block_start == 1) {
+            // Only the code byte reserved after the final zero, which belongs to the next piece
+            return static_cast<size_t>(block_start - output);
+        }
+        *block_start = 0xFF;
+        return static_cast<size_t>(out - output);
+    }
+};
+
+// One-shot form of COBSEncoder. output must have room for cobs_encoded_max_length(input.size()) bytes.
+inline size_t cobs_encode_frame(std::span<const uint8_t> input, uint8_t *output) {
+    COBSEncoder encoder(output);
+    encoder.push(input);
+    return encoder.finish();
+}
+
+// Headroom cobs_encode_frame_in_place() needs in front of a payload of the given length.
+[[nodiscard]] constexpr size_t cobs_in_place_headroom(size_t length) {
+    return 1 + (length + 253) / 254;
+}
+
+// Encodes the payload buffer[offset, buffer.size() - 1) into the start of buffer, returning the
+// encoded size. offset must be at least cobs_in_place_headroom() of the payload length, and the
+// last byte of buffer is room for the delimiter. The encoding never catches up with the unread
+// payload, so each block is found by scanning at most 254 bytes ahead and moved down in one go.
+inline size_t cobs_encode_frame_in_place(std::span<uint8_t> buffer, size_t offset) {
+    const uint8_t *first = buffer.data() + offset;
+    const uint8_t *const last = buffer.data() + buffer.size() - 1;
+    uint8_t *block_start = buffer.data();
+    uint8_t *out = block_start + 1;
+
+    for (;;) {
+        const uint8_t *window_end = first + std::min<size_t>(last - first, 0xFE);
+        const uint8_t *run_end = bytestream::detail::find_any<0>(first, window_end);
+        const auto run_length = static_cast<size_t>(run_end - first);
+        if (run_length) {
+            std::memmove(out, first, run_length);
+        }
+        out += run_length;
+        first = run_end;
+        if (first == last) {
+            break;
+        }
+        // Either a zero ended the block, or it is full and continues without one
+        *block_start = static_cast<uint8_t>(out - block_start);
+        block_start = out++;
+        if (first != window_end) {
+            ++first;
+        }
+    }
+    *block_start = static_cast<uint8_t>(out - block_start);
+    *out++ = 0;
+    return static_cast<size_t>(out - buffer.data());
+}
+
 template <typename InputIt, typename OutputIt>
 constexpr OutputIt cobs_decode_frame(InputIt first, InputIt last, OutputIt output) {
     using byte_type = typename std::iterator_traits<InputIt>::value_type;
@@ -73,11 +195,133 @@ constexpr size_t cobs_decode_frame(InputIt first, size_t size, OutputIt output)
     return std::distance(output, cobs_decode_frame(first, first + size, output));
 }
 
+// Fast path for contiguous input. Copies each block in one go rather than byte by byte, and
+// validates the frame in the same pass: returns std::nullopt if a code byte runs past the end of the
+// input or a block contains a zero. Decoding stops at the first delimiter, if there is one.
+// output may alias input.data() to decode in place, since the decoded bytes never overtake the
+// encoded ones; otherwise it needs room for input.size() bytes.
+[[nodiscard]] inline std::optional<size_t> cobs_decode_frame(std::span<const uint8_t> input, uint8_t *output) {
+    const uint8_t *first = input.data();
+    const uint8_t *const last = first + input.size();
+    uint8_t *out = output;
+
+    while (first != last) {
+        const uint8_t code = *first++;
+        if (!code) {
+            break;
+        }
+
+        const size_t block_length = code - 1;
+        if (block_length > static_cast<size_t>(last - first)) {
+            return std::nullopt;
+        }
+        if (!bytestream::detail::copy_if_none_of<0>(out, first, block_length)) {
+            return std::nullopt;
+        }
+        out += block_length;
+        first += block_length;
+
+        if (code != 0xFF && first != last && *first != 0) {
+            *out++ = 0;
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+// Decodes the frame at the start of buffer over the top of itself, returning the decoded size.
+[[nodiscard]] inline std::optional<size_t> cobs_decode_frame_in_place(std::span<uint8_t> buffer) {
+    return cobs_decode_frame(buffer, buffer.data());
+}
+
 class COBSDecoder {
     uint8_t block_remaining{0};
     uint8_t code{0xFF};
     bool packet_complete_flag{false};
+    bool oversized{false};
+    frame_buffer frame;
 public:
+    // Caps the decoded frame length, checksum trailer included, and allocates room for a frame
+    // that long up front. Longer frames are dropped.
+    void set_max_frame_length(size_t length) {
+        reset();
+        frame.set_max_size(length);
+    }
+
+    [[nodiscard]] constexpr size_t get_max_frame_length() const {
+        return frame.max_size();
+    }
+
+    // Decodes a chunk of the incoming stream, calling sink(std::span<const uint8_t>) once for
+    // every frame completed within it. The span is only valid for the duration of the call. A
+    // partial frame at the end of the chunk is carried over to the next call. A zero inside a
+    // block can only mean bytes were lost in transit, so the partial frame is dropped and
+    // decoding resyncs on the zero. A frame that outgrows the maximum length is dropped too,
+    // skipping straight to the next zero. If a checksum is given it is updated as each block is
+    // copied, and frames that fail it are dropped too; pass the same checksum object on every
+    // call. Returns the number of frames dropped. Don't mix with process_byte() on the same decoder.
+    template <typename Sink, typename Checksum = no_checksum>
+    size_t process(std::span<const uint8_t> input, Sink &&sink, Checksum &&checksum = {}) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        size_t dropped = 0;
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+        while (first != last) {
+            if (oversized) {
+                first = bytestream::detail::find_any<0>(first, last);
+                if (first == last) {
+                    break;
+                }
+                ++first;
+                checksum.reset();
+                reset();
+                ++dropped;
+                continue;
+            }
+
+            if (block_remaining) {
+                const size_t n = std::min<size_t>(block_remaining, last - first);
+                uint8_t *block = frame.extend(n);
+                if (!block) {
+                    oversized = true;
+                    continue;
+                }
+                if (!bytestream::detail::copy_if_none_of<0>(block, first, n)) {
+                    first = bytestream::detail::find_any<0>(first, first + n) + 1;
+                    checksum.reset();
+                    reset();
+                    ++dropped;
+                    continue;
+                }
+                checksum.update(block, n);
+                first += n;
+                block_remaining -= n;
+                continue;
+            }
+
+            const uint8_t next_code = *first++;
+            if (!next_code) {
+                dropped += !deliver_frame(frame.view(), sink, checksum);
+                reset();
+                continue;
+            }
+            if (code != 0xFF) {
+                uint8_t *zero = frame.extend(1);
+                if (!zero) {
+                    oversized = true;
+                    continue;
+                }
+                *zero = 0;
+                checksum.update(zero, 1);
+            }
+            code = next_code;
+            block_remaining = next_code - 1;
+        }
+        return dropped;
+    }
+
     template <typename Byte>
     [[nodiscard]] constexpr std::optional<Byte> process_byte(Byte byte) {
         if (packet_complete()) {
@@ -139,6 +383,8 @@ public:
         block_remaining = 0;
         code = 0xFF;
         packet_complete_flag = false;
+        oversized = false;
+        frame.clear();
     }
 };
 
@@ -146,5 +392,28 @@ public:
     return 2 + length + (length + 253) / 254;
 }
 
+// Exact size of cobs_encode_frame(input), delimiter included. Walks the blocks the encoder would
+// produce without writing anything.
+[[nodiscard]] inline size_t cobs_encoded_length(std::span<const uint8_t> input) {
+    const uint8_t *first = input.data();
+    const uint8_t *const last = first + input.size();
+    size_t blocks = 1;
+    size_t zeros = 0;
+
+    for (;;) {
+        const uint8_t *window_end = first + std::min<ptrdiff_t>(last - first, 0xFE);
+        first = bytestream::detail::find_any<0>(first, window_end);
+        if (first == last) {
+            break;
+        }
+        ++blocks;
+        if (first != window_end) {
+            ++zeros;
+            ++first;
+        }
+    }
+    return input.size() - zeros + blocks + 1;
+}
+
 
 #endif //COBS_HPP
\ No newline at end of file
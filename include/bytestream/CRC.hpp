@@ -0,0 +1,246 @@
+//
+// CRC trailers for the framing codecs: CRC-8/SMBUS, CRC-16/CCITT-FALSE and CRC-32C.
+//
+
+#ifndef CRC_HPP
+#define CRC_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <variant>
+
+#include "cpu_features.hpp"
+#include "frame_buffer.hpp"
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+// All checksums share no_checksum's interface (see frame_buffer.hpp), so the codecs can take
+// any of them, or no_checksum, as a template parameter. The trailer is written so that running
+// the checksum over payload + trailer leaves a fixed residue; a receiver can therefore verify a
+// frame without knowing where the payload ends.
+
+namespace bytestream::detail {
+
+// Tables for slice-by-8: tables[k][b] is the CRC of byte b followed by k zero bytes.
+template <typename T, T Poly, bool Reflected>
+constexpr auto make_crc_tables() {
+    constexpr int width = sizeof(T) * 8;
+    std::array<std::array<T, 256>, 8> tables{};
+    for (unsigned b = 0; b < 256; ++b) {
+        T crc;
+        if constexpr (Reflected) {
+            crc = static_cast<T>(b);
+            for (int i = 0; i < 8; ++i) {
+                crc = static_cast<T>(crc & 1 ? (crc >> 1) ^ Poly : crc >> 1);
+            }
+        } else {
+            crc = static_cast<T>(static_cast<T>(b) << (width - 8));
+            for (int i = 0; i < 8; ++i) {
+                crc = static_cast<T>(crc >> (width - 1) ? (crc << 1) ^ Poly : crc << 1);
+            }
+        }
+        tables[0][b] = crc;
+    }
+    for (size_t k = 1; k < 8; ++k) {
+        for (unsigned b = 0; b < 256; ++b) {
+            const T previous = tables[k - 1][b];
+            if constexpr (Reflected) {
+                tables[k][b] = static_cast<T>((previous >> 8) ^ tables[0][previous & 0xFF]);
+            } else if constexpr (width == 8) {
+                tables[k][b] = tables[0][previous];
+            } else {
+                tables[k][b] = static_cast<T>((previous << 8) ^ tables[0][previous >> (width - 8)]);
+            }
+        }
+    }
+    return tables;
+}
+
+inline uint32_t load_le32(const uint8_t *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof value);
+    if constexpr (std::endian::native == std::endian::big) {
+        value = __builtin_bswap32(value);
+    }
+    return value;
+}
+
+#if defined(BYTESTREAM_X86_DISPATCH) && defined(__x86_64__)
+// The SSE4.2 crc32 instruction computes CRC-32C, eight bytes at a time
+BYTESTREAM_TARGET("sse4.2")
+inline uint32_t crc32c_sse42(uint32_t crc, const uint8_t *data, size_t n) {
+    uint64_t crc64 = crc;
+    for (; n >= 8; data += 8, n -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof word);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; n; ++data, --n) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+} // namespace bytestream::detail
+
+class CRC8 {
+    static constexpr auto tables = bytestream::detail::make_crc_tables<uint8_t, 0x07, false>();
+    uint8_t state{0};
+
+public:
+    static constexpr size_t size = 1;
+
+    void update(const uint8_t *data, size_t n) {
+        uint8_t crc = state;
+        for (; n >= 8; data += 8, n -= 8) {
+            crc = tables[7][data[0] ^ crc] ^ tables[6][data[1]] ^ tables[5][data[2]] ^ tables[4][data[3]]
+                ^ tables[3][data[4]] ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+        }
+        for (; n; ++data, --n) {
+            crc = tables[0][*data ^ crc];
+        }
+        state = crc;
+    }
+
+    [[nodiscard]] uint8_t value() const { return state; }
+    [[nodiscard]] bool valid() const { return state == 0; }
+    void reset() { state = 0; }
+
+    template <typename OutputIt>
+    OutputIt write(OutputIt output) const {
+        *output++ = state;
+        return output;
+    }
+};
+
+class CRC16 {
+    static constexpr auto tables = bytestream::detail::make_crc_tables<uint16_t, 0x1021, false>();
+    uint16_t state{0xFFFF};
+
+public:
+    static constexpr size_t size = 2;
+
+    void update(const uint8_t *data, size_t n) {
+        uint16_t crc = state;
+        for (; n >= 8; data += 8, n -= 8) {
+            crc = tables[7][data[0] ^ (crc >> 8)] ^ tables[6][data[1] ^ (crc & 0xFF)]
+                ^ tables[5][data[2]] ^ tables[4][data[3]] ^ tables[3][data[4]]
+                ^ tables[2][data[5]] ^ tables[1][data[6]] ^ tables[0][data[7]];
+        }
+        for (; n; ++data, --n) {
+            crc = static_cast<uint16_t>((crc << 8) ^ tables[0][(crc >> 8) ^ *data]);
+        }
+        state = crc;
+    }
+
+    [[nodiscard]] uint16_t value() const { return state; }
+    [[nodiscard]] bool valid() const { return state == 0; }
+    void reset() { state = 0xFFFF; }
+
+    // Big-endian, matching the bit order the register shifts in
+    template <typename OutputIt>
+    OutputIt write(OutputIt output) const {
+        *output++ = static_cast<uint8_t>(state >> 8);
+        *output++ = static_cast<uint8_t>(state);
+        return output;
+    }
+};
+
+class CRC32C {
+    static constexpr auto tables = bytestream::detail::make_crc_tables<uint32_t, 0x82F63B78, true>();
+    // Kept un-inverted; value() applies the final xor
+    uint32_t state{0xFFFFFFFF};
+
+public:
+    static constexpr size_t size = 4;
+    static constexpr uint32_t residue = 0x48674BC7;
+
+    void update(const uint8_t *data, size_t n) {
+        uint32_t crc = state;
+#if defined(BYTESTREAM_X86_DISPATCH) && defined(__x86_64__)
+        if (bytestream::detail::cpu_has_sse42()) {
+            state = bytestream::detail::crc32c_sse42(crc, data, n);
+            return;
+        }
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+        for (; n >= 8; data += 8, n -= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof word);
+            crc = __crc32cd(crc, word);
+        }
+        for (; n; ++data, --n) {
+            crc = __crc32cb(crc, *data);
+        }
+#else
+        using bytestream::detail::load_le32;
+        for (; n >= 8; data += 8, n -= 8) {
+            const uint32_t lo = crc ^ load_le32(data);
+            const uint32_t hi = load_le32(data + 4);
+            crc = tables[7][lo & 0xFF] ^ tables[6][(lo >> 8) & 0xFF] ^ tables[5][(lo >> 16) & 0xFF] ^ tables[4][lo >> 24]
+                ^ tables[3][hi & 0xFF] ^ tables[2][(hi >> 8) & 0xFF] ^ tables[1][(hi >> 16) & 0xFF] ^ tables[0][hi >> 24];
+        }
+        for (; n; ++data, --n) {
+            crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xFF];
+        }
+#endif
+        state = crc;
+    }
+
+    [[nodiscard]] uint32_t value() const { return ~state; }
+    [[nodiscard]] bool valid() const { return value() == residue; }
+    void reset() { state = 0xFFFFFFFF; }
+
+    // Little-endian, matching the reflected bit order
+    template <typename OutputIt>
+    OutputIt write(OutputIt output) const {
+        const uint32_t crc = value();
+        for (int shift = 0; shift < 32; shift += 8) {
+            *output++ = static_cast<uint8_t>(crc >> shift);
+        }
+        return output;
+    }
+};
+
+// Pushes payload and then its checksum trailer into a streaming encoder. The checksum is updated
+// a cache-sized chunk at a time just before the encoder consumes the same chunk, so the payload
+// is only streamed in from memory once.
+template <typename Encoder, typename Checksum>
+void push_with_checksum(Encoder &encoder, std::span<const uint8_t> payload, Checksum &checksum) {
+    constexpr size_t chunk_size = 4096;
+    for (size_t offset = 0; offset < payload.size(); offset += chunk_size) {
+        const auto chunk = payload.subspan(offset, std::min(chunk_size, payload.size() - offset));
+        checksum.update(chunk.data(), chunk.size());
+        encoder.push(chunk);
+    }
+    std::array<uint8_t, Checksum::size> trailer{};
+    checksum.write(trailer.begin());
+    encoder.push(trailer);
+}
+
+// Runtime choice of checksum, for objects that pick one with an attribute. Alternatives are in
+// the order of the attribute's enum, so make_checksum() can index straight into them.
+using any_checksum = std::variant<no_checksum, CRC8, CRC16, CRC32C>;
+
+inline any_checksum make_checksum(size_t index) {
+    any_checksum checksum;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        ((index == I ? (void) checksum.emplace<I>() : void()), ...);
+    }(std::make_index_sequence<std::variant_size_v<any_checksum>>{});
+    return checksum;
+}
+
+[[nodiscard]] constexpr size_t checksum_size(const any_checksum &checksum) {
+    return std::visit([](const auto &c) { return c.size; }, checksum);
+}
+
+#endif //CRC_HPP
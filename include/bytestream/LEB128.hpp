@@ -0,0 +1,357 @@
+//
+// Length-prefixed framing: an unsigned LEB128 length followed by the raw payload.
+//
+
+#ifndef LEB128_HPP
+#define LEB128_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "frame_buffer.hpp"
+
+[[nodiscard]] constexpr size_t leb128_length(uint64_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++length;
+    }
+    return length;
+}
+
+template <typename OutputIt>
+constexpr OutputIt leb128_encode(uint64_t value, OutputIt output) {
+    while (value >= 0x80) {
+        *output++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *output++ = static_cast<uint8_t>(value);
+    return output;
+}
+
+struct leb128_result {
+    uint64_t value;
+    size_t length;
+};
+
+// Decodes one value from the start of input. Returns std::nullopt if the input ends mid-value
+// or the value does not fit in 64 bits.
+[[nodiscard]] constexpr std::optional<leb128_result> leb128_decode(std::span<const uint8_t> input) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < input.size() && i < 10; ++i) {
+        const uint64_t group = input[i] & 0x7F;
+        if (i == 9 && group > 1) {
+            return std::nullopt;
+        }
+        value |= group << (7 * i);
+        if (!(input[i] & 0x80)) {
+            return leb128_result{value, i + 1};
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename InputIt, typename OutputIt>
+constexpr OutputIt leb128_encode_frame(InputIt first, InputIt last, OutputIt output) {
+    output = leb128_encode(static_cast<uint64_t>(std::distance(first, last)), output);
+    return std::copy(first, last, output);
+}
+
+template <typename InputIt, typename OutputIt>
+constexpr size_t leb128_encode_frame(InputIt first, size_t size, OutputIt output) {
+    return std::distance(output, leb128_encode_frame(first, first + size, output));
+}
+
+[[nodiscard]] constexpr size_t leb128_encoded_length(size_t length) {
+    return leb128_length(length) + length;
+}
+
+// Streaming decoder with the same interface as COBSDecoder. A header longer than
+// max_header_length, or announcing more than max_frame_length bytes, can only come from a
+// corrupted or misaligned stream: the decoder hunts for the next plausible header from the byte
+// after the one it started at.
+//
+// Nothing marks where a frame starts, so only a checksum can tell a real header from payload
+// bytes that happen to look like one. With a checksum, a frame that fails it is taken to have
+// been a misreading, and the decoder hunts through the frame's bytes, from the byte after the
+// one its header started at, trying each in place as the start of a frame until one passes. A
+// decoder started mid-stream or thrown off by a lost byte so finds its way back to the real
+// frames. How quickly, and how often payload bytes pass as a frame on the way, depend on the
+// checksum's width. The frames lost count as one drop, however many candidates the hunt tries.
+// Without a checksum, a decoder that has lost its place in a stream of plausible lengths never
+// finds it again.
+class LEB128Decoder {
+public:
+    static constexpr size_t default_max_frame_length = 0xFFFF;
+
+private:
+    enum class State : uint8_t { Header, Payload };
+
+    size_t max_frame_length{default_max_frame_length};
+    size_t payload_remaining{0};
+    uint64_t header_value{0};
+    uint8_t header_length{0};
+    State state{State::Header};
+    bool packet_complete_flag{false};
+    frame_buffer frame;
+    // The header read so far, and the header of the frame in progress, to hunt through from
+    // their second byte if the header turns out implausible or the frame fails its checksum
+    std::array<uint8_t, 11> header{};
+    uint8_t rejected_header_length{0};
+    uint8_t frame_header_length{0};
+    // The bytes being hunted through, allocated up front for two of the longest frames so that
+    // taking more of the input in only moves what is left of it back to the start now and then
+    std::vector<uint8_t> rescan;
+    // Set from a frame failing its checksum until one passes
+    bool hunting{false};
+
+    [[nodiscard]] constexpr uint8_t max_header_length() const {
+        return static_cast<uint8_t>(leb128_length(max_frame_length));
+    }
+
+    // Feeds one header byte. Returns true once the header is complete.
+    constexpr bool process_header_byte(uint8_t byte) {
+        header_value |= static_cast<uint64_t>(byte & 0x7F) << (7 * header_length);
+        header[std::min<size_t>(header_length, header.size() - 1)] = byte;
+        ++header_length;
+        if (header_value > max_frame_length || header_length > max_header_length()) {
+            rejected_header_length = header_length;
+            header_value = 0;
+            header_length = 0;
+            return false;
+        }
+        if (byte & 0x80) {
+            return false;
+        }
+        payload_remaining = header_value;
+        frame_header_length = header_length;
+        header_value = 0;
+        header_length = 0;
+        state = State::Payload;
+        return true;
+    }
+
+    // A frame failing its checksum is only counted if the last one passed, as the rest are
+    // misreadings on the way back to the real frames
+    constexpr size_t lose_place() {
+        return std::exchange(hunting, true) ? 0 : 1;
+    }
+
+    // Hands on a completed frame, or if it fails the checksum keeps every byte of it after the
+    // header's first to hunt through. Returns the number of frames dropped.
+    template <typename Sink, typename Checksum>
+    size_t finish_frame(std::span<const uint8_t> payload, Sink &sink, Checksum &checksum) {
+        if (deliver_frame(payload, sink, checksum)) {
+            hunting = false;
+            return 0;
+        }
+        rescan.insert(rescan.end(), header.begin() + 1, header.begin() + frame_header_length);
+        rescan.insert(rescan.end(), payload.begin(), payload.end());
+        return lose_place();
+    }
+
+    // Reads the header at the front of bytes: its value and length, a length of 0 if bytes end
+    // before it does, or std::nullopt if it is implausible
+    [[nodiscard]] constexpr std::optional<leb128_result> peek_header(std::span<const uint8_t> bytes) const {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            value |= static_cast<uint64_t>(bytes[i] & 0x7F) << (7 * i);
+            if (value > max_frame_length || i + 1 > max_header_length()) {
+                return std::nullopt;
+            }
+            if (!(bytes[i] & 0x80)) {
+                return leb128_result{value, i + 1};
+            }
+        }
+        return leb128_result{0, 0};
+    }
+
+    // Makes n bytes from at on available to hunt through if input has them, moving the rest of
+    // the bytes back to the start first if they would outgrow the room allocated for them
+    void take_more(size_t &at, size_t n, std::span<const uint8_t> &input) {
+        const size_t wanted = std::min(n - (rescan.size() - at), input.size());
+        if (rescan.size() + wanted > rescan.capacity()) {
+            rescan.erase(rescan.begin(), rescan.begin() + static_cast<std::ptrdiff_t>(at));
+            at = 0;
+        }
+        rescan.insert(rescan.end(), input.begin(), input.begin() + static_cast<std::ptrdiff_t>(wanted));
+        input = input.subspan(wanted);
+    }
+
+    // Tries each byte kept to hunt through as the start of a frame, where it lies, taking more
+    // of input when a frame runs past them. A frame that passes is handed on and the hunt goes
+    // on from after it, which is decoding as usual, until the kept bytes run out. Returns the
+    // number of frames dropped, with the bytes still to try kept if input ran out first.
+    template <typename Sink, typename Checksum>
+    size_t hunt(std::span<const uint8_t> &input, Sink &sink, Checksum &checksum) {
+        size_t dropped = 0;
+        size_t at = 0;
+        while (at != rescan.size()) {
+            auto found = peek_header(std::span<const uint8_t>(rescan).subspan(at));
+            if (found && !found->length) {
+                // One byte past the longest header, as that many can all say more is to come
+                take_more(at, max_header_length() + 1u, input);
+                found = peek_header(std::span<const uint8_t>(rescan).subspan(at));
+                if (found && !found->length) {
+                    break; // the rest of the header is still to come
+                }
+            }
+            if (!found) {
+                ++at;
+                continue;
+            }
+
+            const size_t length = found->length + static_cast<size_t>(found->value);
+            if (rescan.size() - at < length) {
+                take_more(at, length, input);
+                if (rescan.size() - at < length) {
+                    break; // the rest of the frame is still to come
+                }
+            }
+            const auto payload = std::span<const uint8_t>(rescan).subspan(at + found->length, found->value);
+            checksum.update(payload.data(), payload.size());
+            if (deliver_frame(payload, sink, checksum)) {
+                hunting = false;
+                at += length;
+            } else {
+                dropped += lose_place();
+                ++at;
+            }
+        }
+        rescan.erase(rescan.begin(), rescan.begin() + static_cast<std::ptrdiff_t>(at));
+        return dropped;
+    }
+
+    // Decodes input up to its end, or until a header turns out implausible or a frame fails its
+    // checksum, advancing input past what was taken. Returns the number of frames dropped.
+    template <typename Sink, typename Checksum>
+    size_t scan(std::span<const uint8_t> &input, Sink &sink, Checksum &checksum) {
+        size_t dropped = 0;
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+        while (first != last && rescan.empty()) {
+            if (state == State::Header) {
+                if (!process_header_byte(*first++)) {
+                    if (rejected_header_length) {
+                        rescan.insert(rescan.end(), header.begin() + 1, header.begin() + rejected_header_length);
+                        rejected_header_length = 0;
+                    }
+                    continue;
+                }
+                if (payload_remaining) {
+                    continue;
+                }
+            }
+
+            const size_t available = static_cast<size_t>(last - first);
+            if (frame.empty() && payload_remaining <= available) {
+                const std::span<const uint8_t> payload(first, payload_remaining);
+                checksum.update(payload.data(), payload.size());
+                first += payload_remaining;
+                dropped += finish_frame(payload, sink, checksum);
+                reset();
+                continue;
+            }
+
+            const size_t n = std::min(payload_remaining, available);
+            uint8_t *chunk = frame.extend(n);
+            std::memcpy(chunk, first, n);
+            checksum.update(chunk, n);
+            first += n;
+            payload_remaining -= n;
+            if (!payload_remaining) {
+                dropped += finish_frame(frame.view(), sink, checksum);
+                reset();
+            }
+        }
+        input = std::span(first, last);
+        return dropped;
+    }
+
+public:
+    // Also allocates room for a frame that long up front, and to hunt through two
+    constexpr void set_max_frame_length(size_t length) {
+        max_frame_length = length;
+        reset();
+        frame.set_max_size(length);
+        rescan.clear();
+        rescan.shrink_to_fit();
+        rescan.reserve(2 * (length + max_header_length()));
+        hunting = false;
+    }
+
+    [[nodiscard]] constexpr size_t get_max_frame_length() const {
+        return max_frame_length;
+    }
+
+    // Decodes a chunk of the incoming stream, calling sink(std::span<const uint8_t>) once for
+    // every frame completed within it. The span is only valid for the duration of the call.
+    // Frames that lie entirely within the chunk are passed straight from the input without
+    // being copied; a partial frame is carried over to the next call. If a checksum is given
+    // the frame length includes its trailer, and frames that fail it are dropped; pass the same
+    // checksum object on every call. Returns the number of frames dropped.
+    template <typename Sink, typename Checksum = no_checksum>
+    size_t process(std::span<const uint8_t> input, Sink &&sink, Checksum &&checksum = {}) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        size_t dropped = 0;
+        for (;;) {
+            if (!rescan.empty()) {
+                dropped += hunt(input, sink, checksum);
+                if (!rescan.empty()) {
+                    break; // input ran out partway through a frame
+                }
+            }
+            dropped += scan(input, sink, checksum);
+            if (rescan.empty()) {
+                break;
+            }
+        }
+        return dropped;
+    }
+
+    // Returns true if the byte was a data byte
+    template <typename Byte>
+    [[nodiscard]] constexpr bool process_byte(Byte byte, Byte *output) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        if (state == State::Header) {
+            if (process_header_byte(static_cast<uint8_t>(byte)) && !payload_remaining) {
+                packet_complete_flag = true;
+            }
+            return false;
+        }
+
+        *output = byte;
+        if (!--payload_remaining) {
+            packet_complete_flag = true;
+        }
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool packet_complete() const {
+        return packet_complete_flag;
+    }
+
+    constexpr void reset() {
+        payload_remaining = 0;
+        header_value = 0;
+        header_length = 0;
+        state = State::Header;
+        packet_complete_flag = false;
+        frame.clear();
+    }
+};
+
+#endif //LEB128_HPP
@@ -6,7 +6,12 @@
 #define SLIP_HPP
 
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <span>
+
+#include "byte_scan.hpp"
+#include "frame_buffer.hpp"
 
 static constexpr uint8_t SLIP_END = 0xC0;
 static constexpr uint8_t SLIP_ESC = 0xDB;
@@ -80,11 +85,224 @@ constexpr size_t slip_decode_frame(InputIt first, size_t size, OutputIt output)
     return length * 2 + 2;
 }
 
+// Exact encoded size of input, including the trailing SLIP_END. A single vectorised counting
+// pass, so callers can allocate what they need instead of the 2x worst case.
+[[nodiscard]] inline size_t slip_encoded_length(std::span<const uint8_t> input) {
+    const uint8_t *first = input.data();
+    return input.size() + bytestream::detail::count_any<SLIP_END, SLIP_ESC>(first, first + input.size()) + 1;
+}
+
+// Fast path for contiguous input, fed incrementally: push() the frame in as many pieces as is
+// convenient, then finish() it. Produces the same bytes as the iterator version given the
+// concatenated pieces. Runs between special bytes are found with a vectorised scan and copied
+// with a single memcpy. output needs room for slip_encoded_length() of the total pushed.
+class SLIPEncoder {
+    uint8_t *output;
+    uint8_t *out;
+public:
+    explicit SLIPEncoder(uint8_t *output) : output(output), out(output) {}
+
+    void push(std::span<const uint8_t> input) {
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+
+        for (;;) {
+            const uint8_t *special = bytestream::detail::find_any<SLIP_END, SLIP_ESC>(first, last);
+            const auto n = static_cast<size_t>(special - first);
+            if (n < 16 && last - first >= 16) {
+                // Short run: copy a fixed 16 bytes and let the escape overwrite the excess. The
+                // output is only ever ahead of the input by the escapes already written, so this
+                // stays within slip_encoded_length while 16 input bytes remain.
+                std::memcpy(out, first, 16);
+            } else if (n) {
+                std::memcpy(out, first, n);
+            }
+            out += n;
+            first = special;
+            if (first == last) {
+                break;
+            }
+            *out++ = SLIP_ESC;
+            *out++ = *first++ == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+        }
+    }
+
+    // Appends the terminating SLIP_END. Returns the encoded size.
+    size_t finish() {
+        *out++ = SLIP_END;
+        return static_cast<size_t>(out - output);
+    }
+};
+
+// One-shot form of SLIPEncoder. output needs room for slip_encoded_length(input) bytes.
+inline size_t slip_encode_frame(std::span<const uint8_t> input, uint8_t *output) {
+    SLIPEncoder encoder(output);
+    encoder.push(input);
+    return encoder.finish();
+}
+
+// Encodes the payload buffer[0, length) over the top of itself, returning the encoded size.
+// buffer needs room for slip_encoded_length() of the payload. Escaping works back from the end,
+// so only the bytes after the first special byte move; a payload without any just gains its END.
+inline size_t slip_encode_frame_in_place(std::span<uint8_t> buffer, size_t length) {
+    uint8_t *const first = buffer.data();
+    const size_t escapes = bytestream::detail::count_any<SLIP_END, SLIP_ESC>(first, first + length);
+    const size_t encoded_length = length + escapes + 1;
+    first[encoded_length - 1] = SLIP_END;
+
+    const uint8_t *in = first + length;
+    uint8_t *out = first + length + escapes;
+    while (out != in) {
+        const uint8_t byte = *--in;
+        if (byte == SLIP_END || byte == SLIP_ESC) {
+            *--out = byte == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+            *--out = SLIP_ESC;
+        } else {
+            *--out = byte;
+        }
+    }
+    return encoded_length;
+}
+
+// Fast path for contiguous input, producing the same bytes as the iterator version, including
+// its handling of stray escapes: once escaped, the next SLIP_ESC_END/SLIP_ESC_ESC is translated
+// even if other bytes come first. So while escaped the scan also stops on the escape codes.
+// output may alias input.data() to decode in place; otherwise it needs room for input.size() bytes.
+inline size_t slip_decode_frame(std::span<const uint8_t> input, uint8_t *output) {
+    const uint8_t *first = input.data();
+    const uint8_t *const last = first + input.size();
+    uint8_t *out = output;
+
+    bool escaped = false;
+    while (first != last) {
+        const uint8_t *special = escaped
+            ? bytestream::detail::find_any<SLIP_END, SLIP_ESC, SLIP_ESC_END, SLIP_ESC_ESC>(first, last)
+            : bytestream::detail::find_any<SLIP_END, SLIP_ESC>(first, last);
+        if (const auto n = static_cast<size_t>(special - first)) {
+            std::memmove(out, first, n);
+            out += n;
+        }
+        first = special;
+        if (first == last) {
+            break;
+        }
+
+        switch (*first++) {
+            case SLIP_END:
+                return static_cast<size_t>(out - output);
+            case SLIP_ESC:
+                escaped = true;
+                break;
+            case SLIP_ESC_END:
+                *out++ = SLIP_END;
+                escaped = false;
+                break;
+            case SLIP_ESC_ESC:
+                *out++ = SLIP_ESC;
+                escaped = false;
+                break;
+            default:
+                break;
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
 class SLIPDecoder {
-    bool escaped;
-    bool packet_complete_flag;
+    bool escaped{false};
+    bool packet_complete_flag{false};
+    bool frame_corrupt{false};
+    bool oversized{false};
+    frame_buffer frame;
 public:
-    SLIPDecoder() : escaped(false) {}
+    // Caps the decoded frame length, checksum trailer included, and allocates room for a frame
+    // that long up front. Longer frames are dropped.
+    void set_max_frame_length(size_t length) {
+        reset();
+        frame.set_max_size(length);
+    }
+
+    [[nodiscard]] constexpr size_t get_max_frame_length() const {
+        return frame.max_size();
+    }
+
+    // Decodes a chunk of the incoming stream, calling sink(std::span<const uint8_t>) once for
+    // every frame completed within it. The span is only valid for the duration of the call. A
+    // partial frame at the end of the chunk is carried over to the next call. Runs of ordinary
+    // bytes are found with a vectorised scan and appended in one go. An escape followed by
+    // anything but SLIP_ESC_END/SLIP_ESC_ESC marks the frame as corrupt, and it is dropped at
+    // the next SLIP_END. A frame that outgrows the maximum length is dropped too, skipping
+    // straight to the next SLIP_END. If a checksum is given it is updated as each run is
+    // appended, and frames that fail it are dropped too; pass the same checksum object on every
+    // call. Returns the number of frames dropped. Don't mix with process_byte() on the same decoder.
+    template <typename Sink, typename Checksum = no_checksum>
+    size_t process(std::span<const uint8_t> input, Sink &&sink, Checksum &&checksum = {}) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        size_t dropped = 0;
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+        while (first != last) {
+            if (oversized) {
+                first = bytestream::detail::find_any<SLIP_END>(first, last);
+                if (first == last) {
+                    break;
+                }
+                ++first;
+                checksum.reset();
+                reset();
+                ++dropped;
+                continue;
+            }
+
+            if (escaped) {
+                escaped = false;
+                if (*first == SLIP_ESC_END || *first == SLIP_ESC_ESC) {
+                    uint8_t *decoded = frame.extend(1);
+                    if (!decoded) {
+                        oversized = true;
+                        continue;
+                    }
+                    *decoded = *first++ == SLIP_ESC_END ? SLIP_END : SLIP_ESC;
+                    checksum.update(decoded, 1);
+                } else {
+                    // Leave the byte for the scan below, so a SLIP_END still ends the frame
+                    frame_corrupt = true;
+                }
+                continue;
+            }
+
+            const uint8_t *special = bytestream::detail::find_any<SLIP_END, SLIP_ESC>(first, last);
+            if (const auto n = static_cast<size_t>(special - first)) {
+                uint8_t *run = frame.extend(n);
+                if (!run) {
+                    oversized = true;
+                    continue;
+                }
+                std::memcpy(run, first, n);
+                checksum.update(run, n);
+            }
+            first = special;
+            if (first == last) {
+                break;
+            }
+
+            if (*first++ == SLIP_ESC) {
+                escaped = true;
+                continue;
+            }
+            if (frame_corrupt) {
+                checksum.reset();
+                ++dropped;
+            } else {
+                dropped += !deliver_frame(frame.view(), sink, checksum);
+            }
+            reset();
+        }
+        return dropped;
+    }
 
     template <typename Byte>
     [[nodiscard]] constexpr bool process_byte(Byte byte, Byte *output) {
@@ -133,6 +351,9 @@ public:
     constexpr void reset() {
         escaped = false;
         packet_complete_flag = false;
+        frame_corrupt = false;
+        oversized = false;
+        frame.clear();
     }
 
 };
@@ -0,0 +1,192 @@
+//
+// Integers of 1 to 32 bits packed back to back with no regard for byte boundaries, for the
+// flags and short counters of device protocols.
+//
+
+#ifndef BIT_PACKING_HPP
+#define BIT_PACKING_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "byte_swap.hpp"
+
+namespace bytestream::detail {
+
+[[nodiscard]] constexpr uint64_t low_bits_mask(unsigned width) {
+    return (uint64_t{1} << width) - 1;
+}
+
+// Bytes that bits bits take, the last one padded
+[[nodiscard]] constexpr size_t packed_bytes(size_t bits) {
+    return (bits + 7) / 8;
+}
+
+// Whether bits fill bytes from the top down. Big-endian packing is MSB first, so a field
+// starting on a byte boundary has the same bytes as a big-endian integer, and the first field
+// is the top bits of the first byte, as protocol diagrams draw them. Little-endian packing is
+// LSB first, as C bitfields are laid out on little-endian machines.
+[[nodiscard]] constexpr bool msb_first(bool swap) {
+    return (std::endian::native == std::endian::big) != swap;
+}
+
+// Appends values to bytes a 32-bit word at a time: bits build up in a 64-bit register and a
+// word is written out whenever there are 32 of them, so no value is ever split bit by bit.
+class bit_writer {
+    uint64_t held{0};
+    unsigned count{0};
+    bool msb{false};
+
+    static void store_word(uint8_t *out, uint32_t word, bool big) {
+        if (big != (std::endian::native == std::endian::big)) {
+            word = byteswap(word);
+        }
+        std::memcpy(out, &word, 4);
+    }
+
+public:
+    bit_writer() = default;
+    explicit bit_writer(bool msb_first) : msb(msb_first) {}
+
+    // Appends the low width bits of value, 1 to 32 of them, writing four bytes to out if that
+    // fills a word. Returns where the next bytes go.
+    uint8_t *put(uint8_t *out, uint32_t value, unsigned width) {
+        const uint64_t bits = value & low_bits_mask(width);
+        held |= msb ? bits << (64 - count - width) : bits << count;
+        count += width;
+        if (count >= 32) {
+            if (msb) {
+                store_word(out, static_cast<uint32_t>(held >> 32), true);
+                held <<= 32;
+            } else {
+                store_word(out, static_cast<uint32_t>(held), false);
+                held >>= 32;
+            }
+            count -= 32;
+            out += 4;
+        }
+        return out;
+    }
+
+    // Writes out the bits still held, padding the last byte with zeros, and starts afresh.
+    // Returns where the next bytes go.
+    uint8_t *finish(uint8_t *out) {
+        for (; count; count = count > 8 ? count - 8 : 0) {
+            if (msb) {
+                *out++ = static_cast<uint8_t>(held >> 56);
+                held <<= 8;
+            } else {
+                *out++ = static_cast<uint8_t>(held);
+                held >>= 8;
+            }
+        }
+        held = 0;
+        return out;
+    }
+};
+
+// The reverse of bit_writer: takes bytes from its source four at a time as values need them,
+// and never more than they need, so it can be given a source a piece at a time and stops
+// exactly at the end of what was written.
+class bit_reader {
+    uint64_t held{0};
+    unsigned count{0};
+    bool msb{false};
+    const uint8_t *in{nullptr};
+    const uint8_t *end{nullptr};
+
+    // Only called with fewer than 32 bits held
+    void refill() {
+        if (end - in >= 4) {
+            uint32_t word;
+            std::memcpy(&word, in, 4);
+            if (msb != (std::endian::native == std::endian::big)) {
+                word = byteswap(word);
+            }
+            held |= msb ? static_cast<uint64_t>(word) << (32 - count) : static_cast<uint64_t>(word) << count;
+            count += 32;
+            in += 4;
+            return;
+        }
+        for (; in != end; ++in, count += 8) {
+            held |= msb ? static_cast<uint64_t>(*in) << (56 - count) : static_cast<uint64_t>(*in) << count;
+        }
+    }
+
+public:
+    bit_reader() = default;
+    explicit bit_reader(bool msb_first) : msb(msb_first) {}
+
+    // Bytes to take bits from, until they run out or the next source is given. Bits already
+    // taken from an earlier source are kept.
+    void source(const uint8_t *first, const uint8_t *last) {
+        in = first;
+        end = last;
+    }
+
+    // Where in the source the next byte would be taken from
+    [[nodiscard]] const uint8_t *position() const { return in; }
+
+    // Takes the next width bits, 1 to 32, into value. Returns false, taking nothing, if the
+    // source runs out first; every byte of it has then been taken.
+    bool get(unsigned width, uint32_t &value) {
+        if (count < width) {
+            refill();
+            if (count < width) {
+                return false;
+            }
+        }
+        if (msb) {
+            value = static_cast<uint32_t>(held >> (64 - width));
+            held <<= width;
+        } else {
+            value = static_cast<uint32_t>(held & low_bits_mask(width));
+            held >>= width;
+        }
+        count -= width;
+        return true;
+    }
+};
+
+// Packs count elements of T at src, width bits each. Returns where the next bytes go.
+template <typename T>
+uint8_t *pack_bits(bit_writer &writer, uint8_t *out, const uint8_t *src, size_t count, unsigned width) {
+    static_assert(std::is_integral_v<T> && sizeof(T) <= 4, "Bit fields are held in integers of up to 32 bits");
+    for (size_t i = 0; i < count; ++i) {
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        out = writer.put(out, static_cast<uint32_t>(value), width);
+    }
+    return out;
+}
+
+// Unpacks up to count elements of T to dst, width bits each, sign extending them if T is
+// signed. Returns the number unpacked, fewer than count if the reader's source ran out.
+template <typename T>
+size_t unpack_bits(bit_reader &reader, uint8_t *dst, size_t count, unsigned width) {
+    static_assert(std::is_integral_v<T> && sizeof(T) <= 4, "Bit fields are held in integers of up to 32 bits");
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t bits;
+        if (!reader.get(width, bits)) {
+            return i;
+        }
+        T value;
+        if constexpr (std::is_signed_v<T>) {
+            value = static_cast<T>(static_cast<int32_t>(bits << (32 - width)) >> (32 - width));
+        } else {
+            value = static_cast<T>(bits);
+        }
+        std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+    }
+    return count;
+}
+
+using pack_bits_function = uint8_t *(*)(bit_writer &, uint8_t *, const uint8_t *, size_t, unsigned);
+using unpack_bits_function = size_t (*)(bit_reader &, uint8_t *, size_t, unsigned);
+
+} // namespace bytestream::detail
+
+#endif //BIT_PACKING_HPP
@@ -0,0 +1,273 @@
+//
+// Vectorised search for delimiter/special bytes, shared by the framing codecs.
+//
+
+#ifndef BYTE_SCAN_HPP
+#define BYTE_SCAN_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace bytestream::detail {
+
+template <uint8_t... Needles>
+[[nodiscard]] constexpr bool is_any_of(uint8_t byte) {
+    return ((byte == Needles) || ...);
+}
+
+// Returns a pointer to the first byte in [first, last) equal to any of Needles, or last.
+template <uint8_t... Needles>
+[[nodiscard]] inline const uint8_t *find_any(const uint8_t *first, const uint8_t *last) {
+    static_assert(sizeof...(Needles) > 0, "find_any needs at least one byte to search for");
+
+#if defined(__AVX2__)
+    while (last - first >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+        __m256i hits = _mm256_setzero_si256();
+        ((hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(static_cast<char>(Needles))))), ...);
+        if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits))) {
+            return first + std::countr_zero(mask);
+        }
+        first += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (last - first >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        __m128i hits = _mm_setzero_si128();
+        ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(static_cast<char>(Needles))))), ...);
+        if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits))) {
+            return first + std::countr_zero(mask);
+        }
+        first += 16;
+    }
+#elif defined(__ARM_NEON)
+    while (last - first >= 16) {
+        const uint8x16_t chunk = vld1q_u8(first);
+        uint8x16_t hits = vdupq_n_u8(0);
+        ((hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(Needles)))), ...);
+        if (vmaxvq_u8(hits)) {
+            break; // locate the hit within this chunk with the scalar tail below
+        }
+        first += 16;
+    }
+#else
+    if constexpr (sizeof...(Needles) == 1) {
+        const auto *hit = static_cast<const uint8_t *>(std::memchr(first, Needles..., last - first));
+        return hit ? hit : last;
+    }
+#endif
+
+    for (; first != last; ++first) {
+        if (is_any_of<Needles...>(*first)) {
+            return first;
+        }
+    }
+    return last;
+}
+
+// Returns a pointer to the first byte in [first, last) with its high bit set, or last. MIDI
+// status bytes are the ones with it set.
+[[nodiscard]] inline const uint8_t *find_high_bit(const uint8_t *first, const uint8_t *last) {
+#if defined(__AVX2__)
+    while (last - first >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+        if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(chunk))) {
+            return first + std::countr_zero(mask);
+        }
+        first += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (last - first >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(chunk))) {
+            return first + std::countr_zero(mask);
+        }
+        first += 16;
+    }
+#elif defined(__ARM_NEON)
+    while (last - first >= 16) {
+        if (vmaxvq_u8(vld1q_u8(first)) & 0x80) {
+            break; // locate the byte within this chunk with the scalar tail below
+        }
+        first += 16;
+    }
+#endif
+
+    for (; first != last; ++first) {
+        if (*first & 0x80) {
+            return first;
+        }
+    }
+    return last;
+}
+
+// Returns a pointer to the last byte in [first, last) equal to any of Needles, or last if there is
+// none.
+template <uint8_t... Needles>
+[[nodiscard]] inline const uint8_t *find_last_any(const uint8_t *first, const uint8_t *last) {
+    static_assert(sizeof...(Needles) > 0, "find_last_any needs at least one byte to search for");
+
+    const uint8_t *end = last;
+#if defined(__AVX2__)
+    while (end - first >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(end - 32));
+        __m256i hits = _mm256_setzero_si256();
+        ((hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(static_cast<char>(Needles))))), ...);
+        if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits))) {
+            return end - 1 - std::countl_zero(mask);
+        }
+        end -= 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (end - first >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(end - 16));
+        __m128i hits = _mm_setzero_si128();
+        ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(static_cast<char>(Needles))))), ...);
+        if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits))) {
+            return end - 1 - (std::countl_zero(mask) - 16);
+        }
+        end -= 16;
+    }
+#elif defined(__ARM_NEON)
+    while (end - first >= 16) {
+        const uint8x16_t chunk = vld1q_u8(end - 16);
+        uint8x16_t hits = vdupq_n_u8(0);
+        ((hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(Needles)))), ...);
+        if (vmaxvq_u8(hits)) {
+            break; // locate the hit within this chunk with the scalar tail below
+        }
+        end -= 16;
+    }
+#endif
+
+    while (end != first) {
+        if (is_any_of<Needles...>(*--end)) {
+            return end;
+        }
+    }
+    return last;
+}
+
+// Returns the number of bytes in [first, last) equal to any of Needles.
+template <uint8_t... Needles>
+[[nodiscard]] inline size_t count_any(const uint8_t *first, const uint8_t *last) {
+    static_assert(sizeof...(Needles) > 0, "count_any needs at least one byte to count");
+
+    size_t count = 0;
+#if defined(__AVX2__)
+    while (last - first >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+        __m256i hits = _mm256_setzero_si256();
+        ((hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(static_cast<char>(Needles))))), ...);
+        count += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(hits)));
+        first += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (last - first >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        __m128i hits = _mm_setzero_si128();
+        ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(static_cast<char>(Needles))))), ...);
+        count += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(hits)));
+        first += 16;
+    }
+#elif defined(__ARM_NEON)
+    while (last - first >= 16) {
+        const uint8x16_t chunk = vld1q_u8(first);
+        uint8x16_t hits = vdupq_n_u8(0);
+        ((hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(Needles)))), ...);
+        count += vaddvq_u8(vshrq_n_u8(hits, 7));
+        first += 16;
+    }
+#endif
+
+    for (; first != last; ++first) {
+        count += is_any_of<Needles...>(*first);
+    }
+    return count;
+}
+
+// Copies n bytes from src to dst, returning false if any of them was one of Needles. The
+// check is fused into the copy so the block is only read once. dst may overlap src as long as
+// it does not start after it, which is what in-place decoding needs. The tail chunk is loaded
+// before anything is stored so that an overlapping final store never sees clobbered input.
+template <uint8_t... Needles>
+[[nodiscard]] inline bool copy_if_none_of(uint8_t *dst, const uint8_t *src, size_t n) {
+    static_assert(sizeof...(Needles) > 0, "copy_if_none_of needs at least one byte to reject");
+
+#if defined(__AVX2__)
+    if (n >= 32) {
+        const auto matches = [](__m256i chunk) {
+            __m256i hits = _mm256_setzero_si256();
+            ((hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(static_cast<char>(Needles))))), ...);
+            return hits;
+        };
+        const __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + n - 32));
+        __m256i hits = matches(tail);
+        for (size_t i = 0; i + 32 <= n; i += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            hits = _mm256_or_si256(hits, matches(chunk));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), chunk);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + n - 32), tail);
+        return _mm256_testz_si256(hits, hits);
+    }
+#endif
+#if defined(__SSE2__)
+    if (n >= 16) {
+        const auto matches = [](__m128i chunk) {
+            __m128i hits = _mm_setzero_si128();
+            ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(static_cast<char>(Needles))))), ...);
+            return hits;
+        };
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + n - 16));
+        __m128i hits = matches(tail);
+        for (size_t i = 0; i + 16 <= n; i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            hits = _mm_or_si128(hits, matches(chunk));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), chunk);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + n - 16), tail);
+        return _mm_movemask_epi8(hits) == 0;
+    }
+#elif defined(__ARM_NEON)
+    if (n >= 16) {
+        const auto matches = [](uint8x16_t chunk) {
+            uint8x16_t hits = vdupq_n_u8(0);
+            ((hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(Needles)))), ...);
+            return hits;
+        };
+        const uint8x16_t tail = vld1q_u8(src + n - 16);
+        uint8x16_t hits = matches(tail);
+        for (size_t i = 0; i + 16 <= n; i += 16) {
+            const uint8x16_t chunk = vld1q_u8(src + i);
+            hits = vorrq_u8(hits, matches(chunk));
+            vst1q_u8(dst + i, chunk);
+        }
+        vst1q_u8(dst + n - 16, tail);
+        return vmaxvq_u8(hits) == 0;
+    }
+#endif
+
+    bool clean = true;
+    for (size_t i = 0; i < n; ++i) {
+        clean &= !is_any_of<Needles...>(src[i]);
+        dst[i] = src[i];
+    }
+    return clean;
+}
+
+} // namespace bytestream::detail
+
+#endif //BYTE_SCAN_HPP
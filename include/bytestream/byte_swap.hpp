@@ -0,0 +1,145 @@
+//
+// Vectorised copy with byte order reversal of 2, 4 and 8 byte elements, for serialising arrays
+// in a byte order other than the machine's.
+//
+
+#ifndef BYTE_SWAP_HPP
+#define BYTE_SWAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.hpp"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <stdlib.h>
+#endif
+
+namespace bytestream::detail {
+
+template <size_t Size>
+struct swap_word;
+template <>
+struct swap_word<2> { using type = uint16_t; };
+template <>
+struct swap_word<4> { using type = uint32_t; };
+template <>
+struct swap_word<8> { using type = uint64_t; };
+
+template <typename U>
+[[nodiscard]] inline U byteswap(U value) {
+#if defined(__GNUC__) || defined(__clang__)
+    if constexpr (sizeof(U) == 2) {
+        return __builtin_bswap16(value);
+    } else if constexpr (sizeof(U) == 4) {
+        return __builtin_bswap32(value);
+    } else {
+        return __builtin_bswap64(value);
+    }
+#elif defined(_MSC_VER)
+    if constexpr (sizeof(U) == 2) {
+        return _byteswap_ushort(value);
+    } else if constexpr (sizeof(U) == 4) {
+        return _byteswap_ulong(value);
+    } else {
+        return _byteswap_uint64(value);
+    }
+#else
+    U result = 0;
+    for (size_t i = 0; i < sizeof(U); ++i) {
+        result = static_cast<U>((result << 8) | ((value >> (8 * i)) & 0xFF));
+    }
+    return result;
+#endif
+}
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+// pshufb control that reverses each Size-byte element of a 16-byte lane
+template <size_t Size>
+inline __m128i swap_shuffle() {
+    if constexpr (Size == 2) {
+        return _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    } else if constexpr (Size == 4) {
+        return _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    } else {
+        return _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    }
+}
+
+// The kernels swap whole 16-byte lanes, leaving the rest; they return the bytes left
+template <size_t Size>
+BYTESTREAM_TARGET("ssse3")
+size_t copy_swapped_ssse3(uint8_t *dst, const uint8_t *src, size_t n) {
+    const __m128i shuffle = swap_shuffle<Size>();
+    for (; n >= 16; n -= 16, src += 16, dst += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(chunk, shuffle));
+    }
+    return n;
+}
+
+template <size_t Size>
+BYTESTREAM_TARGET("avx2")
+size_t copy_swapped_avx2(uint8_t *dst, const uint8_t *src, size_t n) {
+    const __m128i shuffle = swap_shuffle<Size>();
+    const __m256i shuffle_256 = _mm256_broadcastsi128_si256(shuffle);
+    for (; n >= 64; n -= 64, src += 64, dst += 64) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_shuffle_epi8(a, shuffle_256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32), _mm256_shuffle_epi8(b, shuffle_256));
+    }
+    for (; n >= 16; n -= 16, src += 16, dst += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(chunk, shuffle));
+    }
+    return n;
+}
+#endif
+
+// Copies count elements of Size bytes from src to dst, reversing the bytes of each. Neither
+// buffer needs to be aligned; they must not overlap, except that dst == src swaps in place.
+template <size_t Size>
+inline void copy_swapped(uint8_t *dst, const uint8_t *src, size_t count) {
+    static_assert(Size == 2 || Size == 4 || Size == 8, "Elements must be 2, 4 or 8 bytes");
+    size_t n = count * Size;
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+    if (n >= 16) {
+        const size_t left = cpu_has_avx2()    ? copy_swapped_avx2<Size>(dst, src, n)
+                            : cpu_has_ssse3() ? copy_swapped_ssse3<Size>(dst, src, n)
+                                              : n;
+        src += n - left;
+        dst += n - left;
+        n = left;
+    }
+#elif defined(__ARM_NEON)
+    for (; n >= 16; n -= 16, src += 16, dst += 16) {
+        const uint8x16_t chunk = vld1q_u8(src);
+        if constexpr (Size == 2) {
+            vst1q_u8(dst, vrev16q_u8(chunk));
+        } else if constexpr (Size == 4) {
+            vst1q_u8(dst, vrev32q_u8(chunk));
+        } else {
+            vst1q_u8(dst, vrev64q_u8(chunk));
+        }
+    }
+#endif
+
+    using word = typename swap_word<Size>::type;
+    for (; n; n -= Size, src += Size, dst += Size) {
+        word value;
+        std::memcpy(&value, src, Size);
+        value = byteswap(value);
+        std::memcpy(dst, &value, Size);
+    }
+}
+
+} // namespace bytestream::detail
+
+#endif //BYTE_SWAP_HPP
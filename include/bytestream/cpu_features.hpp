@@ -0,0 +1,83 @@
+//
+// Runtime checks for x86 instruction set extensions, for kernels compiled with a target
+// attribute rather than for the whole binary. Builds target baseline x86-64, as the macOS
+// universal binary's x86_64 slice does, so a kernel using anything past SSE2 is only called
+// once the CPU is known to have it. A check the compiler flags already settle is a constant.
+//
+
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+// GCC and Clang, not clang-cl, which can't rely on the runtime that answers the checks
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BYTESTREAM_X86_DISPATCH 1
+#define BYTESTREAM_TARGET(isa) __attribute__((target(isa)))
+// For the generic body of a kernel, so that it is compiled again inside each targeted wrapper
+// rather than called from it
+#define BYTESTREAM_KERNEL_INLINE [[gnu::always_inline]] inline
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define BYTESTREAM_KERNEL_INLINE inline
+#endif
+
+namespace bytestream::detail {
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+
+[[nodiscard]] inline bool cpu_has_ssse3() {
+#if defined(__SSSE3__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return has;
+#endif
+}
+
+[[nodiscard]] inline bool cpu_has_sse42() {
+#if defined(__SSE4_2__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2"));
+    return has;
+#endif
+}
+
+[[nodiscard]] inline bool cpu_has_avx2() {
+#if defined(__AVX2__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return has;
+#endif
+}
+
+[[nodiscard]] inline bool cpu_has_bmi2() {
+#if defined(__BMI2__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("bmi2"));
+    return has;
+#endif
+}
+
+// F16C is read from CPUID itself, as not every compiler's runtime reports it. Its instructions
+// are VEX encoded, so it also needs the OS to save AVX state, which the AVX check covers.
+[[nodiscard]] inline bool cpu_has_f16c() {
+#if defined(__F16C__)
+    return true;
+#else
+    static const bool has = [] {
+        __builtin_cpu_init();
+        unsigned eax, ebx, ecx, edx;
+        return __builtin_cpu_supports("avx") && __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C);
+    }();
+    return has;
+#endif
+}
+
+#endif
+
+} // namespace bytestream::detail
+
+#endif //CPU_FEATURES_HPP
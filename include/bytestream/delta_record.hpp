@@ -0,0 +1,437 @@
+//
+// Records sent as their changes from the record before, for large arrays that change a little
+// from one record to the next.
+//
+// A delta record is a kind byte, 0 for a keyframe and 1 for a delta, a 16-bit sequence number in
+// the record's byte order, and then each field in turn as a tag byte followed by:
+//   0, same:       nothing, the field is as it was in the last record
+//   1, whole:      a varint byte count and the field's bytes
+//   2, sparse:     a varint count of changed elements, then for each the varint count of
+//                  unchanged elements since the last changed one, and its bytes
+//   3, difference: every element's difference from the last record's, wrapping at its width,
+//                  as a zigzag varint
+// A keyframe has every field whole. Fields are compared as the bytes they serialise to, 1, 2, 4
+// or 8 at a time in the record's byte order, so the record round trips exactly whatever their
+// types: a float's difference is that of its bits, small when it changes little. Elements are
+// counted back from a field's end, past the count in front of a variable field, which is the
+// same whenever the field's size is.
+//
+
+#ifndef DELTA_RECORD_HPP
+#define DELTA_RECORD_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "byte_swap.hpp"
+#include "varint.hpp"
+
+namespace bytestream::detail {
+
+enum class delta_kind : uint8_t { keyframe, delta };
+enum class delta_tag : uint8_t { same, whole, sparse, difference };
+
+inline constexpr size_t delta_header_size = 3;
+inline constexpr size_t max_varint_length = 10;
+
+template <size_t Size>
+using delta_word = std::conditional_t<Size == 1, uint8_t, typename swap_word<Size == 1 ? 2 : Size>::type>;
+
+template <size_t Size, bool Big>
+[[nodiscard]] inline delta_word<Size> load_element(const uint8_t *src) {
+    delta_word<Size> word;
+    std::memcpy(&word, src, Size);
+    if constexpr (Size > 1 && Big != (std::endian::native == std::endian::big)) {
+        word = byteswap(word);
+    }
+    return word;
+}
+
+template <size_t Size, bool Big>
+inline void store_element(uint8_t *dst, delta_word<Size> word) {
+    if constexpr (Size > 1 && Big != (std::endian::native == std::endian::big)) {
+        word = byteswap(word);
+    }
+    std::memcpy(dst, &word, Size);
+}
+
+// now - before, wrapping at the elements' width, zigzagged so that small changes either way
+// stay short
+template <size_t Size>
+[[nodiscard]] inline uint64_t element_difference(delta_word<Size> now, delta_word<Size> before) {
+    using W = delta_word<Size>;
+    return zigzag_encode(static_cast<std::make_signed_t<W>>(static_cast<W>(now - before)));
+}
+
+// What sending count elements each way would cost, from one pass over them
+struct delta_costs {
+    size_t changed;
+    size_t sparse;
+    size_t difference;
+};
+
+template <size_t Size, bool Big>
+delta_costs measure_delta(const uint8_t *now, const uint8_t *before, size_t count) {
+    size_t changed = 0;
+    size_t gaps = 0;
+    size_t difference = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto a = load_element<Size, Big>(now + i * Size);
+        const auto b = load_element<Size, Big>(before + i * Size);
+        difference += varint_length(element_difference<Size>(a, b));
+        if (a != b) {
+            gaps += varint_length(i - next);
+            next = i + 1;
+            ++changed;
+        }
+    }
+    return {changed, varint_length(changed) + gaps + changed * Size, difference};
+}
+
+template <size_t Size>
+uint8_t *encode_sparse(uint8_t *out, const uint8_t *now, const uint8_t *before, size_t count, size_t changed) {
+    out = varint_encode(out, changed);
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (std::memcmp(now + i * Size, before + i * Size, Size) != 0) {
+            out = varint_encode(out, i - next);
+            std::memcpy(out, now + i * Size, Size);
+            out += Size;
+            next = i + 1;
+        }
+    }
+    return out;
+}
+
+// Patches the changed elements into field, which holds the last record's. Returns the byte after
+// them, or nullptr if they are cut short or run past the field's end.
+template <size_t Size>
+const uint8_t *decode_sparse(const uint8_t *in, const uint8_t *end, uint8_t *field, size_t count) {
+    uint64_t changed;
+    in = varint_decode(in, end, changed);
+    if (!in || changed > count) {
+        return nullptr;
+    }
+    size_t at = 0;
+    for (uint64_t k = 0; k < changed; ++k) {
+        uint64_t gap;
+        in = varint_decode(in, end, gap);
+        if (!in || gap >= count - at || static_cast<size_t>(end - in) < Size) {
+            return nullptr;
+        }
+        at += static_cast<size_t>(gap);
+        std::memcpy(field + at * Size, in, Size);
+        in += Size;
+        ++at;
+    }
+    return in;
+}
+
+template <size_t Size, bool Big>
+uint8_t *encode_difference(uint8_t *out, const uint8_t *now, const uint8_t *before, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out = varint_encode(out, element_difference<Size>(load_element<Size, Big>(now + i * Size),
+                                                          load_element<Size, Big>(before + i * Size)));
+    }
+    return out;
+}
+
+// Adds the differences to the elements in field, which holds the last record's. Returns the
+// byte after them, or nullptr if they are cut short or too wide for the elements.
+template <size_t Size, bool Big>
+const uint8_t *decode_difference(const uint8_t *in, const uint8_t *end, uint8_t *field, size_t count) {
+    using W = delta_word<Size>;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t word;
+        in = varint_decode(in, end, word);
+        if (!in || word > std::numeric_limits<W>::max()) {
+            return nullptr;
+        }
+        const auto change = zigzag_decode<std::make_signed_t<W>>(static_cast<W>(word));
+        const auto before = load_element<Size, Big>(field + i * Size);
+        store_element<Size, Big>(field + i * Size, static_cast<W>(before + static_cast<W>(change)));
+    }
+    return in;
+}
+
+// How one field's elements are compared, chosen once for its element size and byte order. A
+// size of 0 is a field that is only ever sent whole.
+struct delta_functions {
+    size_t size{0};
+    delta_costs (*measure)(const uint8_t *now, const uint8_t *before, size_t count){nullptr};
+    uint8_t *(*encode_sparse)(uint8_t *out, const uint8_t *now, const uint8_t *before, size_t count,
+                              size_t changed){nullptr};
+    const uint8_t *(*decode_sparse)(const uint8_t *in, const uint8_t *end, uint8_t *field, size_t count){nullptr};
+    uint8_t *(*encode_difference)(uint8_t *out, const uint8_t *now, const uint8_t *before, size_t count){nullptr};
+    const uint8_t *(*decode_difference)(const uint8_t *in, const uint8_t *end, uint8_t *field,
+                                        size_t count){nullptr};
+};
+
+template <size_t Size, bool Big>
+constexpr delta_functions make_delta_functions() {
+    return {Size, measure_delta<Size, Big>, encode_sparse<Size>, decode_sparse<Size>,
+            encode_difference<Size, Big>, decode_difference<Size, Big>};
+}
+
+template <bool Big>
+delta_functions delta_functions_for(size_t element_size) {
+    switch (element_size) {
+        case 0: return {};
+        case 1: return make_delta_functions<1, Big>();
+        case 2: return make_delta_functions<2, Big>();
+        case 4: return make_delta_functions<4, Big>();
+        case 8: return make_delta_functions<8, Big>();
+        default: throw std::invalid_argument("Elements can only be compared 1, 2, 4 or 8 bytes at a time");
+    }
+}
+
+inline std::vector<delta_functions> delta_fields(std::span<const size_t> element_sizes, bool big) {
+    std::vector<delta_functions> fields;
+    fields.reserve(element_sizes.size());
+    for (const size_t size : element_sizes) {
+        fields.push_back(big ? delta_functions_for<true>(size) : delta_functions_for<false>(size));
+    }
+    return fields;
+}
+
+} // namespace bytestream::detail
+
+// Encodes records, each already serialised and split into its fields, as delta records against
+// the one before. Each field is sent whichever of the ways above is shortest.
+class delta_encoder {
+    std::vector<bytestream::detail::delta_functions> fields;
+    bool big{false};
+    std::vector<uint8_t> reference;
+    std::vector<size_t> reference_offsets;
+    bool has_reference{false};
+    uint16_t sequence{0};
+
+    uint8_t *encode_whole(uint8_t *out, std::span<const uint8_t> now) const {
+        using namespace bytestream::detail;
+        *out++ = static_cast<uint8_t>(delta_tag::whole);
+        out = varint_encode(out, now.size());
+        std::ranges::copy(now, out);
+        return out + now.size();
+    }
+
+    uint8_t *encode_field(size_t field, uint8_t *out, std::span<const uint8_t> now) const {
+        using namespace bytestream::detail;
+        const delta_functions &f = fields[field];
+        const std::span<const uint8_t> before(reference.data() + reference_offsets[field],
+                                              reference_offsets[field + 1] - reference_offsets[field]);
+        if (std::ranges::equal(now, before)) {
+            *out++ = static_cast<uint8_t>(delta_tag::same);
+            return out;
+        }
+        if (!f.size || now.size() != before.size()) {
+            return encode_whole(out, now);
+        }
+        const size_t head = now.size() % f.size;
+        const size_t count = now.size() / f.size;
+        if (!std::equal(now.begin(), now.begin() + static_cast<std::ptrdiff_t>(head), before.begin())) {
+            return encode_whole(out, now);
+        }
+
+        const delta_costs costs = f.measure(now.data() + head, before.data() + head, count);
+        const size_t whole = varint_length(now.size()) + now.size();
+        if (costs.sparse <= costs.difference && costs.sparse < whole) {
+            *out++ = static_cast<uint8_t>(delta_tag::sparse);
+            return f.encode_sparse(out, now.data() + head, before.data() + head, count, costs.changed);
+        }
+        if (costs.difference < whole) {
+            *out++ = static_cast<uint8_t>(delta_tag::difference);
+            return f.encode_difference(out, now.data() + head, before.data() + head, count);
+        }
+        return encode_whole(out, now);
+    }
+
+public:
+    delta_encoder() = default;
+
+    // Per field, the bytes each of its elements takes, to compare them by, or 0 for a field only
+    // ever sent whole. big_endian is the byte order the records are serialised in.
+    delta_encoder(std::span<const size_t> element_sizes, bool big_endian)
+        : fields(bytestream::detail::delta_fields(element_sizes, big_endian)), big(big_endian) {}
+
+    // The most bytes a record of size bytes can encode to
+    [[nodiscard]] size_t max_size(size_t size) const {
+        using namespace bytestream::detail;
+        return delta_header_size + fields.size() * (1 + max_varint_length) + size;
+    }
+
+    // Makes the next record a keyframe
+    void reset() { has_reference = false; }
+
+    // Resizes out, anything with resize() and data() over bytes, to fit the delta record for
+    // record, whose fields begin at offsets and the last ends at offsets.back(), and fills it.
+    // The record is then what the next is compared with. Returns whether it was a keyframe,
+    // as it is if keyframe is set or nothing has been encoded since the last reset.
+    template <typename Buffer>
+    bool encode(std::span<const uint8_t> record, std::span<const size_t> offsets, bool keyframe, Buffer &out) {
+        using namespace bytestream::detail;
+        if (offsets.size() != fields.size() + 1 || offsets.front() != 0 || offsets.back() != record.size()) {
+            throw std::invalid_argument("Offsets don't split the record into its fields");
+        }
+        keyframe = keyframe || !has_reference;
+
+        out.resize(max_size(record.size()));
+        uint8_t *const begin = reinterpret_cast<uint8_t *>(out.data());
+        uint8_t *cursor = begin;
+        *cursor++ = static_cast<uint8_t>(keyframe ? delta_kind::keyframe : delta_kind::delta);
+        *cursor++ = static_cast<uint8_t>(big ? sequence >> 8 : sequence);
+        *cursor++ = static_cast<uint8_t>(big ? sequence : sequence >> 8);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const auto now = record.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+            cursor = keyframe ? encode_whole(cursor, now) : encode_field(i, cursor, now);
+        }
+        out.resize(static_cast<size_t>(cursor - begin));
+
+        reference.assign(record.begin(), record.end());
+        reference_offsets.assign(offsets.begin(), offsets.end());
+        has_reference = true;
+        ++sequence;
+        return keyframe;
+    }
+};
+
+// Rebuilds records from delta records. A delta that doesn't follow on from the last record,
+// because one was lost or no keyframe has come yet, can't be applied, and nothing can until the
+// next keyframe.
+class delta_decoder {
+    std::vector<bytestream::detail::delta_functions> fields;
+    bool big{false};
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> next;
+    std::vector<size_t> reference_offsets;
+    std::vector<size_t> next_offsets;
+    bool has_reference{false};
+    bool requested{false};
+    uint16_t sequence{0};
+
+public:
+    enum class outcome {
+        applied,
+        // A delta that couldn't be applied, the first since the last keyframe: time to ask for one
+        lost,
+        // One of the deltas after that
+        waiting
+    };
+
+    delta_decoder() = default;
+
+    // The same element sizes and byte order the records were encoded with, though a field only
+    // ever sent whole may be given a size too
+    delta_decoder(std::span<const size_t> element_sizes, bool big_endian)
+        : fields(bytestream::detail::delta_fields(element_sizes, big_endian)), big(big_endian) {}
+
+    // The last record rebuilt
+    [[nodiscard]] std::span<const uint8_t> record() const { return reference; }
+
+    // Rebuilds the record that bytes encode. Throws std::runtime_error, keeping the last record,
+    // if they are malformed.
+    outcome decode(std::span<const uint8_t> bytes) {
+        return decode(bytes, nullptr);
+    }
+
+    // As decode(), for the delta record at the start of bytes, setting length to the bytes it
+    // takes. One that can't be applied can't be measured either, so takes the rest of them.
+    outcome decode_first(std::span<const uint8_t> bytes, size_t &length) {
+        length = bytes.size();
+        return decode(bytes, &length);
+    }
+
+private:
+    // With length, reads what the record's fields take and leaves the rest
+    outcome decode(std::span<const uint8_t> bytes, size_t *length) {
+        using namespace bytestream::detail;
+        if (bytes.size() < delta_header_size || bytes[0] > static_cast<uint8_t>(delta_kind::delta)) {
+            throw std::runtime_error("Not a delta record");
+        }
+        const bool keyframe = bytes[0] == static_cast<uint8_t>(delta_kind::keyframe);
+        const auto number = static_cast<uint16_t>(big ? bytes[1] << 8 | bytes[2] : bytes[2] << 8 | bytes[1]);
+        if (!keyframe && !(has_reference && number == static_cast<uint16_t>(sequence + 1))) {
+            has_reference = false;
+            if (requested) {
+                return outcome::waiting;
+            }
+            requested = true;
+            return outcome::lost;
+        }
+
+        const uint8_t *in = bytes.data() + delta_header_size;
+        const uint8_t *const end = bytes.data() + bytes.size();
+        const auto malformed = [] { return std::runtime_error("Malformed delta record"); };
+        next.clear();
+        next_offsets.assign(1, 0);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (in == end) {
+                throw malformed();
+            }
+            const auto tag = static_cast<delta_tag>(*in++);
+            if (keyframe && tag != delta_tag::whole) {
+                throw std::runtime_error("A keyframe can only hold whole fields");
+            }
+            const size_t offset = next.size();
+            switch (tag) {
+                case delta_tag::whole: {
+                    uint64_t size;
+                    in = varint_decode(in, end, size);
+                    if (!in || size > static_cast<size_t>(end - in)) {
+                        throw malformed();
+                    }
+                    next.insert(next.end(), in, in + size);
+                    in += size;
+                    break;
+                }
+                case delta_tag::same:
+                case delta_tag::sparse:
+                case delta_tag::difference: {
+                    next.insert(next.end(), reference.begin() + static_cast<std::ptrdiff_t>(reference_offsets[i]),
+                                reference.begin() + static_cast<std::ptrdiff_t>(reference_offsets[i + 1]));
+                    if (tag == delta_tag::same) {
+                        break;
+                    }
+                    const delta_functions &f = fields[i];
+                    if (!f.size) {
+                        throw std::runtime_error("Field " + std::to_string(i) + " can only be sent whole");
+                    }
+                    const size_t size = next.size() - offset;
+                    uint8_t *elements = next.data() + offset + size % f.size;
+                    in = tag == delta_tag::sparse ? f.decode_sparse(in, end, elements, size / f.size)
+                                                  : f.decode_difference(in, end, elements, size / f.size);
+                    if (!in) {
+                        throw malformed();
+                    }
+                    break;
+                }
+                default:
+                    throw malformed();
+            }
+            next_offsets.push_back(next.size());
+        }
+        if (length) {
+            *length = static_cast<size_t>(in - bytes.data());
+        } else if (in != end) {
+            throw std::runtime_error("Delta record longer than its fields");
+        }
+
+        std::swap(reference, next);
+        std::swap(reference_offsets, next_offsets);
+        has_reference = true;
+        requested = false;
+        sequence = number;
+        return outcome::applied;
+    }
+};
+
+#endif //DELTA_RECORD_HPP
@@ -0,0 +1,102 @@
+//
+// Grow-only byte buffer that the streaming decoders assemble frames in, and the hooks they
+// use to check and hand on completed frames.
+//
+
+#ifndef FRAME_BUFFER_HPP
+#define FRAME_BUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Unlike std::vector, clearing keeps the storage and growing never zero-fills bytes that are
+// about to be overwritten, so once the largest frame has been seen no further allocation happens.
+// With a maximum size set, the storage for it is allocated up front and never grows.
+class frame_buffer {
+    std::vector<uint8_t> storage;
+    size_t length{0};
+    size_t max_length{std::numeric_limits<size_t>::max()};
+
+public:
+    // Returns space for n more bytes at the end of the frame, or nullptr if that would take the
+    // frame past its maximum size.
+    [[nodiscard]] constexpr uint8_t *extend(size_t n) {
+        if (n > max_length - length) {
+            return nullptr;
+        }
+        if (storage.size() < length + n) {
+            storage.resize(std::max(length + n, storage.size() * 2));
+        }
+        uint8_t *tail = storage.data() + length;
+        length += n;
+        return tail;
+    }
+
+    // Returns false, leaving the frame as it was, if it is already at its maximum size.
+    constexpr bool push_back(uint8_t byte) {
+        uint8_t *tail = extend(1);
+        if (tail) {
+            *tail = byte;
+        }
+        return tail != nullptr;
+    }
+
+    // Drops the last n bytes, e.g. space reserved by extend() that was not used.
+    constexpr void shrink_by(size_t n) {
+        length -= n;
+    }
+
+    constexpr void clear() {
+        length = 0;
+    }
+
+    constexpr void reserve(size_t capacity) {
+        if (storage.size() < capacity) {
+            storage.resize(capacity);
+        }
+    }
+
+    // Caps the frame at n bytes, allocating exactly that much storage, and clears it.
+    constexpr void set_max_size(size_t n) {
+        max_length = n;
+        length = 0;
+        storage.resize(n);
+        storage.shrink_to_fit();
+    }
+
+    [[nodiscard]] constexpr size_t max_size() const { return max_length; }
+
+    [[nodiscard]] constexpr size_t size() const { return length; }
+    [[nodiscard]] constexpr bool empty() const { return length == 0; }
+    [[nodiscard]] constexpr std::span<const uint8_t> view() const { return {storage.data(), length}; }
+};
+
+// The checksum interface the streaming decoders accept; this one checks nothing. Decoders
+// update() the checksum with every byte they append to a frame, trailer included, and a frame
+// is only handed on if valid() holds at its end. See CRC.hpp for real checksums.
+struct no_checksum {
+    static constexpr size_t size = 0;
+    constexpr void update(const uint8_t *, size_t) {}
+    [[nodiscard]] constexpr bool valid() const { return true; }
+    constexpr void reset() {}
+    template <typename OutputIt>
+    constexpr OutputIt write(OutputIt output) const { return output; }
+};
+
+// Hands a completed frame to sink with its checksum trailer removed, provided the checksum
+// holds. Returns false if the frame was dropped.
+template <typename Sink, typename Checksum>
+constexpr bool deliver_frame(std::span<const uint8_t> frame, Sink &sink, Checksum &checksum) {
+    const bool intact = frame.size() >= Checksum::size && checksum.valid();
+    if (intact) {
+        sink(frame.first(frame.size() - Checksum::size));
+    }
+    checksum.reset();
+    return intact;
+}
+
+#endif //FRAME_BUFFER_HPP
@@ -0,0 +1,76 @@
+//
+// FIFO of whole frames, for handing decoded frames on later than they arrive.
+//
+
+#ifndef FRAME_QUEUE_HPP
+#define FRAME_QUEUE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Frames are kept back to back in one byte buffer, with their lengths alongside. Popping only
+// moves a cursor; the space in front of it is reclaimed once it is half the buffer, or all at
+// once when the queue empties. Both buffers keep their capacity, so a queue that has reached
+// its working size no longer allocates. When max_frames are queued, pushing drops the oldest.
+class frame_queue {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> lengths;
+    size_t head_frame{0};
+    size_t head_byte{0};
+    size_t max_frames{std::numeric_limits<size_t>::max()};
+
+public:
+    // Returns false if the oldest frame was dropped to make room.
+    bool push(std::span<const uint8_t> frame) {
+        const bool room = size() < max_frames;
+        if (!room) {
+            pop();
+        }
+        if (head_byte && head_byte >= bytes.size() / 2) {
+            bytes.erase(bytes.begin(), bytes.begin() + static_cast<ptrdiff_t>(head_byte));
+            lengths.erase(lengths.begin(), lengths.begin() + static_cast<ptrdiff_t>(head_frame));
+            head_byte = 0;
+            head_frame = 0;
+        }
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+        lengths.push_back(frame.size());
+        return room;
+    }
+
+    // The oldest frame. Only valid until the queue is next pushed to.
+    [[nodiscard]] std::span<const uint8_t> front() const {
+        return {bytes.data() + head_byte, lengths[head_frame]};
+    }
+
+    void pop() {
+        head_byte += lengths[head_frame++];
+        if (head_frame == lengths.size()) {
+            clear();
+        }
+    }
+
+    void clear() {
+        bytes.clear();
+        lengths.clear();
+        head_frame = 0;
+        head_byte = 0;
+    }
+
+    // Drops the oldest frames if more than n are queued. The limit is at least one frame.
+    void set_max_frames(size_t n) {
+        max_frames = std::max<size_t>(n, 1);
+        while (size() > max_frames) {
+            pop();
+        }
+    }
+
+    [[nodiscard]] size_t get_max_frames() const { return max_frames; }
+    [[nodiscard]] size_t size() const { return lengths.size() - head_frame; }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+};
+
+#endif //FRAME_QUEUE_HPP
@@ -0,0 +1,105 @@
+//
+// Byte container that frames whatever is serialised into it, for use as the destination of
+// zpp::bits::out.
+//
+
+#ifndef FRAMED_WRITER_HPP
+#define FRAMED_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "COBS.hpp"
+#include "SLIP.hpp"
+
+// Framing policies for framed_writer: how much room the payload needs in front of and behind it,
+// and how to encode it once it is complete.
+struct cobs_framing {
+    static constexpr size_t tailroom = 1;
+
+    [[nodiscard]] static constexpr size_t headroom(size_t capacity) {
+        return cobs_in_place_headroom(capacity);
+    }
+
+    static size_t encode(std::vector<uint8_t> &storage, size_t offset, size_t length) {
+        return cobs_encode_frame_in_place(std::span(storage).first(offset + length + tailroom), offset);
+    }
+};
+
+struct slip_framing {
+    static constexpr size_t tailroom = 1;
+
+    [[nodiscard]] static constexpr size_t headroom(size_t) {
+        return 0;
+    }
+
+    // Escapes grow the frame by an amount only known once the payload is, so room for them is
+    // made here rather than up front
+    static size_t encode(std::vector<uint8_t> &storage, size_t, size_t length) {
+        const size_t encoded_length = slip_encoded_length(std::span(storage).first(length));
+        if (storage.size() < encoded_length) {
+            storage.resize(encoded_length);
+        }
+        return slip_encode_frame_in_place(storage, length);
+    }
+};
+
+// Looks like a resizable byte container to a serialiser, which writes the payload straight into
+// the buffer the frame is then encoded in. The payload is laid out with the headroom the framing
+// needs in front of it, so finish() can encode it in place: a record is serialised and framed
+// with one buffer and no copy in between. zpp::bits::out resizes its destination to fit when it
+// is done, so size() is then the payload length.
+template <typename Framing>
+class framed_writer {
+    std::vector<uint8_t> storage;
+    size_t offset{0};
+    size_t length{0};
+
+public:
+    using value_type = uint8_t;
+
+    framed_writer() = default;
+
+    // Writes into buffer's allocation, such as the frame a previous finish() handed over, so a
+    // writer made for every record need not allocate once records stop growing
+    explicit framed_writer(std::vector<uint8_t> buffer) : storage(std::move(buffer)) {
+        storage.clear();
+    }
+
+    [[nodiscard]] uint8_t *data() { return storage.data() + offset; }
+    [[nodiscard]] const uint8_t *data() const { return storage.data() + offset; }
+    [[nodiscard]] size_t size() const { return length; }
+
+    void resize(size_t n) {
+        const size_t capacity = storage.size() - offset - std::min(storage.size() - offset, Framing::tailroom);
+        if (storage.empty() || n > capacity) {
+            // Grow geometrically, moving what has been written so far up behind the larger headroom
+            const size_t new_capacity = std::max(n, 2 * capacity);
+            const size_t new_offset = Framing::headroom(new_capacity);
+            storage.resize(new_offset + new_capacity + Framing::tailroom);
+            if (new_offset != offset && length) {
+                std::memmove(storage.data() + new_offset, storage.data() + offset, length);
+            }
+            offset = new_offset;
+        }
+        length = n;
+    }
+
+    // Encodes the payload written so far and hands over the buffer holding the frame. The writer
+    // is left empty, ready for the next record.
+    [[nodiscard]] std::vector<uint8_t> finish() {
+        if (storage.empty()) {
+            resize(0);
+        }
+        storage.resize(Framing::encode(storage, offset, length));
+        offset = 0;
+        length = 0;
+        return std::move(storage);
+    }
+};
+
+#endif //FRAMED_WRITER_HPP
@@ -0,0 +1,222 @@
+//
+// Arrays of floats packed into fewer bytes for the wire and back: IEEE half precision, and
+// scaled fixed point in 8 or 16 bits.
+//
+
+#ifndef PACKED_FLOAT_HPP
+#define PACKED_FLOAT_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "cpu_features.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace bytestream::detail {
+
+// Rounds to the nearest half, ties to even; too large for a half becomes infinity, and NaN
+// stays NaN
+[[nodiscard]] inline uint16_t float_to_half(float value) {
+    constexpr uint32_t infinity = 255u << 23;
+    constexpr uint32_t half_overflow = (127u + 16) << 23;
+    constexpr uint32_t smallest_normal = 113u << 23;
+    constexpr uint32_t subnormal_magic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t bits = std::bit_cast<uint32_t>(value);
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7FFFFFFF;
+
+    uint32_t half;
+    if (bits >= half_overflow) {
+        half = bits > infinity ? 0x7E00 : 0x7C00;
+    } else if (bits < smallest_normal) {
+        // Adding the magic number lines the mantissa up with a half's subnormal one, and the
+        // addition rounds it to nearest even
+        const float aligned = std::bit_cast<float>(bits) + std::bit_cast<float>(subnormal_magic);
+        half = std::bit_cast<uint32_t>(aligned) - subnormal_magic;
+    } else {
+        const uint32_t odd = (bits >> 13) & 1;
+        bits += ((15u - 127) << 23) + 0xFFF + odd;
+        half = bits >> 13;
+    }
+    return static_cast<uint16_t>(half | sign);
+}
+
+[[nodiscard]] inline float half_to_float(uint16_t half) {
+    constexpr uint32_t exponent_mask = 0x7C00u << 13;
+    uint32_t bits = static_cast<uint32_t>(half & 0x7FFF) << 13;
+    const uint32_t exponent = bits & exponent_mask;
+    bits += (127u - 15) << 23;
+    if (exponent == exponent_mask) {
+        bits += (128u - 16) << 23; // infinity or NaN
+    } else if (exponent == 0) {
+        // Zero or subnormal: renormalise through the FPU
+        bits += 1u << 23;
+        bits = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113u << 23));
+    }
+    return std::bit_cast<float>(bits | static_cast<uint32_t>(half & 0x8000) << 16);
+}
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+// F16C converts eight at a time; these return how many they converted, the rest being left to
+// the scalar loop
+BYTESTREAM_TARGET("avx,f16c")
+inline size_t floats_to_halves_f16c(uint8_t *dst, const float *src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), halves);
+    }
+    return i;
+}
+
+BYTESTREAM_TARGET("avx,f16c")
+inline size_t halves_to_floats_f16c(float *dst, const uint8_t *src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2))));
+    }
+    return i;
+}
+#endif
+
+// count floats to halves at dst, in the machine's byte order. F16C converts eight at a time
+// where the CPU has it.
+inline void floats_to_halves(uint8_t *dst, const float *src, size_t count) {
+    size_t i = 0;
+#if defined(BYTESTREAM_X86_DISPATCH)
+    if (count >= 8 && cpu_has_f16c()) {
+        i = floats_to_halves_f16c(dst, src, count);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        vst1_u16(reinterpret_cast<uint16_t *>(dst + i * 2), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint16_t half = float_to_half(src[i]);
+        std::memcpy(dst + i * 2, &half, 2);
+    }
+}
+
+inline void halves_to_floats(float *dst, const uint8_t *src, size_t count) {
+    size_t i = 0;
+#if defined(BYTESTREAM_X86_DISPATCH)
+    if (count >= 8 && cpu_has_f16c()) {
+        i = halves_to_floats_f16c(dst, src, count);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t *>(src + i * 2)))));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint16_t half;
+        std::memcpy(&half, src + i * 2, 2);
+        dst[i] = half_to_float(half);
+    }
+}
+
+// A float times factor, rounded to nearest even and saturated to Raw's range. NaN becomes the
+// lowest value, as the vector path makes it.
+template <typename Raw>
+[[nodiscard]] inline Raw float_to_fixed(float value, float factor) {
+    constexpr auto lowest = static_cast<float>(std::numeric_limits<Raw>::lowest());
+    constexpr auto highest = static_cast<float>(std::numeric_limits<Raw>::max());
+    float scaled = value * factor;
+    if (!(scaled >= lowest)) {
+        scaled = lowest;
+    }
+    scaled = std::min(scaled, highest);
+    return static_cast<Raw>(std::nearbyint(scaled));
+}
+
+// count floats to fixed point elements of Raw at dst, each multiplied by factor first
+template <typename Raw>
+void floats_to_fixed(uint8_t *dst, const float *src, size_t count, float factor) {
+    static_assert(std::is_integral_v<Raw> && sizeof(Raw) <= 2, "Fixed point elements are 8 or 16 bits");
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 f = _mm_set1_ps(factor);
+    const __m128 lowest = _mm_set1_ps(static_cast<float>(std::numeric_limits<Raw>::lowest()));
+    const __m128 highest = _mm_set1_ps(static_cast<float>(std::numeric_limits<Raw>::max()));
+    const auto to_int = [&](const float *p) {
+        // max takes its second operand for NaN, so NaN saturates low
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(p), f), lowest), highest);
+        return _mm_cvtps_epi32(clamped);
+    };
+    for (; i + 8 <= count; i += 8) {
+        const __m128i a = to_int(src + i);
+        const __m128i b = to_int(src + i + 4);
+        if constexpr (std::is_same_v<Raw, int16_t>) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), _mm_packs_epi32(a, b));
+        } else if constexpr (std::is_same_v<Raw, uint16_t>) {
+            // No unsigned 32 to 16 pack before SSE4.1: shift to signed, pack, shift back
+            const __m128i bias = _mm_set1_epi32(32768);
+            const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), _mm_xor_si128(packed, _mm_set1_epi16(-32768)));
+        } else if constexpr (std::is_same_v<Raw, int8_t>) {
+            const __m128i words = _mm_packs_epi32(a, b);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi16(words, words));
+        } else {
+            const __m128i words = _mm_packs_epi32(a, b);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(words, words));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const Raw raw = float_to_fixed<Raw>(src[i], factor);
+        std::memcpy(dst + i * sizeof(Raw), &raw, sizeof(Raw));
+    }
+}
+
+// count fixed point elements of Raw at src to floats, each multiplied by factor
+template <typename Raw>
+void fixed_to_floats(float *dst, const uint8_t *src, size_t count, float factor) {
+    static_assert(std::is_integral_v<Raw> && sizeof(Raw) <= 2, "Fixed point elements are 8 or 16 bits");
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 f = _mm_set1_ps(factor);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i words;
+        if constexpr (sizeof(Raw) == 2) {
+            words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+        } else {
+            const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+            words = std::is_signed_v<Raw> ? _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8)
+                                          : _mm_unpacklo_epi8(bytes, zero);
+        }
+        __m128i low, high;
+        if constexpr (std::is_signed_v<Raw>) {
+            low = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+            high = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+        } else {
+            low = _mm_unpacklo_epi16(words, zero);
+            high = _mm_unpackhi_epi16(words, zero);
+        }
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(low), f));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), f));
+    }
+#endif
+    for (; i < count; ++i) {
+        Raw raw;
+        std::memcpy(&raw, src + i * sizeof(Raw), sizeof(Raw));
+        dst[i] = static_cast<float>(raw) * factor;
+    }
+}
+
+} // namespace bytestream::detail
+
+#endif //PACKED_FLOAT_HPP
@@ -0,0 +1,175 @@
+//
+// COBS encoding and decoding of multi-megabyte frames split across a worker_pool. Library only
+// for now: bs.encodeframe and bs.decodeframe frame a message at a time on the scheduler, and
+// don't own a pool.
+//
+
+#ifndef PARALLEL_COBS_HPP
+#define PARALLEL_COBS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "COBS.hpp"
+#include "byte_scan.hpp"
+#include "worker_pool.hpp"
+
+// Below a few hundred KB per thread, handing out the work costs more than it saves
+inline constexpr size_t cobs_parallel_segment_size = 256 * 1024;
+
+// Produces exactly what cobs_encode_frame() would, with the same room needed in output. The
+// input is cut into segments at block boundaries: just after a zero, or a multiple of 254 bytes
+// after the last one. A segment's encoding is then its input length plus one for every full
+// block that no zero ends, so a single scan for zeros gives every segment's place in output, and
+// the segments are encoded straight there in parallel.
+inline size_t cobs_encode_frame_parallel(std::span<const uint8_t> input, uint8_t *output, worker_pool &pool,
+                                         size_t segment_size = cobs_parallel_segment_size) {
+    using bytestream::detail::find_any;
+
+    const size_t nominal_count = input.size() / segment_size;
+    if (pool.size() < 2 || nominal_count < 2) {
+        return cobs_encode_frame(input, output);
+    }
+
+    // First and last zero of each nominal segment (nullptr if it has none), and the full blocks
+    // in the gaps between its zeros
+    struct zeros {
+        const uint8_t *first;
+        const uint8_t *last;
+        size_t full_blocks;
+    };
+    const uint8_t *const base = input.data();
+    std::vector<zeros> found(nominal_count);
+    pool.run(nominal_count, [&](size_t i) {
+        const uint8_t *begin = base + i * segment_size;
+        const uint8_t *end = i + 1 == nominal_count ? base + input.size() : begin + segment_size;
+        zeros z{find_any<0>(begin, end), nullptr, 0};
+        if (z.first == end) {
+            found[i] = {nullptr, nullptr, 0};
+            return;
+        }
+        z.last = z.first;
+        for (const uint8_t *next; (next = find_any<0>(z.last + 1, end)) != end; z.last = next) {
+            z.full_blocks += static_cast<size_t>(next - z.last - 1) / 0xFE;
+        }
+        found[i] = z;
+    });
+
+    // Move each nominal boundary onto a block boundary, tracking the full blocks before it
+    struct split {
+        size_t position;
+        size_t full_blocks;
+    };
+    std::vector<split> splits{{0, 0}};
+    const uint8_t *last_zero = base - 1; // the block before the first zero starts at 0
+    size_t full_blocks = 0;              // up to last_zero
+    for (size_t i = 0; i < nominal_count; ++i) {
+        if (i) {
+            split next;
+            if (const uint8_t *first = found[i].first) {
+                next = {static_cast<size_t>(first - base) + 1,
+                        full_blocks + static_cast<size_t>(first - last_zero - 1) / 0xFE};
+            } else {
+                const auto block_start = static_cast<size_t>(last_zero + 1 - base);
+                const size_t blocks = (i * segment_size - block_start) / 0xFE;
+                next = {block_start + blocks * 0xFE, full_blocks + blocks};
+            }
+            if (next.position > splits.back().position && next.position < input.size()) {
+                splits.push_back(next);
+            }
+        }
+        if (found[i].first) {
+            full_blocks += static_cast<size_t>(found[i].first - last_zero - 1) / 0xFE + found[i].full_blocks;
+            last_zero = found[i].last;
+        }
+    }
+
+    std::vector<size_t> offsets(splits.size());
+    for (size_t i = 1; i < splits.size(); ++i) {
+        offsets[i] = offsets[i - 1] + (splits[i].position - splits[i - 1].position)
+                   + (splits[i].full_blocks - splits[i - 1].full_blocks);
+    }
+
+    const size_t segment_count = splits.size();
+    size_t last_segment_length = 0;
+    pool.run(segment_count, [&](size_t i) {
+        const size_t end = i + 1 == segment_count ? input.size() : splits[i + 1].position;
+        const auto piece = input.subspan(splits[i].position, end - splits[i].position);
+        COBSEncoder encoder(output + offsets[i]);
+        // The encoder's fixed 16-byte copies stay inside the segment's share of output as long
+        // as 15 more input bytes follow, so the last 15 go in on their own
+        const size_t held_back = std::min<size_t>(piece.size(), 15);
+        encoder.push(piece.first(piece.size() - held_back));
+        encoder.push(piece.last(held_back));
+        if (i + 1 == segment_count) {
+            last_segment_length = encoder.finish();
+        } else {
+            encoder.finish_segment();
+        }
+    });
+    return offsets.back() + last_segment_length;
+}
+
+// Produces exactly what cobs_decode_frame() would, with the same room needed in output. Block
+// boundaries are only known by following the code bytes from the start, so that walk is done up
+// front, one read per block, recording where each segment's output begins. The blocks
+// themselves are then checked and copied in parallel.
+[[nodiscard]] inline std::optional<size_t> cobs_decode_frame_parallel(
+    std::span<const uint8_t> input, uint8_t *output, worker_pool &pool,
+    size_t segment_size = cobs_parallel_segment_size) {
+    if (pool.size() < 2 || input.size() / segment_size < 2) {
+        return cobs_decode_frame(input, output);
+    }
+
+    struct segment {
+        size_t input_begin;
+        size_t input_end;
+        size_t output_begin;
+        bool zero_after; // a zero follows the segment's last block in the decoded frame
+    };
+    std::vector<segment> segments;
+
+    size_t position = 0;
+    size_t decoded_length = 0;
+    segment current{0, 0, 0, false};
+    while (position < input.size() && input[position]) {
+        const uint8_t code = input[position];
+        if (code > input.size() - position) {
+            return std::nullopt;
+        }
+        position += code;
+        const bool zero_after = code != 0xFF && position < input.size() && input[position];
+        decoded_length += code - 1 + zero_after;
+        if (position - current.input_begin >= segment_size) {
+            current.input_end = position;
+            current.zero_after = zero_after;
+            segments.push_back(current);
+            current = {position, position, decoded_length, false};
+        }
+    }
+    if (position > current.input_begin || segments.empty()) {
+        current.input_end = position;
+        segments.push_back(current);
+    }
+
+    std::atomic<bool> malformed{false};
+    pool.run(segments.size(), [&](size_t i) {
+        const segment &s = segments[i];
+        const auto decoded = cobs_decode_frame(input.subspan(s.input_begin, s.input_end - s.input_begin),
+                                               output + s.output_begin);
+        if (!decoded) {
+            malformed.store(true, std::memory_order_relaxed);
+        } else if (s.zero_after) {
+            output[s.output_begin + *decoded] = 0;
+        }
+    });
+    if (malformed.load(std::memory_order_relaxed)) {
+        return std::nullopt;
+    }
+    return decoded_length;
+}
+
+#endif //PARALLEL_COBS_HPP
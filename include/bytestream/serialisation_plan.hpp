@@ -0,0 +1,826 @@
+//
+// Flat description of a fixed schema, built once, that serialises its fields with a loop of
+// copies instead of dispatching on each field's type every time.
+//
+
+#ifndef SERIALISATION_PLAN_HPP
+#define SERIALISATION_PLAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "bit_packing.hpp"
+#include "byte_swap.hpp"
+#include "strided_copy.hpp"
+#include "varint.hpp"
+
+namespace bytestream::detail {
+
+// Copies count elements of Size bytes, reversing the bytes of each if Swap. The same function
+// serves reading and writing, since swapping is its own inverse.
+template <size_t Size, bool Swap>
+void copy_elements(uint8_t *dst, const uint8_t *src, size_t count) {
+    if (!count) {
+        return; // an empty vector's data() may be null
+    }
+    if constexpr (Swap && Size > 1) {
+        copy_swapped<Size>(dst, src, count);
+    } else {
+        std::memcpy(dst, src, count * Size);
+    }
+}
+
+using copy_function = void (*)(uint8_t *, const uint8_t *, size_t);
+
+template <size_t Size>
+constexpr copy_function copy_elements_for(bool swap) {
+    return swap ? &copy_elements<Size, true> : &copy_elements<Size, false>;
+}
+
+// Fills a fixed-size chunk and hands it to emit whenever it is full, so a payload of any size
+// is written through one chunk's worth of memory. Elements may straddle two chunks.
+template <typename Emit>
+class chunk_writer {
+    std::span<uint8_t> chunk;
+    Emit &emit;
+    size_t used{0};
+
+public:
+    chunk_writer(std::span<uint8_t> chunk, Emit &emit) : chunk(chunk), emit(emit) {}
+
+    void put(copy_function copy, const uint8_t *src, size_t count, size_t element_size) {
+        while (count) {
+            const size_t fit = std::min(count, (chunk.size() - used) / element_size);
+            if (fit) {
+                copy(chunk.data() + used, src, fit);
+                used += fit * element_size;
+                src += fit * element_size;
+                count -= fit;
+                continue;
+            }
+            uint8_t element[8];
+            copy(element, src, 1);
+            put_bytes(element, element_size);
+            src += element_size;
+            --count;
+        }
+    }
+
+    // As put, for elements lying stride bytes apart in src
+    void put_gathered(gather_function gather, const uint8_t *src, ptrdiff_t stride, size_t count,
+                      size_t element_size) {
+        while (count) {
+            const size_t fit = std::min(count, (chunk.size() - used) / element_size);
+            if (fit) {
+                gather(chunk.data() + used, src, fit, stride);
+                used += fit * element_size;
+                src += static_cast<ptrdiff_t>(fit) * stride;
+                count -= fit;
+                continue;
+            }
+            uint8_t element[8];
+            gather(element, src, 1, stride);
+            put_bytes(element, element_size);
+            src += stride;
+            --count;
+        }
+    }
+
+    void put_bytes(const uint8_t *src, size_t n) {
+        while (n) {
+            if (used == chunk.size()) {
+                flush();
+            }
+            const size_t fit = std::min(n, chunk.size() - used);
+            std::memcpy(chunk.data() + used, src, fit);
+            used += fit;
+            src += fit;
+            n -= fit;
+        }
+    }
+
+    void flush() {
+        if (used) {
+            emit(std::span<const uint8_t>(chunk.first(used)));
+            used = 0;
+        }
+    }
+};
+
+} // namespace bytestream::detail
+
+// Fields are written back to back in the order they were added, in the byte order chosen at
+// construction. A fixed field is just its elements; a variable field is a 32-bit element count
+// followed by its elements, as zpp::bits lays out a sized std::vector. A fixed field's
+// elements must stay where they were when it was added; a variable field's vector is looked
+// at afresh every time, so it may be resized in between.
+//
+// Integer fields may instead be encoded as LEB128 varints, zigzagged first for signed values,
+// one to ten bytes an element whatever the byte order. Their size then depends on their values,
+// and they can't take a strided source.
+//
+// Bit fields take 1 to 32 bits an element. A run of bit fields is packed as one group, each
+// field's bits straight after the last's, and the group is padded to a whole byte before the
+// next field. Bits go MSB first when the byte order is big-endian and LSB first when it is
+// little-endian; see bit_packing.hpp. A variable bit field's count comes first and its elements
+// start a new group. Bit fields can't take a strided source either.
+class serialisation_plan {
+    using copy_function = bytestream::detail::copy_function;
+    using size_prefix = uint32_t;
+
+public:
+    enum class encoding { raw, varint, zigzag };
+
+private:
+    struct step {
+        uint8_t *data;                  // fixed fields
+        void *vector;                   // variable fields, nullptr for fixed ones
+        size_t count;                   // elements, for fixed fields
+        size_t element_size;
+        copy_function copy;
+        bytestream::detail::deinterleave_function deinterleave;
+        bytestream::detail::gather_function gather;
+        // For variable fields: the vector's elements, and resizing it to a number of elements
+        uint8_t *(*elements)(void *vector, size_t &count);
+        uint8_t *(*resize)(void *vector, size_t count);
+        // For varint fields, nullptr for raw ones
+        bytestream::detail::encoded_size_function encoded_size;
+        bytestream::detail::encode_function encode;
+        bytestream::detail::decode_function decode;
+        // For bit fields: bits an element takes, 0 for fields of whole bytes, and whether the
+        // field starts a group of bit fields packed together
+        unsigned bits;
+        bool starts_group;
+        bytestream::detail::pack_bits_function pack;
+        bytestream::detail::unpack_bits_function unpack;
+    };
+
+    std::vector<step> steps;
+    size_t fixed_size{0};
+    bool swap{false};
+    copy_function copy_prefix{bytestream::detail::copy_elements<sizeof(size_prefix), false>};
+
+    template <typename T>
+    static uint8_t *vector_elements(void *vector, size_t &count) {
+        auto &v = *static_cast<std::vector<T> *>(vector);
+        count = v.size();
+        return reinterpret_cast<uint8_t *>(v.data());
+    }
+
+    template <typename T>
+    static uint8_t *vector_resize(void *vector, size_t count) {
+        auto &v = *static_cast<std::vector<T> *>(vector);
+        v.resize(count);
+        return reinterpret_cast<uint8_t *>(v.data());
+    }
+
+    // A step for elements of T encoded as e, its storage still to be filled in
+    template <typename T>
+    step make_step(encoding e) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        step s{nullptr, nullptr, 0, sizeof(T), bytestream::detail::copy_elements_for<sizeof(T)>(swap),
+               bytestream::detail::deinterleave_elements_for<sizeof(T)>(swap),
+               bytestream::detail::gather_elements_for<sizeof(T)>(swap), nullptr, nullptr,
+               nullptr, nullptr, nullptr, 0, false, nullptr, nullptr};
+        if (e == encoding::raw) {
+            return s;
+        }
+        if constexpr (std::is_integral_v<T> && (sizeof(T) == 4 || sizeof(T) == 8)) {
+            using namespace bytestream::detail;
+            if (e == encoding::zigzag) {
+                s.encoded_size = &varints_size<T, true>;
+                s.encode = &encode_varints<T, true>;
+                s.decode = &decode_varints<T, true>;
+            } else {
+                s.encoded_size = &varints_size<T, false>;
+                s.encode = &encode_varints<T, false>;
+                s.decode = &decode_varints<T, false>;
+            }
+            return s;
+        }
+        throw std::invalid_argument("Only 32 and 64 bit integers can be encoded as varints");
+    }
+
+    template <typename T>
+    step make_bit_step(unsigned bits) const {
+        static_assert(std::is_integral_v<T> && sizeof(T) <= 4, "Bit fields are held in integers of up to 32 bits");
+        if (bits < 1 || bits > sizeof(T) * 8) {
+            throw std::invalid_argument("A bit field's elements must take between 1 bit and the whole of their type");
+        }
+        step s = make_step<T>(encoding::raw);
+        s.bits = bits;
+        s.pack = &bytestream::detail::pack_bits<T>;
+        s.unpack = &bytestream::detail::unpack_bits<T>;
+        return s;
+    }
+
+public:
+    // Where a field's elements come from for one write() instead of its own storage, such as
+    // a locked jit matrix. Its elements must be the size of the field's own.
+    using strided_source = ::strided_source;
+
+    serialisation_plan() = default;
+
+    // swap: the byte order written differs from the machine's own
+    explicit serialisation_plan(bool swap)
+        : swap(swap), copy_prefix(bytestream::detail::copy_elements_for<sizeof(size_prefix)>(swap)) {}
+
+    [[nodiscard]] bool swaps() const { return swap; }
+    [[nodiscard]] size_t field_count() const { return steps.size(); }
+
+    // Throws std::invalid_argument if e is a varint encoding and T isn't a 32 or 64 bit integer
+    template <typename T>
+    void add_fixed(T *data, size_t count, encoding e = encoding::raw) {
+        step s = make_step<T>(e);
+        s.data = reinterpret_cast<uint8_t *>(data);
+        s.count = count;
+        steps.push_back(s);
+        if (!s.encode) {
+            fixed_size += count * sizeof(T);
+        }
+    }
+
+    template <typename T>
+    void add_variable(std::vector<T> &vector, encoding e = encoding::raw) {
+        step s = make_step<T>(e);
+        s.vector = &vector;
+        s.elements = &vector_elements<T>;
+        s.resize = &vector_resize<T>;
+        steps.push_back(s);
+        fixed_size += sizeof(size_prefix);
+    }
+
+    // A fixed field of bits bits an element, joining the group of the field before if that is
+    // a bit field too. Throws std::invalid_argument if bits is 0 or more than T holds.
+    template <typename T>
+    void add_bit_field(T *data, size_t count, unsigned bits) {
+        step s = make_bit_step<T>(bits);
+        s.data = reinterpret_cast<uint8_t *>(data);
+        s.count = count;
+        s.starts_group = steps.empty() || !steps.back().bits;
+        steps.push_back(s);
+    }
+
+    template <typename T>
+    void add_bit_field(std::vector<T> &vector, unsigned bits) {
+        step s = make_bit_step<T>(bits);
+        s.vector = &vector;
+        s.elements = &vector_elements<T>;
+        s.resize = &vector_resize<T>;
+        s.starts_group = true;
+        steps.push_back(s);
+        fixed_size += sizeof(size_prefix);
+    }
+
+    // The field whose bytes hold this one's: the field itself, or the first of a bit field's
+    // group
+    [[nodiscard]] size_t group_of(size_t field) const {
+        while (steps.at(field).bits && !steps[field].starts_group) {
+            --field;
+        }
+        return field;
+    }
+
+    // Bytes the fields currently serialise to, with sources standing in for their fields
+    [[nodiscard]] size_t size(std::span<const strided_source> sources = {}) const {
+        size_t total = fixed_size;
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const step &s = steps[i];
+            if (s.bits) {
+                if (s.starts_group) {
+                    total += bytestream::detail::packed_bytes(group_bits(i, element_count(i, sources)));
+                }
+            } else if (s.encode) {
+                size_t count;
+                const uint8_t *data = field_data(i, count);
+                total += s.encoded_size(data, count);
+            } else if (s.vector) {
+                total += element_count(i, sources) * s.element_size;
+            }
+        }
+        return total;
+    }
+
+    // Bytes one field currently serialises to, count included. A group of bit fields counts in
+    // full against its first field, and the others in it count as none.
+    [[nodiscard]] size_t field_size(size_t field, std::span<const strided_source> sources = {}) const {
+        const step &s = steps.at(field);
+        const size_t prefix = s.vector ? sizeof(size_prefix) : 0;
+        if (s.bits) {
+            return s.starts_group ? prefix + bytestream::detail::packed_bytes(group_bits(field, element_count(field, sources)))
+                                  : 0;
+        }
+        if (s.encode) {
+            size_t count;
+            const uint8_t *data = field_data(field, count);
+            return prefix + s.encoded_size(data, count);
+        }
+        return prefix + element_count(field, sources) * s.element_size;
+    }
+
+    // Resizes out, anything with resize() and data() over bytes, to fit and fills it. A field
+    // with a source is copied from there in the source's layout, swapping as it goes. If a
+    // source fails its bounds check, or a fixed field's source doesn't have exactly as many
+    // elements as the field, std::runtime_error is thrown before anything is written.
+    template <typename Buffer>
+    void write(Buffer &out, std::span<const strided_source> sources = {}) const {
+        check_sources(sources);
+        out.resize(size(sources));
+        uint8_t *cursor = reinterpret_cast<uint8_t *>(out.data());
+        for (size_t i = 0; i < steps.size(); ++i) {
+            cursor = write_step(i, cursor, sources);
+        }
+    }
+
+    // Writes just one field's field_size() bytes to dst, as write() would lay them out, for
+    // patching a previously written record in place. For a bit field that is its whole group,
+    // written where group_of(field) goes.
+    void write_field(size_t field, uint8_t *dst, std::span<const strided_source> sources = {}) const {
+        if (field >= steps.size()) {
+            throw std::out_of_range("No such field");
+        }
+        check_sources(sources);
+        write_step(group_of(field), dst, sources);
+    }
+
+    // Bytes of a field's count, before its elements: 4 for a variable field, none for a fixed one
+    [[nodiscard]] size_t prefix_size(size_t field) const {
+        return steps.at(field).vector ? sizeof(size_prefix) : 0;
+    }
+
+    // Fills a field that can take a source from elements as write() lays them out, without the
+    // count, which for a variable field is taken from how many there are. Reads back what a
+    // serialised source for the field holds. Throws std::runtime_error as check_sources() does.
+    void read_elements(size_t field, std::span<const uint8_t> elements) const {
+        const step &s = steps.at(field);
+        if (s.encode || s.bits) {
+            throw std::runtime_error("Varint and bit fields can't be copied from a source");
+        }
+        const size_t count = elements.size() / s.element_size;
+        if (!s.vector && count != s.count) {
+            throw std::runtime_error("Source does not match the size of its field");
+        }
+        uint8_t *data = s.vector ? s.resize(s.vector, count) : s.data;
+        s.copy(data, elements.data(), count);
+    }
+
+    // Writes what write() would, a chunk at a time: chunk is filled and passed to emit as a
+    // std::span<const uint8_t> over and over, the last one holding whatever remains. However
+    // large the fields, no more memory than chunk is used. Throws as write() does, before
+    // anything is emitted.
+    template <typename Emit>
+    void write_chunked(std::span<uint8_t> chunk, Emit &&emit, std::span<const strided_source> sources = {}) const {
+        if (chunk.empty()) {
+            throw std::invalid_argument("Chunks must hold at least one byte");
+        }
+        check_sources(sources);
+
+        bytestream::detail::chunk_writer<Emit> out(chunk, emit);
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const step &s = steps[i];
+            if (s.bits && !s.starts_group) {
+                continue; // written with the rest of its group
+            }
+            const strided_source *source = sources.empty() ? nullptr : find_source(sources, i);
+            const uint8_t *data = s.data;
+            size_t count = s.count;
+            if (source) {
+                count = source->count();
+            } else if (s.vector) {
+                data = s.elements(s.vector, count);
+            }
+            if (s.vector) {
+                const auto prefix = static_cast<size_prefix>(count);
+                out.put(copy_prefix, reinterpret_cast<const uint8_t *>(&prefix), 1, sizeof(size_prefix));
+            }
+
+            if (source) {
+                put_strided(out, *source, s);
+            } else if (s.bits) {
+                put_bit_group(out, i, data, count);
+            } else if (s.encode) {
+                // Encoded a batch at a time, so an element is never split mid-encode
+                constexpr size_t batch = 64;
+                uint8_t encoded[batch * 10];
+                for (size_t done = 0; done < count; done += batch) {
+                    const size_t n = std::min(batch, count - done);
+                    const uint8_t *end = s.encode(encoded, data + done * s.element_size, n);
+                    out.put_bytes(encoded, static_cast<size_t>(end - encoded));
+                }
+            } else {
+                out.put(s.copy, data, count, s.element_size);
+            }
+        }
+        out.flush();
+    }
+
+    // Fills the fields from input that arrives a piece at a time, as read() does from all of it
+    // at once, so it need never be held whole. Each piece is copied straight into the fields;
+    // only an element or count split between pieces is held back. The plan must not change
+    // while a reader is in use.
+    class reader {
+        const serialisation_plan *plan;
+        size_t unread;
+        size_t step_index{0};
+        bool counted{false};
+        uint8_t *data{nullptr};
+        size_t count{0};
+        size_t filled{0};
+        std::array<uint8_t, 16> partial{}; // an element, or a varint of up to ten bytes
+        size_t partial_length{0};
+        // The group of bit fields being read, and how many of its bytes are still to come
+        bytestream::detail::bit_reader bits;
+        size_t group_left{0};
+
+    public:
+        // length: the bytes that will be fed in all
+        reader(const serialisation_plan &plan, size_t length) : plan(&plan), unread(length) {}
+
+        // Reads what it can of input into the fields. Throws std::runtime_error if input takes
+        // the total past the length given, a count asks for more than can still come, or a
+        // varint is malformed. Bytes past the end of the schema are ignored, as read() ignores
+        // them.
+        void feed(std::span<const uint8_t> input) {
+            if (input.size() > unread) {
+                throw std::runtime_error("More bytes than were announced");
+            }
+            const uint8_t *cursor = input.data();
+            size_t n = input.size();
+            const auto advance = [&](size_t taken) {
+                cursor += taken;
+                n -= taken;
+                unread -= taken;
+            };
+            // Tops the held-back bytes up towards size, returning whether they got there
+            const auto gather = [&](size_t size) {
+                const size_t taken = std::min(size - partial_length, n);
+                if (!taken) {
+                    return partial_length == size;
+                }
+                std::memcpy(partial.data() + partial_length, cursor, taken);
+                partial_length += taken;
+                advance(taken);
+                return partial_length == size;
+            };
+
+            while (!complete()) {
+                const step &s = plan->steps[step_index];
+                if (!counted) {
+                    if (s.vector) {
+                        if (!gather(sizeof(size_prefix))) {
+                            return;
+                        }
+                        size_prefix prefix;
+                        plan->copy_prefix(reinterpret_cast<uint8_t *>(&prefix), partial.data(), 1);
+                        partial_length = 0;
+                        if (!fits(s, prefix, unread)) {
+                            throw std::runtime_error("Not enough bytes for the schema");
+                        }
+                        count = prefix;
+                        data = s.resize(s.vector, count);
+                    } else {
+                        count = s.count;
+                        data = s.data;
+                    }
+                    if (s.starts_group) {
+                        bits = bytestream::detail::bit_reader(bytestream::detail::msb_first(plan->swap));
+                        group_left = bytestream::detail::packed_bytes(plan->group_bits(step_index, count));
+                    }
+                    counted = true;
+                    filled = 0;
+                }
+
+                if (s.bits) {
+                    // The bit reader holds on to any bits split between pieces itself
+                    const size_t available = std::min(n, group_left);
+                    bits.source(cursor, cursor + available);
+                    filled += s.unpack(bits, data + filled * s.element_size, count - filled, s.bits);
+                    const auto taken = static_cast<size_t>(bits.position() - cursor);
+                    group_left -= taken;
+                    advance(taken);
+                    if (filled < count) {
+                        return;
+                    }
+                    ++step_index;
+                    counted = false;
+                    continue;
+                }
+
+                if (s.decode) {
+                    // A varint split between pieces is gathered a byte at a time up to its last
+                    while (partial_length) {
+                        if (!n) {
+                            return;
+                        }
+                        const uint8_t byte = *cursor;
+                        partial[partial_length++] = byte;
+                        advance(1);
+                        if (!(byte & 0x80)) {
+                            decode_partial(s);
+                        } else if (partial_length == max_varint_length) {
+                            throw std::runtime_error("Malformed varint");
+                        }
+                    }
+                    size_t found;
+                    const size_t length = bytestream::detail::whole_varints(cursor, n, count - filled, found);
+                    if (found && s.decode(data + filled * s.element_size, cursor, cursor + length, found) == nullptr) {
+                        throw std::runtime_error("Malformed varint");
+                    }
+                    advance(length);
+                    filled += found;
+                    if (filled < count) {
+                        // All that is left of the piece is the start of the next varint
+                        if (n >= max_varint_length) {
+                            throw std::runtime_error("Malformed varint");
+                        }
+                        std::memcpy(partial.data(), cursor, n);
+                        partial_length = n;
+                        advance(n);
+                        return;
+                    }
+                    ++step_index;
+                    counted = false;
+                    continue;
+                }
+
+                if (partial_length) {
+                    if (!gather(s.element_size)) {
+                        return;
+                    }
+                    s.copy(data + filled * s.element_size, partial.data(), 1);
+                    ++filled;
+                    partial_length = 0;
+                }
+                const size_t whole = std::min(count - filled, n / s.element_size);
+                s.copy(data + filled * s.element_size, cursor, whole);
+                advance(whole * s.element_size);
+                filled += whole;
+                if (filled < count) {
+                    gather(s.element_size);
+                    return;
+                }
+
+                ++step_index;
+                counted = false;
+            }
+            unread -= n;
+        }
+
+        // Every field has been filled
+        [[nodiscard]] bool complete() const { return step_index == plan->steps.size(); }
+        // Bytes still to be fed of the length given
+        [[nodiscard]] size_t remaining() const { return unread; }
+
+    private:
+        static constexpr size_t max_varint_length = 10;
+
+        void decode_partial(const step &s) {
+            if (!s.decode(data + filled * s.element_size, partial.data(), partial.data() + partial_length, 1)) {
+                throw std::runtime_error("Malformed varint");
+            }
+            ++filled;
+            partial_length = 0;
+        }
+    };
+
+    // Fills the fields from input, resizing variable ones to the counts it gives, and returns
+    // the bytes taken; any after them are left, for the next record. Throws std::runtime_error
+    // if input runs out first; fields before that point are filled.
+    size_t read(std::span<const uint8_t> input) const {
+        const uint8_t *cursor = input.data();
+        size_t remaining = input.size();
+        const auto take = [&](size_t n) {
+            if (n > remaining) {
+                throw std::runtime_error("Not enough bytes for the schema");
+            }
+            const uint8_t *taken = cursor;
+            cursor += n;
+            remaining -= n;
+            return taken;
+        };
+
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const step &s = steps[i];
+            if (s.bits && !s.starts_group) {
+                continue; // read with the rest of its group
+            }
+            uint8_t *data = s.data;
+            size_t count = s.count;
+            if (s.vector) {
+                size_prefix prefix;
+                copy_prefix(reinterpret_cast<uint8_t *>(&prefix), take(sizeof(size_prefix)), 1);
+                count = prefix;
+                if (!fits(s, count, remaining)) {
+                    throw std::runtime_error("Not enough bytes for the schema");
+                }
+                data = s.resize(s.vector, count);
+            }
+            if (s.bits) {
+                const size_t length = bytestream::detail::packed_bytes(group_bits(i, count));
+                const uint8_t *group = take(length);
+                bytestream::detail::bit_reader reader(bytestream::detail::msb_first(swap));
+                reader.source(group, group + length);
+                s.unpack(reader, data, count, s.bits);
+                for (size_t member = i; !ends_group(member);) {
+                    const step &m = steps[++member];
+                    m.unpack(reader, m.data, m.count, m.bits);
+                }
+                continue;
+            }
+            if (s.decode) {
+                const uint8_t *end = s.decode(data, cursor, cursor + remaining, count);
+                if (!end) {
+                    throw std::runtime_error("Malformed varint, or not enough bytes for the schema");
+                }
+                take(static_cast<size_t>(end - cursor));
+                continue;
+            }
+            s.copy(data, take(count * s.element_size), count);
+        }
+        return input.size() - remaining;
+    }
+
+private:
+    // Whether count elements of a field could fit in bytes
+    [[nodiscard]] static bool fits(const step &s, size_t count, size_t bytes) {
+        if (s.bits) {
+            return count <= bytes * 8 / s.bits;
+        }
+        return count <= bytes / (s.encode ? 1 : s.element_size);
+    }
+
+    [[nodiscard]] bool ends_group(size_t field) const {
+        return field + 1 == steps.size() || !steps[field + 1].bits || steps[field + 1].starts_group;
+    }
+
+    // Bits in the group of bit fields starting at field, whose own count is count
+    [[nodiscard]] size_t group_bits(size_t field, size_t count) const {
+        size_t bits = count * steps[field].bits;
+        while (!ends_group(field)) {
+            const step &member = steps[++field];
+            bits += member.count * member.bits;
+        }
+        return bits;
+    }
+
+    // Packs the group of bit fields starting at field at cursor, returning where the next field
+    // goes
+    uint8_t *write_bit_group(size_t field, uint8_t *cursor, const uint8_t *data, size_t count) const {
+        bytestream::detail::bit_writer writer(bytestream::detail::msb_first(swap));
+        cursor = steps[field].pack(writer, cursor, data, count, steps[field].bits);
+        while (!ends_group(field)) {
+            const step &member = steps[++field];
+            cursor = member.pack(writer, cursor, member.data, member.count, member.bits);
+        }
+        return writer.finish(cursor);
+    }
+
+    // As write_bit_group(), a batch of elements at a time
+    template <typename Writer>
+    void put_bit_group(Writer &out, size_t field, const uint8_t *data, size_t count) const {
+        constexpr size_t batch = 64;
+        uint8_t packed[batch * 4 + 8];
+        bytestream::detail::bit_writer writer(bytestream::detail::msb_first(swap));
+        for (;;) {
+            const step &s = steps[field];
+            for (size_t done = 0; done < count; done += batch) {
+                const size_t n = std::min(batch, count - done);
+                const uint8_t *end = s.pack(writer, packed, data + done * s.element_size, n, s.bits);
+                out.put_bytes(packed, static_cast<size_t>(end - packed));
+            }
+            if (ends_group(field)) {
+                break;
+            }
+            ++field;
+            data = steps[field].data;
+            count = steps[field].count;
+        }
+        const uint8_t *end = writer.finish(packed);
+        out.put_bytes(packed, static_cast<size_t>(end - packed));
+    }
+
+    // A field's own elements, wherever they currently are
+    [[nodiscard]] const uint8_t *field_data(size_t field, size_t &count) const {
+        const step &s = steps[field];
+        count = s.count;
+        return s.vector ? s.elements(s.vector, count) : s.data;
+    }
+
+    [[nodiscard]] size_t element_count(size_t field, std::span<const strided_source> sources) const {
+        const step &s = steps[field];
+        if (const strided_source *source = find_source(sources, field)) {
+            return source->count();
+        }
+        size_t count = s.count;
+        if (s.vector) {
+            s.elements(s.vector, count);
+        }
+        return count;
+    }
+
+    // Writes a field at cursor, returning where the next one goes
+    uint8_t *write_step(size_t field, uint8_t *cursor, std::span<const strided_source> sources) const {
+        const step &s = steps[field];
+        if (s.bits && !s.starts_group) {
+            return cursor; // written with the rest of its group
+        }
+        const strided_source *source = sources.empty() ? nullptr : find_source(sources, field);
+        const uint8_t *data = s.data;
+        size_t count = s.count;
+        if (source) {
+            count = source->count();
+        } else if (s.vector) {
+            data = s.elements(s.vector, count);
+        }
+        if (s.vector) {
+            const auto prefix = static_cast<size_prefix>(count);
+            copy_prefix(cursor, reinterpret_cast<const uint8_t *>(&prefix), 1);
+            cursor += sizeof(size_prefix);
+        }
+
+        if (source && source->serialised) {
+            // An empty field's bytes may have no data to point at
+            if (count) {
+                std::memcpy(cursor, source->data, count * s.element_size);
+            }
+        } else if (source) {
+            copy_strided(cursor, *source, s.element_size, s.copy, s.deinterleave);
+        } else if (s.bits) {
+            return write_bit_group(field, cursor, data, count);
+        } else if (s.encode) {
+            return s.encode(cursor, data, count);
+        } else {
+            s.copy(cursor, data, count);
+        }
+        return cursor + count * s.element_size;
+    }
+
+    void check_sources(std::span<const strided_source> sources) const {
+        for (const strided_source &source : sources) {
+            const step &s = steps.at(source.field);
+            if (s.encode || s.bits) {
+                throw std::runtime_error("Varint and bit fields can't be copied from a source");
+            }
+            source.check(s.element_size);
+            if (!s.vector && source.count() != s.count) {
+                throw std::runtime_error("Source does not match the size of its field");
+            }
+        }
+    }
+
+    template <typename Writer>
+    static void put_strided(Writer &out, const strided_source &source, const step &s) {
+        const size_t element_size = s.element_size;
+        if (source.serialised) {
+            out.put_bytes(source.data, source.count() * element_size);
+            return;
+        }
+        if (!source.planar || source.planes == 1) {
+            if (source.contiguous(element_size)) {
+                out.put(s.copy, source.data, source.count(), element_size);
+                return;
+            }
+            const bool dense_runs = source.stride[0] == static_cast<ptrdiff_t>(source.planes * element_size);
+            bytestream::detail::for_each_run(source, [&](const uint8_t *run) {
+                if (dense_runs) {
+                    out.put(s.copy, run, source.dim[0] * source.planes, element_size);
+                    return;
+                }
+                if (source.planes == 1) {
+                    out.put_gathered(s.gather, run, source.stride[0], source.dim[0], element_size);
+                    return;
+                }
+                for (size_t i = 0; i < source.dim[0]; ++i) {
+                    out.put(s.copy, run + static_cast<ptrdiff_t>(i) * source.stride[0], source.planes, element_size);
+                }
+            });
+            return;
+        }
+
+        // Planar output goes out in order, one plane after another, so each plane is gathered
+        // from its cells a run at a time straight into the chunk
+        for (size_t p = 0; p < source.planes; ++p) {
+            bytestream::detail::for_each_run(source, [&](const uint8_t *run) {
+                out.put_gathered(s.gather, run + p * element_size, source.stride[0], source.dim[0], element_size);
+            });
+        }
+    }
+
+    [[nodiscard]] static const strided_source *find_source(std::span<const strided_source> sources, size_t field) {
+        for (const strided_source &source : sources) {
+            if (source.field == field) {
+                return &source;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif //SERIALISATION_PLAN_HPP
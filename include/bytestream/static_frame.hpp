@@ -0,0 +1,67 @@
+//
+// Frames encoded at compile time, for fixed messages whose bytes are known when building.
+//
+
+#ifndef STATIC_FRAME_HPP
+#define STATIC_FRAME_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "COBS.hpp"
+#include "LEB128.hpp"
+#include "SLIP.hpp"
+
+// Spells out a payload for the functions below, e.g. cobs_frame<frame_bytes(0x01, 0x00, 0x7F)>().
+// A value outside 0-255 fails to compile.
+template <typename... Bytes>
+    requires (std::is_integral_v<Bytes> && ...)
+consteval std::array<uint8_t, sizeof...(Bytes)> frame_bytes(Bytes... bytes) {
+    if (((bytes < 0 || bytes > 0xFF) || ...)) {
+        throw "frame_bytes: value out of range for a byte";
+    }
+    return {static_cast<uint8_t>(bytes)...};
+}
+
+namespace bytestream::detail {
+// Encodes into the worst-case size first, then copies into an array of exactly the encoded size
+template <std::array Payload, size_t MaxLength, typename Encode>
+consteval auto static_frame(Encode encode) {
+    static_assert(std::is_same_v<typename decltype(Payload)::value_type, uint8_t>,
+                  "Payload must be a std::array of uint8_t");
+    constexpr auto encoded = [encode] {
+        std::array<uint8_t, MaxLength> buffer{};
+        const size_t length = encode(Payload.begin(), Payload.size(), buffer.begin());
+        return std::pair{buffer, length};
+    }();
+    std::array<uint8_t, encoded.second> frame{};
+    std::copy_n(encoded.first.begin(), encoded.second, frame.begin());
+    return frame;
+}
+} // namespace bytestream::detail
+
+// The same bytes cobs_encode_frame() produces for Payload, delimiter included, as a constant
+template <std::array Payload>
+consteval auto cobs_frame() {
+    return bytestream::detail::static_frame<Payload, cobs_encoded_max_length(Payload.size())>(
+        [](auto first, size_t size, auto output) { return cobs_encode_frame(first, size, output); });
+}
+
+// The same bytes slip_encode_frame() produces for Payload, delimiter included, as a constant
+template <std::array Payload>
+consteval auto slip_frame() {
+    return bytestream::detail::static_frame<Payload, 2 * Payload.size() + 1>(
+        [](auto first, size_t size, auto output) { return slip_encode_frame(first, size, output); });
+}
+
+// The same bytes leb128_encode_frame() produces for Payload, as a constant
+template <std::array Payload>
+consteval auto leb128_frame() {
+    return bytestream::detail::static_frame<Payload, leb128_encoded_length(Payload.size())>(
+        [](auto first, size_t size, auto output) { return leb128_encode_frame(first, size, output); });
+}
+
+#endif //STATIC_FRAME_HPP
@@ -0,0 +1,373 @@
+//
+// Copies out of N-dimensional arrays of multi-element cells laid out with arbitrary strides, such
+// as jit matrices, either interleaved as they are in memory or one plane after another.
+//
+
+#ifndef STRIDED_COPY_HPP
+#define STRIDED_COPY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "byte_swap.hpp"
+
+#if defined(__SSE2__) && !defined(BYTESTREAM_X86_DISPATCH)
+#include <emmintrin.h>
+#endif
+
+// A source of dim[0] * ... * dim[dimcount - 1] cells of planes elements each. stride[d] is the
+// distance in bytes from one cell to the next along dimension d, so rows may be padded, and
+// bytes is how far past data may be read. planar asks for the elements to be copied out as
+// whole planes one after another rather than interleaved cell by cell. field is the
+// serialisation_plan field the source stands in for. serialised marks elements already written
+// out in the plan's byte order, such as a field's bytes kept from an earlier record, which are
+// copied as they are.
+struct strided_source {
+    static constexpr size_t max_dims = 32;
+
+    size_t field{0};
+    const uint8_t *data{nullptr};
+    size_t bytes{0};
+    size_t dimcount{1};
+    std::array<size_t, max_dims> dim{};
+    std::array<ptrdiff_t, max_dims> stride{};
+    size_t planes{1};
+    bool planar{false};
+    bool serialised{false};
+
+    [[nodiscard]] size_t cells() const {
+        size_t n = 1;
+        for (size_t d = 0; d < dimcount; ++d) {
+            n *= dim[d];
+        }
+        return n;
+    }
+
+    [[nodiscard]] size_t count() const { return cells() * planes; }
+
+    // Throws std::runtime_error unless every cell of element_size elements lies within bytes
+    // of data without overlapping the next one along, and the element count fits a size_t
+    void check(size_t element_size) const {
+        if (dimcount < 1 || dimcount > max_dims || planes < 1) {
+            throw std::runtime_error("Source must have 1 to 32 dimensions and at least one plane");
+        }
+        if (dim[0] > 1 && stride[0] < static_cast<ptrdiff_t>(planes * element_size)) {
+            throw std::runtime_error("Source cells are smaller than their elements");
+        }
+        constexpr size_t max = std::numeric_limits<size_t>::max();
+        size_t n = planes;
+        size_t extent = planes * element_size;
+        for (size_t d = 0; d < dimcount; ++d) {
+            if (!dim[d]) {
+                return;
+            }
+            if (stride[d] < 0 || n > max / dim[d]) {
+                throw std::runtime_error("Source dimensions out of range");
+            }
+            n *= dim[d];
+            const auto step = static_cast<size_t>(stride[d]);
+            if (step && dim[d] - 1 > (max - extent) / step) {
+                throw std::runtime_error("Source dimensions out of range");
+            }
+            extent += (dim[d] - 1) * step;
+        }
+        if (n > max / element_size || extent > bytes || (!data && extent)) {
+            throw std::runtime_error("Source runs past the end of its data");
+        }
+    }
+
+    // Cells follow one another with no gaps, so the source is one run of cells
+    [[nodiscard]] bool contiguous(size_t element_size) const {
+        auto expected = static_cast<ptrdiff_t>(planes * element_size);
+        for (size_t d = 0; d < dimcount; ++d) {
+            if (dim[d] > 1 && stride[d] != expected) {
+                return false;
+            }
+            expected *= static_cast<ptrdiff_t>(dim[d]);
+        }
+        return true;
+    }
+};
+
+namespace bytestream::detail {
+
+template <size_t Size, bool Swap>
+inline void copy_element(uint8_t *dst, const uint8_t *src) {
+    if constexpr (Swap && Size > 1) {
+        typename swap_word<Size>::type value;
+        std::memcpy(&value, src, Size);
+        value = byteswap(value);
+        std::memcpy(dst, &value, Size);
+    } else {
+        std::memcpy(dst, src, Size);
+    }
+}
+
+// Cells first to last of deinterleave_elements, one element at a time; Planes is 0 if the plane
+// count is only known at run time
+template <size_t Size, bool Swap, size_t Planes>
+inline void deinterleave_cells(uint8_t *dst, size_t plane_stride, const uint8_t *src, size_t first, size_t last,
+                               size_t planes) {
+    if constexpr (Planes) {
+        planes = Planes;
+    }
+    for (size_t i = first; i < last; ++i) {
+        for (size_t p = 0; p < planes; ++p) {
+            copy_element<Size, Swap>(dst + p * plane_stride + i * Size, src + (i * planes + p) * Size);
+        }
+    }
+}
+
+#if defined(__SSE2__)
+// Transposes four registers of four 32-bit words, each holding one word of four planes, and
+// stores each plane's at offset
+inline void transpose_store(uint8_t *dst, size_t plane_stride, __m128i a, __m128i b, __m128i c, __m128i d,
+                            size_t offset) {
+    const __m128i ab_low = _mm_unpacklo_epi32(a, b);
+    const __m128i cd_low = _mm_unpacklo_epi32(c, d);
+    const __m128i ab_high = _mm_unpackhi_epi32(a, b);
+    const __m128i cd_high = _mm_unpackhi_epi32(c, d);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + offset), _mm_unpacklo_epi64(ab_low, cd_low));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + plane_stride + offset), _mm_unpackhi_epi64(ab_low, cd_low));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * plane_stride + offset), _mm_unpacklo_epi64(ab_high, cd_high));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * plane_stride + offset), _mm_unpackhi_epi64(ab_high, cd_high));
+}
+#endif
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+// Four-plane cells of bytes, sixteen at a time: gathers each plane's byte of four cells into one
+// word, then transposes the words. Returns the cells split.
+BYTESTREAM_TARGET("ssse3")
+inline size_t deinterleave4_bytes_ssse3(uint8_t *dst, size_t plane_stride, const uint8_t *src, size_t count) {
+    const __m128i group = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8_t *cells = src + i * 4;
+        const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells)), group);
+        const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + 16)), group);
+        const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + 32)), group);
+        const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells + 48)), group);
+        transpose_store(dst, plane_stride, a, b, c, d, i);
+    }
+    return i;
+}
+
+// Four-plane cells of 4-byte words, four at a time, reversing the bytes of each word. Returns
+// the cells split.
+BYTESTREAM_TARGET("ssse3")
+inline size_t deinterleave4_swapped_words_ssse3(uint8_t *dst, size_t plane_stride, const uint8_t *src,
+                                                size_t count) {
+    const __m128i shuffle = swap_shuffle<4>();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const auto load = [&](size_t offset) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 16 + offset));
+        };
+        transpose_store(dst, plane_stride, _mm_shuffle_epi8(load(0), shuffle), _mm_shuffle_epi8(load(16), shuffle),
+                        _mm_shuffle_epi8(load(32), shuffle), _mm_shuffle_epi8(load(48), shuffle), i * 4);
+    }
+    return i;
+}
+#endif
+
+// Splits count interleaved cells of planes elements of Size bytes into planes, plane p going
+// to dst + p * plane_stride, reversing the bytes of each element if Swap. Four-plane cells of
+// 1 and 4 byte elements, ARGB char and float32 or long matrices, are split with vector
+// shuffles.
+template <size_t Size, bool Swap>
+void deinterleave_elements(uint8_t *dst, size_t plane_stride, const uint8_t *src, size_t count, size_t planes) {
+    if (planes == 1) {
+        if (!count) {
+            return;
+        }
+        if constexpr (Swap && Size > 1) {
+            copy_swapped<Size>(dst, src, count);
+        } else {
+            std::memcpy(dst, src, count * Size);
+        }
+        return;
+    }
+
+    size_t i = 0;
+    if (planes == 4) {
+#if defined(__SSE2__)
+        [[maybe_unused]] const auto load = [&](size_t offset) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset));
+        };
+#endif
+        if constexpr (Size == 1) {
+#if defined(__SSE2__)
+#if defined(BYTESTREAM_X86_DISPATCH)
+            if (cpu_has_ssse3()) {
+                i = deinterleave4_bytes_ssse3(dst, plane_stride, src, count);
+            }
+#endif
+            // Without pshufb: shift each plane's byte to the bottom of its cell's word, mask it
+            // and pack the words of sixteen cells down to bytes
+            const __m128i low_byte = _mm_set1_epi32(0xFF);
+            for (; i + 16 <= count; i += 16) {
+                const __m128i a = load(i * 4);
+                const __m128i b = load(i * 4 + 16);
+                const __m128i c = load(i * 4 + 32);
+                const __m128i d = load(i * 4 + 48);
+                const auto pack_plane = [&](int shift) {
+                    const __m128i ab = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, shift), low_byte),
+                                                       _mm_and_si128(_mm_srli_epi32(b, shift), low_byte));
+                    const __m128i cd = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c, shift), low_byte),
+                                                       _mm_and_si128(_mm_srli_epi32(d, shift), low_byte));
+                    return _mm_packus_epi16(ab, cd);
+                };
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), pack_plane(0));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + plane_stride + i), pack_plane(8));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * plane_stride + i), pack_plane(16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * plane_stride + i), pack_plane(24));
+            }
+#elif defined(__ARM_NEON)
+            for (; i + 16 <= count; i += 16) {
+                const uint8x16x4_t split = vld4q_u8(src + i * 4);
+                vst1q_u8(dst + i, split.val[0]);
+                vst1q_u8(dst + plane_stride + i, split.val[1]);
+                vst1q_u8(dst + 2 * plane_stride + i, split.val[2]);
+                vst1q_u8(dst + 3 * plane_stride + i, split.val[3]);
+            }
+#endif
+        } else if constexpr (Size == 4) {
+#if defined(__SSE2__)
+            // Swapping needs pshufb; without it, that is left to the scalar loop
+            if constexpr (Swap) {
+#if defined(BYTESTREAM_X86_DISPATCH)
+                if (cpu_has_ssse3()) {
+                    i = deinterleave4_swapped_words_ssse3(dst, plane_stride, src, count);
+                }
+#endif
+            } else {
+                for (; i + 4 <= count; i += 4) {
+                    transpose_store(dst, plane_stride, load(i * 16), load(i * 16 + 16), load(i * 16 + 32),
+                                    load(i * 16 + 48), i * 4);
+                }
+            }
+#elif defined(__ARM_NEON)
+            for (; i + 4 <= count; i += 4) {
+                uint32x4x4_t split = vld4q_u32(reinterpret_cast<const uint32_t *>(src + i * 16));
+                for (size_t p = 0; p < 4; ++p) {
+                    uint8x16_t bytes = vreinterpretq_u8_u32(split.val[p]);
+                    if constexpr (Swap) {
+                        bytes = vrev32q_u8(bytes);
+                    }
+                    vst1q_u8(dst + p * plane_stride + i * 4, bytes);
+                }
+            }
+#endif
+        }
+    }
+
+    // Common plane counts get a loop the compiler can unroll
+    switch (planes) {
+        case 2: deinterleave_cells<Size, Swap, 2>(dst, plane_stride, src, i, count, planes); break;
+        case 3: deinterleave_cells<Size, Swap, 3>(dst, plane_stride, src, i, count, planes); break;
+        case 4: deinterleave_cells<Size, Swap, 4>(dst, plane_stride, src, i, count, planes); break;
+        default: deinterleave_cells<Size, Swap, 0>(dst, plane_stride, src, i, count, planes); break;
+    }
+}
+
+using deinterleave_function = void (*)(uint8_t *, size_t, const uint8_t *, size_t, size_t);
+
+template <size_t Size>
+constexpr deinterleave_function deinterleave_elements_for(bool swap) {
+    return swap ? &deinterleave_elements<Size, true> : &deinterleave_elements<Size, false>;
+}
+
+// Copies count elements lying stride bytes apart in src to dst back to back, such as one plane of
+// a run of cells, swapping their bytes if asked
+template <size_t Size, bool Swap>
+void gather_elements(uint8_t *dst, const uint8_t *src, size_t count, ptrdiff_t stride) {
+    for (size_t i = 0; i < count; ++i) {
+        copy_element<Size, Swap>(dst + i * Size, src + static_cast<ptrdiff_t>(i) * stride);
+    }
+}
+
+using gather_function = void (*)(uint8_t *, const uint8_t *, size_t, ptrdiff_t);
+
+template <size_t Size>
+constexpr gather_function gather_elements_for(bool swap) {
+    return swap ? &gather_elements<Size, true> : &gather_elements<Size, false>;
+}
+
+// Calls fn with a pointer to the first cell of each run of dim[0] cells, the other dimensions
+// counting up from the first as in a row-major array
+template <typename F>
+void for_each_run(const strided_source &source, F &&fn) {
+    if (!source.cells()) {
+        return;
+    }
+    std::array<size_t, strided_source::max_dims> index{};
+    ptrdiff_t offset = 0;
+    while (true) {
+        fn(source.data + offset);
+        size_t d = 1;
+        for (; d < source.dimcount; ++d) {
+            offset += source.stride[d];
+            if (++index[d] < source.dim[d]) {
+                break;
+            }
+            offset -= source.stride[d] * static_cast<ptrdiff_t>(source.dim[d]);
+            index[d] = 0;
+        }
+        if (d >= source.dimcount) {
+            return;
+        }
+    }
+}
+
+} // namespace bytestream::detail
+
+// Copies source's count() elements of element_size bytes to dst, cell by cell or plane by
+// plane as it asks. copy and deinterleave are the kernels for element_size, swapping or not,
+// as from copy_elements_for and deinterleave_elements_for. The source must have been check()ed.
+inline void copy_strided(uint8_t *dst, const strided_source &source, size_t element_size,
+                         void (*copy)(uint8_t *, const uint8_t *, size_t),
+                         bytestream::detail::deinterleave_function deinterleave) {
+    const size_t cell_size = source.planes * element_size;
+    const bool planar = source.planar && source.planes > 1;
+    const size_t plane_stride = source.cells() * element_size;
+
+    if (source.contiguous(element_size)) {
+        if (planar) {
+            deinterleave(dst, plane_stride, source.data, source.cells(), source.planes);
+        } else {
+            copy(dst, source.data, source.count());
+        }
+        return;
+    }
+
+    const size_t run_length = source.dim[0];
+    const bool dense_runs = source.stride[0] == static_cast<ptrdiff_t>(cell_size);
+    bytestream::detail::for_each_run(source, [&](const uint8_t *run) {
+        if (dense_runs) {
+            if (planar) {
+                deinterleave(dst, plane_stride, run, run_length, source.planes);
+                dst += run_length * element_size;
+            } else {
+                copy(dst, run, run_length * source.planes);
+                dst += run_length * cell_size;
+            }
+            return;
+        }
+        for (size_t i = 0; i < run_length; ++i) {
+            const uint8_t *cell = run + static_cast<ptrdiff_t>(i) * source.stride[0];
+            if (planar) {
+                deinterleave(dst, plane_stride, cell, 1, source.planes);
+                dst += element_size;
+            } else {
+                copy(dst, cell, source.planes);
+                dst += cell_size;
+            }
+        }
+    });
+}
+
+#endif //STRIDED_COPY_HPP
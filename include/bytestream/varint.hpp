@@ -0,0 +1,380 @@
+//
+// Arrays of integers as unsigned LEB128 varints, optionally zigzag encoded first so that small
+// negative numbers stay short too, for fields whose values are mostly far below their width.
+//
+
+#ifndef VARINT_HPP
+#define VARINT_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "byte_swap.hpp"
+#include "cpu_features.hpp"
+
+// BMI2's pdep and pext spread and gather 7-bit groups in one instruction. They are used where the
+// CPU has them, through copies of the array kernels compiled for BMI2.
+#if defined(BYTESTREAM_X86_DISPATCH) && defined(__x86_64__)
+#define BYTESTREAM_VARINT_BMI2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace bytestream::detail {
+
+inline constexpr uint64_t varint_continuation_bits = 0x8080808080808080;
+
+[[nodiscard]] constexpr size_t varint_length(uint64_t value) {
+    return 1 + (static_cast<size_t>(std::bit_width(value | 1)) - 1) / 7;
+}
+
+// Small magnitudes of either sign to small unsigned numbers: 0, -1, 1, -2... to 0, 1, 2, 3...
+template <typename T>
+[[nodiscard]] constexpr std::make_unsigned_t<T> zigzag_encode(T value) {
+    using U = std::make_unsigned_t<T>;
+    return static_cast<U>(static_cast<U>(value) << 1) ^ static_cast<U>(value >> (std::numeric_limits<U>::digits - 1));
+}
+
+template <typename T>
+[[nodiscard]] constexpr T zigzag_decode(std::make_unsigned_t<T> value) {
+    using U = std::make_unsigned_t<T>;
+    return static_cast<T>(static_cast<U>(value >> 1) ^ static_cast<U>(0 - (value & 1)));
+}
+
+// Eight bytes as a little-endian word, whatever the machine's byte order
+[[nodiscard]] inline uint64_t load_le64(const uint8_t *src) {
+    uint64_t word;
+    std::memcpy(&word, src, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big) {
+        word = byteswap(word);
+    }
+    return word;
+}
+
+#if defined(BYTESTREAM_VARINT_BMI2)
+BYTESTREAM_TARGET("bmi2")
+inline uint64_t varint_spread_bmi2(uint64_t value) {
+    return _pdep_u64(value, ~varint_continuation_bits);
+}
+
+BYTESTREAM_TARGET("bmi2")
+inline uint64_t varint_gather_bmi2(uint64_t word, uint64_t mask) {
+    return _pext_u64(word, mask);
+}
+#endif
+
+// Writes one value, returning the byte after it. Values of up to 56 bits are spread into 7-bit
+// groups with pdep, or a few shifts and masks, rather than a loop, and written all at once.
+// Only kernels compiled for BMI2 pass Bmi2.
+template <bool Bmi2 = false>
+BYTESTREAM_KERNEL_INLINE uint8_t *varint_encode(uint8_t *dst, uint64_t value) {
+    const size_t length = varint_length(value);
+    if (length > 8) {
+        while (value >= 0x80) {
+            *dst++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *dst++ = static_cast<uint8_t>(value);
+        return dst;
+    }
+
+    uint64_t word;
+#if defined(BYTESTREAM_VARINT_BMI2)
+    if constexpr (Bmi2) {
+        word = varint_spread_bmi2(value);
+    } else
+#endif
+    {
+        word = (value & 0x000000000FFFFFFF) | ((value & 0x00FFFFFFF0000000) << 4);
+        word = (word & 0x00003FFF00003FFF) | ((word & 0x0FFFC0000FFFC000) << 2);
+        word = (word & 0x007F007F007F007F) | ((word & 0x3F803F803F803F80) << 1);
+    }
+    word |= varint_continuation_bits & ((uint64_t{1} << (8 * (length - 1))) - 1);
+    if constexpr (std::endian::native == std::endian::big) {
+        word = byteswap(word);
+    }
+    std::memcpy(dst, &word, length);
+    return dst + length;
+}
+
+// The value in the low length bytes of a little-endian word, its 7-bit groups gathered with
+// pext, or shifts and masks, rather than a loop
+template <bool Bmi2 = false>
+[[nodiscard]] BYTESTREAM_KERNEL_INLINE uint64_t varint_gather(uint64_t word, size_t length) {
+    const uint64_t bytes = ~uint64_t{0} >> (64 - 8 * length);
+#if defined(BYTESTREAM_VARINT_BMI2)
+    if constexpr (Bmi2) {
+        return varint_gather_bmi2(word, ~varint_continuation_bits & bytes);
+    }
+#endif
+    uint64_t groups = word & ~varint_continuation_bits & bytes;
+    groups = (groups & 0x007F007F007F007F) | ((groups & 0x7F007F007F007F00) >> 1);
+    groups = (groups & 0x00003FFF00003FFF) | ((groups & 0x3FFF00003FFF0000) >> 2);
+    return (groups & 0x000000000FFFFFFF) | ((groups & 0x0FFFFFFF00000000) >> 4);
+}
+
+// Reads one value from [src, end), returning the byte after it, or nullptr if the input ends
+// mid-value or the value doesn't fit in 64 bits. With eight bytes to hand, the value's end is
+// found from its continuation bits all at once.
+inline const uint8_t *varint_decode(const uint8_t *src, const uint8_t *end, uint64_t &value) {
+    if (end - src >= 8) {
+        const uint64_t word = load_le64(src);
+        const uint64_t stops = ~word & varint_continuation_bits;
+        if (stops) {
+            const size_t length = static_cast<size_t>(std::countr_zero(stops)) / 8 + 1;
+            value = varint_gather(word, length);
+            return src + length;
+        }
+    }
+
+    uint64_t result = 0;
+    for (size_t i = 0; i < 10 && src != end; ++i) {
+        const uint64_t group = *src & 0x7F;
+        if (i == 9 && group > 1) {
+            return nullptr;
+        }
+        result |= group << (7 * i);
+        if (!(*src++ & 0x80)) {
+            value = result;
+            return src;
+        }
+    }
+    return nullptr;
+}
+
+template <typename T, bool Zigzag>
+[[nodiscard]] std::make_unsigned_t<T> varint_word(T value) {
+    if constexpr (Zigzag) {
+        return zigzag_encode(value);
+    } else {
+        return static_cast<std::make_unsigned_t<T>>(value);
+    }
+}
+
+template <typename T, bool Zigzag>
+[[nodiscard]] T varint_value(std::make_unsigned_t<T> word) {
+    if constexpr (Zigzag) {
+        return zigzag_decode<T>(word);
+    } else {
+        return static_cast<T>(word);
+    }
+}
+
+// Bytes that count elements of T at src encode to
+template <typename T, bool Zigzag>
+size_t varints_size(const uint8_t *src, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        total += varint_length(varint_word<T, Zigzag>(value));
+    }
+    return total;
+}
+
+template <typename T, bool Zigzag, bool Bmi2>
+BYTESTREAM_KERNEL_INLINE uint8_t *encode_varints_with(uint8_t *dst, const uint8_t *src, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        dst = varint_encode<Bmi2>(dst, varint_word<T, Zigzag>(value));
+    }
+    return dst;
+}
+
+#if defined(BYTESTREAM_VARINT_BMI2)
+template <typename T, bool Zigzag>
+BYTESTREAM_TARGET("bmi2")
+uint8_t *encode_varints_bmi2(uint8_t *dst, const uint8_t *src, size_t count) {
+    return encode_varints_with<T, Zigzag, true>(dst, src, count);
+}
+#endif
+
+template <typename T, bool Zigzag>
+uint8_t *encode_varints(uint8_t *dst, const uint8_t *src, size_t count) {
+#if defined(BYTESTREAM_VARINT_BMI2)
+    if (cpu_has_bmi2()) {
+        return encode_varints_bmi2<T, Zigzag>(dst, src, count);
+    }
+#endif
+    return encode_varints_with<T, Zigzag, false>(dst, src, count);
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(__ARM_NEON) && defined(__aarch64__))
+// Widens 16 single-byte varints to elements of T at dst
+template <typename T, bool Zigzag>
+void widen_single_bytes(uint8_t *dst, const uint8_t *src) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = Zigzag ? _mm_set1_epi8(1) : zero;
+    const __m128i halves[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+    for (size_t h = 0; h < 2; ++h) {
+        const __m128i words[2] = {_mm_unpacklo_epi16(halves[h], zero), _mm_unpackhi_epi16(halves[h], zero)};
+        for (size_t w = 0; w < 2; ++w) {
+            if constexpr (sizeof(T) == 4) {
+                __m128i v = words[w];
+                if constexpr (Zigzag) {
+                    v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(zero, _mm_and_si128(v, one)));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (h * 8 + w * 4) * 4), v);
+            } else {
+                const __m128i longs[2] = {_mm_unpacklo_epi32(words[w], zero), _mm_unpackhi_epi32(words[w], zero)};
+                for (size_t l = 0; l < 2; ++l) {
+                    __m128i v = longs[l];
+                    if constexpr (Zigzag) {
+                        v = _mm_xor_si128(_mm_srli_epi64(v, 1), _mm_sub_epi64(zero, _mm_and_si128(v, one)));
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (h * 8 + w * 4 + l * 2) * 8), v);
+                }
+            }
+        }
+    }
+#else
+    const uint8x16_t bytes = vld1q_u8(src);
+    const uint16x8_t halves[2] = {vmovl_u8(vget_low_u8(bytes)), vmovl_u8(vget_high_u8(bytes))};
+    for (size_t h = 0; h < 2; ++h) {
+        const uint32x4_t words[2] = {vmovl_u16(vget_low_u16(halves[h])), vmovl_u16(vget_high_u16(halves[h]))};
+        for (size_t w = 0; w < 2; ++w) {
+            if constexpr (sizeof(T) == 4) {
+                uint32x4_t v = words[w];
+                if constexpr (Zigzag) {
+                    const int32x4_t sign = vnegq_s32(vreinterpretq_s32_u32(vandq_u32(v, vdupq_n_u32(1))));
+                    v = veorq_u32(vshrq_n_u32(v, 1), vreinterpretq_u32_s32(sign));
+                }
+                vst1q_u32(reinterpret_cast<uint32_t *>(dst + (h * 8 + w * 4) * 4), v);
+            } else {
+                const uint64x2_t longs[2] = {vmovl_u32(vget_low_u32(words[w])), vmovl_u32(vget_high_u32(words[w]))};
+                for (size_t l = 0; l < 2; ++l) {
+                    uint64x2_t v = longs[l];
+                    if constexpr (Zigzag) {
+                        const int64x2_t sign = vnegq_s64(vreinterpretq_s64_u64(vandq_u64(v, vdupq_n_u64(1))));
+                        v = veorq_u64(vshrq_n_u64(v, 1), vreinterpretq_u64_s64(sign));
+                    }
+                    vst1q_u64(reinterpret_cast<uint64_t *>(dst + (h * 8 + w * 4 + l * 2) * 8), v);
+                }
+            }
+        }
+    }
+#endif
+}
+
+// Whether all 16 bytes at src are whole varints of one byte each
+[[nodiscard]] inline bool single_bytes(const uint8_t *src) {
+#if defined(__SSE2__) || defined(_M_X64)
+    return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))) == 0;
+#else
+    return vmaxvq_u8(vld1q_u8(src)) < 0x80;
+#endif
+}
+#define BYTESTREAM_VARINT_SIMD 1
+#endif
+
+// Decodes count elements of T from [src, end) to dst, returning the byte after the last, or
+// nullptr if the input ends first or a value doesn't fit in T. Runs of 16 values under 128,
+// the common case for counters and small deltas, are widened 16 at a time. Where 16 bytes
+// turn out not to be such a run, they are decoded eight bytes at a time, every value ending
+// within the eight taken from the one load, before looking again.
+template <typename T, bool Zigzag, bool Bmi2>
+BYTESTREAM_KERNEL_INLINE const uint8_t *decode_varints_with(uint8_t *dst, const uint8_t *src, const uint8_t *end,
+                                                            size_t count) {
+    using U = std::make_unsigned_t<T>;
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Varints are 32 or 64 bits");
+#ifdef BYTESTREAM_VARINT_SIMD
+    const uint8_t *checked = src;
+#endif
+    for (size_t i = 0; i < count;) {
+#ifdef BYTESTREAM_VARINT_SIMD
+        if (src >= checked && count - i >= 16 && end - src >= 16) {
+            if (single_bytes(src)) {
+                widen_single_bytes<T, Zigzag>(dst + i * sizeof(T), src);
+                src += 16;
+                i += 16;
+                checked = src;
+                continue;
+            }
+            checked = src + 16;
+        }
+#endif
+        if (end - src >= 8) {
+            const uint64_t word = load_le64(src);
+            uint64_t stops = ~word & varint_continuation_bits;
+            if (stops) {
+                size_t start = 0;
+                bool overflow = false;
+                do {
+                    const size_t stop = static_cast<size_t>(std::countr_zero(stops)) / 8 + 1;
+                    const uint64_t value = varint_gather<Bmi2>(word >> (8 * start), stop - start);
+                    overflow |= value > std::numeric_limits<U>::max();
+                    const T element = varint_value<T, Zigzag>(static_cast<U>(value));
+                    std::memcpy(dst + i * sizeof(T), &element, sizeof(T));
+                    ++i;
+                    start = stop;
+                    stops &= stops - 1;
+                } while (stops && i < count);
+                if (overflow) {
+                    return nullptr;
+                }
+                src += start;
+                continue;
+            }
+        }
+
+        uint64_t word;
+        src = varint_decode(src, end, word);
+        if (!src || word > std::numeric_limits<U>::max()) {
+            return nullptr;
+        }
+        const T value = varint_value<T, Zigzag>(static_cast<U>(word));
+        std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+        ++i;
+    }
+    return src;
+}
+
+#if defined(BYTESTREAM_VARINT_BMI2)
+template <typename T, bool Zigzag>
+BYTESTREAM_TARGET("bmi2")
+const uint8_t *decode_varints_bmi2(uint8_t *dst, const uint8_t *src, const uint8_t *end, size_t count) {
+    return decode_varints_with<T, Zigzag, true>(dst, src, end, count);
+}
+#endif
+
+template <typename T, bool Zigzag>
+const uint8_t *decode_varints(uint8_t *dst, const uint8_t *src, const uint8_t *end, size_t count) {
+#if defined(BYTESTREAM_VARINT_BMI2)
+    if (cpu_has_bmi2()) {
+        return decode_varints_bmi2<T, Zigzag>(dst, src, end, count);
+    }
+#endif
+    return decode_varints_with<T, Zigzag, false>(dst, src, end, count);
+}
+
+// The bytes of [src, src + n) taken by up to count whole varints, and how many there are
+inline size_t whole_varints(const uint8_t *src, size_t n, size_t count, size_t &found) {
+    found = 0;
+    size_t length = 0;
+    for (size_t i = 0; i < n && found < count; ++i) {
+        if (!(src[i] & 0x80)) {
+            ++found;
+            length = i + 1;
+        }
+    }
+    return length;
+}
+
+using encoded_size_function = size_t (*)(const uint8_t *, size_t);
+using encode_function = uint8_t *(*)(uint8_t *, const uint8_t *, size_t);
+using decode_function = const uint8_t *(*)(uint8_t *, const uint8_t *, const uint8_t *, size_t);
+
+} // namespace bytestream::detail
+
+#endif //VARINT_HPP
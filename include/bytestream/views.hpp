@@ -0,0 +1,578 @@
+//
+// Lazy range adaptors for COBS and SLIP framing, for code that would rather compose views than
+// size buffers: bytes | views::cobs_decode | views::split_frames yields each frame in turn
+// without building any intermediate vector. Everything here is usable in constant expressions.
+//
+
+#ifndef BYTESTREAM_VIEWS_HPP
+#define BYTESTREAM_VIEWS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "SLIP.hpp"
+
+namespace bytestream::views {
+
+// What the decoding views yield: every byte of every frame, each frame followed by an end
+// marker. A frame the decoder finds to be corrupt, as the streaming decoders would drop it, is
+// followed by a dropped marker instead. A frame still open when the input runs out gets neither.
+struct frame_byte {
+    enum class tag : uint8_t { data, end, dropped };
+
+    tag kind;
+    uint8_t value;
+
+    [[nodiscard]] constexpr bool is_data() const { return kind == tag::data; }
+    constexpr bool operator==(const frame_byte &) const = default;
+};
+
+namespace detail {
+
+template <typename R>
+concept byte_range = std::ranges::input_range<R>
+                  && (std::is_integral_v<std::ranges::range_value_t<R>>
+                      || std::is_same_v<std::ranges::range_value_t<R>, std::byte>);
+
+template <typename It>
+constexpr uint8_t byte_at(const It &it) {
+    return static_cast<uint8_t>(*it);
+}
+
+template <bool Const, typename V>
+using maybe_const = std::conditional_t<Const, const V, V>;
+
+// Makes View usable as `range | adaptor` as well as `adaptor(range)`.
+template <template <typename> typename View>
+struct adaptor {
+    template <std::ranges::viewable_range R>
+    constexpr auto operator()(R &&range) const {
+        return View<std::views::all_t<R>>(std::views::all(std::forward<R>(range)));
+    }
+
+    template <std::ranges::viewable_range R>
+    friend constexpr auto operator|(R &&range, const adaptor &self) {
+        return self(std::forward<R>(range));
+    }
+};
+
+} // namespace detail
+
+// Encodes the whole of V as one COBS frame, delimiter included. Each block's code byte comes
+// before its data, so the view looks up to 254 bytes ahead and V has to be a forward range.
+template <std::ranges::view V>
+    requires std::ranges::forward_range<V> && detail::byte_range<V>
+class cobs_encode_view : public std::ranges::view_interface<cobs_encode_view<V>> {
+    V base_;
+
+    template <bool Const>
+    class iterator {
+        using Base = detail::maybe_const<Const, V>;
+        using base_iterator = std::ranges::iterator_t<Base>;
+        using base_sentinel = std::ranges::sentinel_t<Base>;
+
+        enum class phase : uint8_t { code, data, delimiter, done };
+
+        base_iterator current{};
+        base_iterator block_end{};
+        base_sentinel last{};
+        uint8_t code{0};
+        bool ended_by_zero{false};
+        phase state{phase::done};
+
+        // A block always follows a zero, even at the end of the input; otherwise only data starts one
+        constexpr void start_block(bool after_zero) {
+            if (current == last && !after_zero) {
+                state = phase::delimiter;
+                return;
+            }
+            block_end = current;
+            uint8_t length = 0;
+            while (block_end != last && length < 0xFE && detail::byte_at(block_end)) {
+                ++block_end;
+                ++length;
+            }
+            code = static_cast<uint8_t>(length + 1);
+            ended_by_zero = length < 0xFE && block_end != last;
+            state = phase::code;
+        }
+
+        constexpr void end_block() {
+            current = block_end;
+            if (ended_by_zero) {
+                ++current;
+            }
+            start_block(ended_by_zero);
+        }
+
+    public:
+        using value_type = uint8_t;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        constexpr iterator(base_iterator first, base_sentinel last) : current(std::move(first)), last(last) {
+            start_block(true);
+        }
+
+        constexpr uint8_t operator*() const {
+            switch (state) {
+                case phase::code:
+                    return code;
+                case phase::data:
+                    return detail::byte_at(current);
+                default:
+                    return 0;
+            }
+        }
+
+        constexpr iterator &operator++() {
+            switch (state) {
+                case phase::code:
+                    if (current == block_end) {
+                        end_block();
+                    } else {
+                        state = phase::data;
+                    }
+                    break;
+                case phase::data:
+                    if (++current == block_end) {
+                        end_block();
+                    }
+                    break;
+                case phase::delimiter:
+                    state = phase::done;
+                    break;
+                case phase::done:
+                    break;
+            }
+            return *this;
+        }
+
+        constexpr iterator operator++(int) {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        constexpr bool operator==(const iterator &other) const {
+            return state == other.state && (state == phase::done || current == other.current);
+        }
+
+        constexpr bool operator==(std::default_sentinel_t) const {
+            return state == phase::done;
+        }
+    };
+
+public:
+    cobs_encode_view() requires std::default_initializable<V> = default;
+    constexpr explicit cobs_encode_view(V base) : base_(std::move(base)) {}
+
+    constexpr auto begin() { return iterator<false>(std::ranges::begin(base_), std::ranges::end(base_)); }
+    constexpr auto begin() const requires std::ranges::forward_range<const V> {
+        return iterator<true>(std::ranges::begin(base_), std::ranges::end(base_));
+    }
+    constexpr std::default_sentinel_t end() const { return {}; }
+};
+
+// Decodes a stream of COBS frames. As with COBSDecoder, a zero always ends a frame, and one
+// that arrives inside a block marks the frame as dropped.
+template <std::ranges::view V>
+    requires detail::byte_range<V>
+class cobs_decode_view : public std::ranges::view_interface<cobs_decode_view<V>> {
+    V base_;
+
+    template <bool Const>
+    class iterator {
+        using Base = detail::maybe_const<Const, V>;
+        using base_iterator = std::ranges::iterator_t<Base>;
+        using base_sentinel = std::ranges::sentinel_t<Base>;
+
+        base_iterator current{};
+        base_sentinel last{};
+        frame_byte element{};
+        uint8_t block_remaining{0};
+        uint8_t code{0xFF};
+        bool done{true};
+
+        constexpr void reset(frame_byte::tag marker) {
+            element = {marker, 0};
+            block_remaining = 0;
+            code = 0xFF;
+        }
+
+        // Elements are only ever produced on consuming a byte, so the position identifies them
+        constexpr void advance() {
+            for (;;) {
+                if (current == last) {
+                    done = true;
+                    return;
+                }
+                const uint8_t byte = detail::byte_at(current);
+                ++current;
+
+                if (block_remaining) {
+                    if (!byte) {
+                        reset(frame_byte::tag::dropped);
+                    } else {
+                        --block_remaining;
+                        element = {frame_byte::tag::data, byte};
+                    }
+                    return;
+                }
+                if (!byte) {
+                    reset(frame_byte::tag::end);
+                    return;
+                }
+                const uint8_t previous = code;
+                code = byte;
+                block_remaining = static_cast<uint8_t>(byte - 1);
+                if (previous != 0xFF) {
+                    element = {frame_byte::tag::data, 0};
+                    return;
+                }
+            }
+        }
+
+    public:
+        using value_type = frame_byte;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::conditional_t<std::ranges::forward_range<Base>,
+                                                    std::forward_iterator_tag, std::input_iterator_tag>;
+
+        iterator() = default;
+
+        constexpr iterator(base_iterator first, base_sentinel last)
+            : current(std::move(first)), last(last), done(false) {
+            advance();
+        }
+
+        constexpr frame_byte operator*() const { return element; }
+
+        constexpr iterator &operator++() {
+            advance();
+            return *this;
+        }
+
+        constexpr void operator++(int) requires (!std::ranges::forward_range<Base>) { advance(); }
+
+        constexpr iterator operator++(int) requires std::ranges::forward_range<Base> {
+            auto previous = *this;
+            advance();
+            return previous;
+        }
+
+        constexpr bool operator==(const iterator &other) const requires std::ranges::forward_range<Base> {
+            return done == other.done && (done || current == other.current);
+        }
+
+        constexpr bool operator==(std::default_sentinel_t) const { return done; }
+    };
+
+public:
+    cobs_decode_view() requires std::default_initializable<V> = default;
+    constexpr explicit cobs_decode_view(V base) : base_(std::move(base)) {}
+
+    constexpr auto begin() { return iterator<false>(std::ranges::begin(base_), std::ranges::end(base_)); }
+    constexpr auto begin() const requires std::ranges::input_range<const V> {
+        return iterator<true>(std::ranges::begin(base_), std::ranges::end(base_));
+    }
+    constexpr std::default_sentinel_t end() const { return {}; }
+};
+
+// Encodes the whole of V as one SLIP frame, terminating SLIP_END included.
+template <std::ranges::view V>
+    requires detail::byte_range<V>
+class slip_encode_view : public std::ranges::view_interface<slip_encode_view<V>> {
+    V base_;
+
+    template <bool Const>
+    class iterator {
+        using Base = detail::maybe_const<Const, V>;
+        using base_iterator = std::ranges::iterator_t<Base>;
+        using base_sentinel = std::ranges::sentinel_t<Base>;
+
+        enum class phase : uint8_t { byte, escape_code, end, done };
+
+        base_iterator current{};
+        base_sentinel last{};
+        phase state{phase::done};
+
+        constexpr void settle() {
+            state = current == last ? phase::end : phase::byte;
+        }
+
+    public:
+        using value_type = uint8_t;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::conditional_t<std::ranges::forward_range<Base>,
+                                                    std::forward_iterator_tag, std::input_iterator_tag>;
+
+        iterator() = default;
+
+        constexpr iterator(base_iterator first, base_sentinel last) : current(std::move(first)), last(last) {
+            settle();
+        }
+
+        constexpr uint8_t operator*() const {
+            switch (state) {
+                case phase::byte: {
+                    const uint8_t byte = detail::byte_at(current);
+                    return byte == SLIP_END || byte == SLIP_ESC ? SLIP_ESC : byte;
+                }
+                case phase::escape_code:
+                    return detail::byte_at(current) == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+                default:
+                    return SLIP_END;
+            }
+        }
+
+        constexpr iterator &operator++() {
+            switch (state) {
+                case phase::byte: {
+                    const uint8_t byte = detail::byte_at(current);
+                    if (byte == SLIP_END || byte == SLIP_ESC) {
+                        state = phase::escape_code;
+                        break;
+                    }
+                    ++current;
+                    settle();
+                    break;
+                }
+                case phase::escape_code:
+                    ++current;
+                    settle();
+                    break;
+                case phase::end:
+                    state = phase::done;
+                    break;
+                case phase::done:
+                    break;
+            }
+            return *this;
+        }
+
+        constexpr void operator++(int) requires (!std::ranges::forward_range<Base>) { ++*this; }
+
+        constexpr iterator operator++(int) requires std::ranges::forward_range<Base> {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        constexpr bool operator==(const iterator &other) const requires std::ranges::forward_range<Base> {
+            return state == other.state && (state == phase::done || current == other.current);
+        }
+
+        constexpr bool operator==(std::default_sentinel_t) const { return state == phase::done; }
+    };
+
+public:
+    slip_encode_view() requires std::default_initializable<V> = default;
+    constexpr explicit slip_encode_view(V base) : base_(std::move(base)) {}
+
+    constexpr auto begin() { return iterator<false>(std::ranges::begin(base_), std::ranges::end(base_)); }
+    constexpr auto begin() const requires std::ranges::input_range<const V> {
+        return iterator<true>(std::ranges::begin(base_), std::ranges::end(base_));
+    }
+    constexpr std::default_sentinel_t end() const { return {}; }
+};
+
+// Decodes a stream of SLIP frames. As with SLIPDecoder, an escape followed by anything but
+// SLIP_ESC_END/SLIP_ESC_ESC marks its frame as dropped when the frame ends.
+template <std::ranges::view V>
+    requires detail::byte_range<V>
+class slip_decode_view : public std::ranges::view_interface<slip_decode_view<V>> {
+    V base_;
+
+    template <bool Const>
+    class iterator {
+        using Base = detail::maybe_const<Const, V>;
+        using base_iterator = std::ranges::iterator_t<Base>;
+        using base_sentinel = std::ranges::sentinel_t<Base>;
+
+        base_iterator current{};
+        base_sentinel last{};
+        frame_byte element{};
+        bool escaped{false};
+        bool corrupt{false};
+        bool done{true};
+
+        // Elements are only ever produced on consuming a byte, so the position identifies them
+        constexpr void advance() {
+            for (;;) {
+                if (current == last) {
+                    done = true;
+                    return;
+                }
+                const uint8_t byte = detail::byte_at(current);
+
+                if (escaped) {
+                    escaped = false;
+                    if (byte == SLIP_ESC_END || byte == SLIP_ESC_ESC) {
+                        ++current;
+                        element = {frame_byte::tag::data, byte == SLIP_ESC_END ? SLIP_END : SLIP_ESC};
+                        return;
+                    }
+                    // Leave the byte to be read again, so a SLIP_END still ends the frame
+                    corrupt = true;
+                    continue;
+                }
+
+                ++current;
+                if (byte == SLIP_ESC) {
+                    escaped = true;
+                    continue;
+                }
+                if (byte == SLIP_END) {
+                    element = {corrupt ? frame_byte::tag::dropped : frame_byte::tag::end, 0};
+                    corrupt = false;
+                    return;
+                }
+                element = {frame_byte::tag::data, byte};
+                return;
+            }
+        }
+
+    public:
+        using value_type = frame_byte;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::conditional_t<std::ranges::forward_range<Base>,
+                                                    std::forward_iterator_tag, std::input_iterator_tag>;
+
+        iterator() = default;
+
+        constexpr iterator(base_iterator first, base_sentinel last)
+            : current(std::move(first)), last(last), done(false) {
+            advance();
+        }
+
+        constexpr frame_byte operator*() const { return element; }
+
+        constexpr iterator &operator++() {
+            advance();
+            return *this;
+        }
+
+        constexpr void operator++(int) requires (!std::ranges::forward_range<Base>) { advance(); }
+
+        constexpr iterator operator++(int) requires std::ranges::forward_range<Base> {
+            auto previous = *this;
+            advance();
+            return previous;
+        }
+
+        constexpr bool operator==(const iterator &other) const requires std::ranges::forward_range<Base> {
+            return done == other.done && (done || current == other.current);
+        }
+
+        constexpr bool operator==(std::default_sentinel_t) const { return done; }
+    };
+
+public:
+    slip_decode_view() requires std::default_initializable<V> = default;
+    constexpr explicit slip_decode_view(V base) : base_(std::move(base)) {}
+
+    constexpr auto begin() { return iterator<false>(std::ranges::begin(base_), std::ranges::end(base_)); }
+    constexpr auto begin() const requires std::ranges::input_range<const V> {
+        return iterator<true>(std::ranges::begin(base_), std::ranges::end(base_));
+    }
+    constexpr std::default_sentinel_t end() const { return {}; }
+};
+
+// Groups the output of cobs_decode or slip_decode into frames, each a view of its bytes.
+// Dropped frames are skipped, as is a frame still open at the end of the input.
+template <std::ranges::view V>
+    requires std::ranges::forward_range<V> && std::same_as<std::ranges::range_value_t<V>, frame_byte>
+class split_frames_view : public std::ranges::view_interface<split_frames_view<V>> {
+    V base_;
+
+    struct byte_value {
+        constexpr uint8_t operator()(const frame_byte &element) const { return element.value; }
+    };
+
+    template <bool Const>
+    class iterator {
+        using Base = detail::maybe_const<Const, V>;
+        using base_iterator = std::ranges::iterator_t<Base>;
+        using base_sentinel = std::ranges::sentinel_t<Base>;
+
+        base_iterator frame_begin{};
+        base_iterator frame_end{};
+        base_sentinel last{};
+        bool done{true};
+
+        constexpr void find_frame() {
+            for (;;) {
+                frame_end = std::ranges::find_if_not(frame_begin, last, &frame_byte::is_data);
+                if (frame_end == last) {
+                    done = true;
+                    return;
+                }
+                if ((*frame_end).kind == frame_byte::tag::end) {
+                    return;
+                }
+                frame_begin = std::ranges::next(frame_end);
+            }
+        }
+
+    public:
+        using value_type = std::ranges::transform_view<std::ranges::subrange<base_iterator>, byte_value>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        constexpr iterator(base_iterator first, base_sentinel last)
+            : frame_begin(std::move(first)), last(last), done(false) {
+            find_frame();
+        }
+
+        constexpr value_type operator*() const {
+            return value_type(std::ranges::subrange(frame_begin, frame_end), byte_value{});
+        }
+
+        constexpr iterator &operator++() {
+            frame_begin = std::ranges::next(frame_end);
+            find_frame();
+            return *this;
+        }
+
+        constexpr iterator operator++(int) {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        constexpr bool operator==(const iterator &other) const {
+            return done == other.done && (done || frame_begin == other.frame_begin);
+        }
+
+        constexpr bool operator==(std::default_sentinel_t) const { return done; }
+    };
+
+public:
+    split_frames_view() requires std::default_initializable<V> = default;
+    constexpr explicit split_frames_view(V base) : base_(std::move(base)) {}
+
+    constexpr auto begin() { return iterator<false>(std::ranges::begin(base_), std::ranges::end(base_)); }
+    constexpr auto begin() const requires std::ranges::forward_range<const V> {
+        return iterator<true>(std::ranges::begin(base_), std::ranges::end(base_));
+    }
+    constexpr std::default_sentinel_t end() const { return {}; }
+};
+
+inline constexpr detail::adaptor<cobs_encode_view> cobs_encode{};
+inline constexpr detail::adaptor<cobs_decode_view> cobs_decode{};
+inline constexpr detail::adaptor<slip_encode_view> slip_encode{};
+inline constexpr detail::adaptor<slip_decode_view> slip_decode{};
+inline constexpr detail::adaptor<split_frames_view> split_frames{};
+
+} // namespace bytestream::views
+
+#endif //BYTESTREAM_VIEWS_HPP
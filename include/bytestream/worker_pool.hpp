@@ -0,0 +1,122 @@
+//
+// Fixed set of threads for splitting one large job into independent pieces.
+//
+
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// run() hands out the pieces of a job to the workers and to the calling thread, and returns once
+// all of them are done and every worker has seen the job. Jobs are not queued: one run() at a
+// time per pool.
+class worker_pool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    // The current job, only changed under the mutex once every worker has picked up the last
+    // one and finished with it. A worker that hadn't woken for the last job yet would otherwise
+    // take the new job's pieces with the old job's function.
+    void (*invoke)(void *, size_t){nullptr};
+    void *job{nullptr};
+    size_t job_size{0};
+    std::atomic<size_t> next{0};
+    size_t generation{0};
+    // Workers that have picked up the current job, and of them those still working on it
+    size_t started{0};
+    size_t busy{0};
+    bool stopping{false};
+
+    void drain(void (*fn)(void *, size_t), void *context, size_t count) {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            fn(context, i);
+        }
+    }
+
+    void work() {
+        size_t seen = 0;
+        std::unique_lock lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            ++started;
+            ++busy;
+            const auto fn = invoke;
+            void *const context = job;
+            const size_t count = job_size;
+            lock.unlock();
+            drain(fn, context, count);
+            lock.lock();
+            if (!--busy) {
+                idle.notify_all();
+            }
+        }
+    }
+
+public:
+    // threads counts the calling thread, so a pool of 1 runs everything inline
+    explicit worker_pool(size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t i = 1; i < threads; ++i) {
+            workers.emplace_back(&worker_pool::work, this);
+        }
+    }
+
+    worker_pool(const worker_pool &) = delete;
+    worker_pool &operator=(const worker_pool &) = delete;
+
+    ~worker_pool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return workers.size() + 1; }
+
+    // Calls fn(i) for every i in [0, count), spread across the pool.
+    template <typename F>
+    void run(size_t count, F &&fn) {
+        const auto call = [](void *context, size_t i) { (*static_cast<std::remove_reference_t<F> *>(context))(i); };
+        if (workers.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            invoke = call;
+            job = const_cast<void *>(static_cast<const void *>(std::addressof(fn)));
+            job_size = count;
+            next.store(0, std::memory_order_relaxed);
+            started = 0;
+            ++generation;
+        }
+        wake.notify_all();
+        drain(call, job, count);
+
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [&] { return started == workers.size() && busy == 0; });
+    }
+};
+
+#endif //WORKER_POOL_HPP
@@ -1,10 +1,482 @@
 //
 // Created by Obi Davis on 16/05/2024.
 //
+// 8-bit data packed into the 7-bit bytes MIDI SysEx can carry, and SysEx framing around it.
+// Every group of up to seven bytes becomes a header byte holding their high bits, bit i for
+// byte i, followed by the seven bytes with their high bits cleared: 8 bytes out for every 7 in.
+// A frame is SYSEX_START, the manufacturer ID, the packed payload and SYSEX_END.
+//
 
 #ifndef MIDIBITPACK_HPP
 #define MIDIBITPACK_HPP
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+
+#include "bytestream/byte_scan.hpp"
+#include "bytestream/byte_swap.hpp"
+#include "bytestream/cpu_features.hpp"
+#include "bytestream/frame_buffer.hpp"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static constexpr uint8_t SYSEX_START = 0xF0;
+static constexpr uint8_t SYSEX_END = 0xF7;
+// The manufacturer ID set aside for non-commercial use, which is what tunnelling our own data is
+static constexpr uint8_t SYSEX_NON_COMMERCIAL_ID = 0x7D;
+
+namespace bytestream::detail {
+
+// Eight bytes in little-endian order, whatever the machine's
+[[nodiscard]] inline uint64_t load_le_word(const uint8_t *src) {
+    uint64_t word;
+    std::memcpy(&word, src, 8);
+    if constexpr (std::endian::native == std::endian::big) {
+        word = byteswap(word);
+    }
+    return word;
+}
+
+inline void store_le_word(uint8_t *dst, uint64_t word) {
+    if constexpr (std::endian::native == std::endian::big) {
+        word = byteswap(word);
+    }
+    std::memcpy(dst, &word, 8);
+}
+
+// Packs the seven bytes at the bottom of word into eight. The multiply moves the high bit of
+// byte i to bit 56 + i without any two partial products meeting, so nothing carries.
+[[nodiscard]] constexpr uint64_t midi_pack_word(uint64_t word) {
+    const uint64_t high_bits = ((word >> 7) & 0x0001010101010101) * 0x0102040810204080 >> 56;
+    return (word & 0x007F7F7F7F7F7F7F) << 8 | high_bits;
+}
+
+// The reverse: spreads bit i of the header byte back to bit 7 of byte i, by the same trick
+[[nodiscard]] constexpr uint64_t midi_unpack_word(uint64_t word) {
+    const uint64_t high_bits = ((word & 0x7F) * 0x0002040810204080) & 0x0080808080808080;
+    return word >> 8 | high_bits;
+}
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+// Packs two groups at a time while sixteen bytes can be read, and returns the bytes packed,
+// a multiple of 14. Lanes 0 and 8 are left zero for the header bytes, which are the sums of
+// the weights of the lanes with their high bit set.
+BYTESTREAM_TARGET("ssse3")
+inline size_t midi_pack_ssse3(const uint8_t *in, size_t size, uint8_t *out) {
+    const __m128i spread = _mm_setr_epi8(-1, 0, 1, 2, 3, 4, 5, 6, -1, 7, 8, 9, 10, 11, 12, 13);
+    const __m128i weights = _mm_setr_epi8(0, 1, 2, 4, 8, 16, 32, 64, 0, 1, 2, 4, 8, 16, 32, 64);
+    const __m128i low_bits = _mm_set1_epi8(0x7F);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 14, out += 16) {
+        const __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)), spread);
+        const __m128i high = _mm_and_si128(_mm_cmplt_epi8(bytes, zero), weights);
+        const __m128i headers = _mm_sad_epu8(high, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_or_si128(_mm_and_si128(bytes, low_bits), headers));
+    }
+    return i;
+}
+
+// Unpacks two groups at a time, stopping while three more bytes are still to come, and
+// returns the bytes unpacked, a multiple of 16, or std::nullopt on a byte with its high bit set
+BYTESTREAM_TARGET("ssse3")
+inline std::optional<size_t> midi_unpack_ssse3(const uint8_t *in, size_t size, uint8_t *out) {
+    const __m128i broadcast = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8);
+    const __m128i weights = _mm_setr_epi8(0, 1, 2, 4, 8, 16, 32, 64, 0, 1, 2, 4, 8, 16, 32, 64);
+    const __m128i compact = _mm_setr_epi8(1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15, -1, -1);
+    const __m128i high_bit = _mm_set1_epi8(static_cast<char>(0x80));
+    size_t i = 0;
+    for (; size - i >= 16 + 3; i += 16, out += 14) {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        if (_mm_movemask_epi8(packed)) {
+            return std::nullopt;
+        }
+        const __m128i headers = _mm_and_si128(_mm_shuffle_epi8(packed, broadcast), weights);
+        const __m128i high = _mm_and_si128(_mm_cmpeq_epi8(headers, weights), high_bit);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(_mm_or_si128(packed, high), compact));
+    }
+    return i;
+}
+#endif
+
+} // namespace bytestream::detail
+
+[[nodiscard]] constexpr size_t midi_packed_length(size_t length) {
+    return length + (length + 6) / 7;
+}
+
+// Bytes unpacked from length packed ones. A lone header byte at the end stands for nothing.
+[[nodiscard]] constexpr size_t midi_unpacked_length(size_t length) {
+    return length / 8 * 7 + (length % 8 ? length % 8 - 1 : 0);
+}
+
+[[nodiscard]] constexpr size_t midi_sysex_encoded_length(size_t length) {
+    return midi_packed_length(length) + 3;
+}
+
+// Packs input into output, which needs room for midi_packed_length(input.size()) bytes, and
+// returns the packed size. Two groups at a time with pshufb or NEON table lookups, then a word
+// at a time while eight bytes can be read, then byte by byte for the last group.
+inline size_t midi_pack(std::span<const uint8_t> input, uint8_t *output) {
+    const uint8_t *in = input.data();
+    const size_t size = input.size();
+    uint8_t *out = output;
+    size_t i = 0;
+
+#if defined(BYTESTREAM_X86_DISPATCH)
+    if (size >= 16 && bytestream::detail::cpu_has_ssse3()) {
+        i = bytestream::detail::midi_pack_ssse3(in, size, out);
+        out += i / 7 * 8;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // Out of range indices give zero, leaving room for the header bytes
+    constexpr uint8_t spread_lanes[16] = {0xFF, 0, 1, 2, 3, 4, 5, 6, 0xFF, 7, 8, 9, 10, 11, 12, 13};
+    constexpr uint8_t weight_lanes[16] = {0, 1, 2, 4, 8, 16, 32, 64, 0, 1, 2, 4, 8, 16, 32, 64};
+    const uint8x16_t spread = vld1q_u8(spread_lanes);
+    const uint8x16_t weights = vld1q_u8(weight_lanes);
+    for (; i + 16 <= size; i += 14, out += 16) {
+        const uint8x16_t bytes = vqtbl1q_u8(vld1q_u8(in + i), spread);
+        const uint8x16_t high = vandq_u8(vtstq_u8(bytes, vdupq_n_u8(0x80)), weights);
+        const uint64x2_t headers = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(high)));
+        vst1q_u8(out, vorrq_u8(vandq_u8(bytes, vdupq_n_u8(0x7F)), vreinterpretq_u8_u64(headers)));
+    }
+#endif
+    for (; i + 8 <= size; i += 7, out += 8) {
+        bytestream::detail::store_le_word(out, bytestream::detail::midi_pack_word(bytestream::detail::load_le_word(in + i)));
+    }
+    for (; i < size; i += 7) {
+        const size_t n = std::min<size_t>(7, size - i);
+        uint8_t *header = out++;
+        *header = 0;
+        for (size_t j = 0; j < n; ++j) {
+            *header |= static_cast<uint8_t>((in[i + j] >> 7) << j);
+            *out++ = in[i + j] & 0x7F;
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+// Unpacks input into output, which needs room for midi_unpacked_length(input.size()) bytes,
+// and returns the unpacked size. Returns std::nullopt if a byte has its high bit set, which no
+// packed byte can, or input ends on a lone header byte. output may alias input.data() to unpack
+// in place, since the unpacked bytes never overtake the packed ones.
+[[nodiscard]] inline std::optional<size_t> midi_unpack(std::span<const uint8_t> input, uint8_t *output) {
+    const uint8_t *in = input.data();
+    const size_t size = input.size();
+    uint8_t *out = output;
+    size_t i = 0;
+
+    if (size % 8 == 1) {
+        return std::nullopt;
+    }
+
+    // The vector and word loops store two and one bytes past what they unpack, so they stop
+    // while at least that much more is still to come
+#if defined(BYTESTREAM_X86_DISPATCH)
+    if (size >= 16 + 3 && bytestream::detail::cpu_has_ssse3()) {
+        const std::optional<size_t> unpacked = bytestream::detail::midi_unpack_ssse3(in, size, out);
+        if (!unpacked) {
+            return std::nullopt;
+        }
+        i = *unpacked;
+        out += i / 8 * 7;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    constexpr uint8_t broadcast_lanes[16] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 8, 8, 8, 8, 8, 8, 8};
+    constexpr uint8_t weight_lanes[16] = {0, 1, 2, 4, 8, 16, 32, 64, 0, 1, 2, 4, 8, 16, 32, 64};
+    constexpr uint8_t compact_lanes[16] = {1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15, 0xFF, 0xFF};
+    const uint8x16_t broadcast = vld1q_u8(broadcast_lanes);
+    const uint8x16_t weights = vld1q_u8(weight_lanes);
+    const uint8x16_t compact = vld1q_u8(compact_lanes);
+    for (; size - i >= 16 + 3; i += 16, out += 14) {
+        const uint8x16_t packed = vld1q_u8(in + i);
+        if (vmaxvq_u8(packed) & 0x80) {
+            return std::nullopt;
+        }
+        const uint8x16_t high = vandq_u8(vtstq_u8(vqtbl1q_u8(packed, broadcast), weights), vdupq_n_u8(0x80));
+        vst1q_u8(out, vqtbl1q_u8(vorrq_u8(packed, high), compact));
+    }
+#endif
+    for (; size - i >= 8 + 2; i += 8, out += 7) {
+        const uint64_t word = bytestream::detail::load_le_word(in + i);
+        if (word & 0x8080808080808080) {
+            return std::nullopt;
+        }
+        bytestream::detail::store_le_word(out, bytestream::detail::midi_unpack_word(word));
+    }
+    for (; i < size; i += 8) {
+        const size_t n = std::min<size_t>(8, size - i);
+        const uint8_t header = in[i];
+        uint8_t high_bits = header;
+        for (size_t j = 1; j < n; ++j) {
+            high_bits |= in[i + j];
+            *out++ = static_cast<uint8_t>(in[i + j] | ((header >> (j - 1)) & 1) << 7);
+        }
+        if (high_bits & 0x80) {
+            return std::nullopt;
+        }
+    }
+    return static_cast<size_t>(out - output);
+}
+
+// Fast path for contiguous input, fed incrementally: push() the payload in as many pieces as is
+// convenient, then finish() the frame. Pieces need not be whole groups; up to six bytes are
+// held back until the rest of their group arrives. output needs room for
+// midi_sysex_encoded_length() of the total pushed.
+class MIDISysExEncoder {
+    uint8_t *output;
+    uint8_t *out;
+    uint8_t group[7]{};
+    size_t group_length{0};
+public:
+    explicit MIDISysExEncoder(uint8_t *output) : output(output), out(output) {
+        *out++ = SYSEX_START;
+        *out++ = SYSEX_NON_COMMERCIAL_ID;
+    }
+
+    void push(std::span<const uint8_t> input) {
+        if (group_length) {
+            const size_t n = std::min(input.size(), 7 - group_length);
+            std::memcpy(group + group_length, input.data(), n);
+            group_length += n;
+            input = input.subspan(n);
+            if (group_length < 7) {
+                return;
+            }
+            out += midi_pack(group, out);
+            group_length = 0;
+        }
+        const size_t whole = input.size() / 7 * 7;
+        out += midi_pack(input.first(whole), out);
+        group_length = input.size() - whole;
+        if (group_length) {
+            std::memcpy(group, input.data() + whole, group_length);
+        }
+    }
+
+    // Packs what is left of the last group and appends SYSEX_END. Returns the encoded size.
+    size_t finish() {
+        out += midi_pack(std::span<const uint8_t>(group, group_length), out);
+        group_length = 0;
+        *out++ = SYSEX_END;
+        return static_cast<size_t>(out - output);
+    }
+};
+
+// One-shot form of MIDISysExEncoder. output needs room for midi_sysex_encoded_length(input.size())
+// bytes.
+inline size_t midi_sysex_encode_frame(std::span<const uint8_t> input, uint8_t *output) {
+    MIDISysExEncoder encoder(output);
+    encoder.push(input);
+    return encoder.finish();
+}
+
+// Streaming decoder with the same interface as COBSDecoder. SysEx messages for other
+// manufacturers are skipped without counting as dropped. System real-time bytes may be
+// interleaved anywhere in a frame, as MIDI allows, and are ignored; any other status byte ends
+// the frame early, so it is dropped, as is a frame that ends mid-group or outgrows the maximum
+// length.
+class MIDISysExDecoder {
+    enum class State : uint8_t { Idle, Id, Data, Skip };
+
+    State state{State::Idle};
+    uint8_t group[8]{};
+    uint8_t group_length{0};
+    bool packet_complete_flag{false};
+    frame_buffer frame;
+
+    [[nodiscard]] static constexpr bool is_realtime(uint8_t byte) {
+        return byte >= 0xF8;
+    }
+
+    // Unpacks the held group into the frame. Returns false if that would outgrow the frame.
+    template <typename Checksum>
+    bool flush_group(Checksum &checksum) {
+        const size_t n = midi_unpacked_length(group_length);
+        if (!n) {
+            return true;
+        }
+        uint8_t *tail = frame.extend(n);
+        if (!tail) {
+            return false;
+        }
+        for (size_t j = 0; j < n; ++j) {
+            tail[j] = static_cast<uint8_t>(group[j + 1] | ((group[0] >> j) & 1) << 7);
+        }
+        checksum.update(tail, n);
+        group_length = 0;
+        return true;
+    }
+
+    // A status byte in the middle of a frame: SYSEX_END completes it, real-time bytes are
+    // skipped, and anything else cuts it short. Returns the number of frames dropped.
+    template <typename Sink, typename Checksum>
+    size_t process_status(uint8_t byte, Sink &sink, Checksum &checksum) {
+        if (is_realtime(byte)) {
+            return 0;
+        }
+        const bool in_frame = state == State::Data;
+        bool dropped = in_frame;
+        if (in_frame && byte == SYSEX_END && group_length != 1 && flush_group(checksum)) {
+            dropped = !deliver_frame(frame.view(), sink, checksum);
+        }
+        if (dropped) {
+            checksum.reset();
+        }
+        reset();
+        if (byte == SYSEX_START) {
+            state = State::Id;
+        }
+        return dropped;
+    }
+
+public:
+    // Caps the decoded frame length, checksum trailer included, and allocates room for a frame
+    // that long up front. Longer frames are dropped.
+    void set_max_frame_length(size_t length) {
+        reset();
+        frame.set_max_size(length);
+    }
+
+    [[nodiscard]] constexpr size_t get_max_frame_length() const {
+        return frame.max_size();
+    }
+
+    // Decodes a chunk of the incoming stream, calling sink(std::span<const uint8_t>) once for
+    // every frame completed within it. The span is only valid for the duration of the call. A
+    // partial frame at the end of the chunk is carried over to the next call. Runs of whole
+    // groups are unpacked straight into the frame with midi_unpack(). If a checksum is given it
+    // is updated as the frame is unpacked, and frames that fail it are dropped; pass the same
+    // checksum object on every call. Returns the number of frames dropped. Don't mix with
+    // process_byte() on the same decoder.
+    template <typename Sink, typename Checksum = no_checksum>
+    size_t process(std::span<const uint8_t> input, Sink &&sink, Checksum &&checksum = {}) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        size_t dropped = 0;
+        const uint8_t *first = input.data();
+        const uint8_t *const last = first + input.size();
+        while (first != last) {
+            if (*first & 0x80) {
+                dropped += process_status(*first++, sink, checksum);
+                continue;
+            }
+            switch (state) {
+                case State::Idle:
+                case State::Skip:
+                    ++first;
+                    continue;
+                case State::Id:
+                    state = *first++ == SYSEX_NON_COMMERCIAL_ID ? State::Data : State::Skip;
+                    continue;
+                case State::Data:
+                    break;
+            }
+
+            const uint8_t *run_end = bytestream::detail::find_high_bit(first, last);
+            if (group_length) {
+                const size_t n = std::min<size_t>(8 - group_length, run_end - first);
+                std::memcpy(group + group_length, first, n);
+                group_length += n;
+                first += n;
+                if (group_length < 8) {
+                    continue;
+                }
+                if (!flush_group(checksum)) {
+                    ++dropped;
+                    checksum.reset();
+                    reset();
+                    state = State::Skip;
+                    continue;
+                }
+            }
+
+            const size_t whole = static_cast<size_t>(run_end - first) / 8 * 8;
+            if (whole) {
+                uint8_t *tail = frame.extend(midi_unpacked_length(whole));
+                if (!tail) {
+                    ++dropped;
+                    checksum.reset();
+                    reset();
+                    state = State::Skip;
+                    continue;
+                }
+                // Every byte of the run is below 0x80, so unpacking cannot fail
+                (void) midi_unpack(std::span<const uint8_t>(first, whole), tail);
+                checksum.update(tail, midi_unpacked_length(whole));
+                first += whole;
+            }
+            group_length = static_cast<uint8_t>(run_end - first);
+            std::memcpy(group, first, group_length);
+            first = run_end;
+        }
+        return dropped;
+    }
+
+    // Returns true if the byte was a data byte. Frames are not checked against a maximum length
+    // or checksum here.
+    template <typename Byte>
+    [[nodiscard]] constexpr bool process_byte(Byte byte, Byte *output) {
+        if (packet_complete()) {
+            reset();
+        }
+
+        const auto value = static_cast<uint8_t>(byte);
+        if (value & 0x80) {
+            if (is_realtime(value)) {
+                return false;
+            }
+            if (value == SYSEX_END && state == State::Data) {
+                packet_complete_flag = true;
+                return false;
+            }
+            reset();
+            if (value == SYSEX_START) {
+                state = State::Id;
+            }
+            return false;
+        }
+
+        switch (state) {
+            case State::Idle:
+            case State::Skip:
+                return false;
+            case State::Id:
+                state = value == SYSEX_NON_COMMERCIAL_ID ? State::Data : State::Skip;
+                return false;
+            case State::Data:
+                break;
+        }
+        // group[0] holds the header and group_length counts the bytes of its group seen so far
+        if (group_length == 0) {
+            group[0] = value;
+            group_length = 1;
+            return false;
+        }
+        *output = static_cast<Byte>(value | ((group[0] >> (group_length - 1)) & 1) << 7);
+        group_length = group_length == 7 ? 0 : group_length + 1;
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool packet_complete() const {
+        return packet_complete_flag;
+    }
 
+    constexpr void reset() {
+        state = State::Idle;
+        group_length = 0;
+        packet_complete_flag = false;
+        frame.clear();
+    }
+};
 
 #endif //MIDIBITPACK_HPP
@@ -2,23 +2,91 @@
 #include "c74_max.h"
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_globalsymbol.h"
+#include "sadam.stream.h"
 #include "bytestream/COBS.hpp"
+#include "bytestream/CRC.hpp"
+#include "bytestream/frame_queue.hpp"
 #include "bytestream/SLIP.hpp"
+#include "bytestream/LEB128.hpp"
+#include "midibitpack.hpp"
 #include "maxutils/attributes.hpp"
+#include <algorithm>
+#include <limits>
 #include <span>
+#include <type_traits>
 #include <vector>
 
 using namespace c74::max;
 
 struct t_bs_decodeframe {
     t_object ob;
-    enum class Mode { COBS, SLIP } mode;
+    enum class Mode { COBS, SLIP, LEB128, SysEx } mode;
+    enum class CRC { None, CRC8, CRC16, CRC32C } crc;
+    // Immediate outputs frames as they complete. Throttle queues them and outputs at most
+    // pertick per scheduler tick. Latest outputs only the newest frame completed since the last
+    // tick, for patches that only care about current state.
+    enum class Delivery { Immediate, Throttle, Latest } delivery;
+    // The delivery the queued frames were queued under; a change drops them, so frames queued
+    // for a later tick never go out after newer ones sent straight away
+    Delivery queued_delivery;
+    t_atom_long pertick;
+    // Frames that failed the checksum, and frames dropped for any reason: those, and frames
+    // that were malformed or longer than maxframe
+    t_atom_long crc_errors;
+    t_atom_long dropped;
+    t_atom_long maxframe;
     t_outlet *out;
+    t_clock *clock;
+    // Raw bytes arriving on instream are decoded like a list, and each frame goes to outstream,
+    // when set, as one array instead of a list of atoms
+    t_symbol *instream_name;
+    t_symbol *outstream_name;
+    t_object *instream;
+    t_object *outstream;
     SLIPDecoder slip_decoder;
     COBSDecoder cobs_decoder;
+    LEB128Decoder leb128_decoder;
+    MIDISysExDecoder sysex_decoder;
+    any_checksum checksum;
+    std::vector<uint8_t> input;
     std::vector<t_atom> buffer;
+    std::vector<uint8_t> output;
+    // Frames are queued on whichever thread input arrives on, the main thread as well as the
+    // scheduler in Overdrive, and taken off on the scheduler, so the queue is only touched
+    // inside queue_lock. A frame is copied out before it is output, not to hold the lock while
+    // the patch runs.
+    frame_queue queue;
+    t_critical queue_lock;
+    std::vector<uint8_t> dequeued;
+
+    static constexpr t_atom_long default_maxframe = 4096;
+    // Frames a throttled object holds before dropping the oldest
+    static constexpr size_t max_queued_frames = 1024;
 };
 
+// Passes a checksum through to a decoder, counting the frames that fail it. The decoders only
+// report how many frames they drop, whatever the reason.
+template <typename Checksum>
+struct counted_checksum {
+    static constexpr size_t size = Checksum::size;
+    Checksum &checksum;
+    t_atom_long &failures;
+
+    void update(const uint8_t *data, size_t n) { checksum.update(data, n); }
+    [[nodiscard]] bool valid() const {
+        const bool intact = checksum.valid();
+        failures += !intact;
+        return intact;
+    }
+    void reset() { checksum.reset(); }
+};
+
+static void bs_decodeframe_process(t_bs_decodeframe *x, std::span<const uint8_t> bytes);
+static t_max_err bs_decodeframe_set_maxframe(t_bs_decodeframe *x, t_atom_long length);
+static void bs_decodeframe_tick(t_bs_decodeframe *x);
+static t_max_err bs_decodeframe_set_stream(t_bs_decodeframe *x, t_symbol *&name, t_object *&stream, t_symbol *new_name);
+
 extern "C"
 {
 
@@ -27,10 +95,13 @@ void bs_decodeframe_free(t_bs_decodeframe *x);
 void bs_decodeframe_assist(t_bs_decodeframe *x, void *b, long m, long a, char *s);
 void bs_decodeframe_int(t_bs_decodeframe *x, long n);
 void bs_decodeframe_list(t_bs_decodeframe *x, t_symbol *s, long argc, t_atom *argv);
+void bs_decodeframe_notify(t_bs_decodeframe *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
 
 static t_class *s_bs_decodeframe = nullptr;
 
 void ext_main(void *) {
+    common_symbols_init();
+
     t_class *c = class_new(
         "bs.decodeframe",
         (method) bs_decodeframe_new,
@@ -42,8 +113,36 @@ void ext_main(void *) {
     class_addmethod(c, (method) bs_decodeframe_int, "int", A_LONG, 0);
     class_addmethod(c, (method) bs_decodeframe_list, "list", A_GIMME, 0);
     class_addmethod(c, (method) bs_decodeframe_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method) bs_decodeframe_notify, "notify", A_CANT, 0);
 
     maxutils::create_attr<&t_bs_decodeframe::mode>(c);
+    maxutils::create_attr<&t_bs_decodeframe::crc>(c);
+    maxutils::create_attr<&t_bs_decodeframe::delivery>(c);
+    CLASS_ATTR_ATOM_LONG(c, "pertick", 0, t_bs_decodeframe, pertick);
+    CLASS_ATTR_FILTER_MIN(c, "pertick", 1);
+    CLASS_ATTR_ATOM_LONG(c, "crc_errors", ATTR_SET_OPAQUE_USER, t_bs_decodeframe, crc_errors);
+    CLASS_ATTR_ATOM_LONG(c, "dropped", ATTR_SET_OPAQUE_USER, t_bs_decodeframe, dropped);
+    maxutils::create_attr(c, "maxframe",
+        [](t_bs_decodeframe *x) -> t_atom_long {
+            return x->maxframe;
+        },
+        [](t_bs_decodeframe *x, t_atom_long length) -> t_max_err {
+            return bs_decodeframe_set_maxframe(x, length);
+        });
+    maxutils::create_attr(c, "instream",
+        [](t_bs_decodeframe *x) -> t_symbol * {
+            return x->instream_name ? x->instream_name : _sym_none;
+        },
+        [](t_bs_decodeframe *x, t_symbol *name) -> t_max_err {
+            return bs_decodeframe_set_stream(x, x->instream_name, x->instream, name);
+        });
+    maxutils::create_attr(c, "outstream",
+        [](t_bs_decodeframe *x) -> t_symbol * {
+            return x->outstream_name ? x->outstream_name : _sym_none;
+        },
+        [](t_bs_decodeframe *x, t_symbol *name) -> t_max_err {
+            return bs_decodeframe_set_stream(x, x->outstream_name, x->outstream, name);
+        });
 
     class_register(CLASS_BOX, c);
     s_bs_decodeframe = c;
@@ -58,13 +157,51 @@ void *bs_decodeframe_new(t_symbol *s, long argc, t_atom *argv) {
         x->mode = t_bs_decodeframe::Mode::COBS;
         x->cobs_decoder = {};
         x->slip_decoder = {};
+        x->leb128_decoder = {};
+        x->sysex_decoder = {};
+        x->crc = t_bs_decodeframe::CRC::None;
+        x->checksum = {};
+        x->input = {};
+        x->buffer = {};
+        x->output = {};
+        x->instream_name = nullptr;
+        x->outstream_name = nullptr;
+        x->instream = nullptr;
+        x->outstream = nullptr;
+        x->queue = {};
+        x->queue.set_max_frames(t_bs_decodeframe::max_queued_frames);
+        critical_new(&x->queue_lock);
+        x->dequeued = {};
+        x->delivery = t_bs_decodeframe::Delivery::Immediate;
+        x->queued_delivery = x->delivery;
+        x->pertick = 1;
+        x->crc_errors = 0;
+        x->dropped = 0;
         x->out = listout(x);
+        x->clock = clock_new(x, (method) bs_decodeframe_tick);
+        bs_decodeframe_set_maxframe(x, t_bs_decodeframe::default_maxframe);
+        attr_args_process(x, argc, argv);
     }
     return x;
 }
 
 void bs_decodeframe_free(t_bs_decodeframe *x) {
+    bs_decodeframe_set_stream(x, x->instream_name, x->instream, nullptr);
+    bs_decodeframe_set_stream(x, x->outstream_name, x->outstream, nullptr);
+    clock_unset(x->clock);
+    clock_free(x->clock);
     object_free(x->out);
+    x->slip_decoder.~SLIPDecoder();
+    x->cobs_decoder.~COBSDecoder();
+    x->leb128_decoder.~LEB128Decoder();
+    x->sysex_decoder.~MIDISysExDecoder();
+    x->checksum.~variant();
+    x->input.~vector();
+    x->buffer.~vector();
+    x->output.~vector();
+    x->queue.~frame_queue();
+    critical_free(x->queue_lock);
+    x->dequeued.~vector();
 }
 
 void bs_decodeframe_assist(t_bs_decodeframe *x, void *b, long io, long index, char *s) {
@@ -87,43 +224,192 @@ void bs_decodeframe_assist(t_bs_decodeframe *x, void *b, long io, long index, ch
     }
 }
 
-void bs_decodeframe_int(t_bs_decodeframe *x, long n) {
-    if (n < 0 || n > 255) {
-        object_warn((t_object *) x, "Value %d out of range - clamp to 0-255", n);
+// All memory for frames is allocated here, up front: each decoder holds at most maxframe bytes,
+// and the atoms for an outgoing frame are written over the same scratch list every time.
+t_max_err bs_decodeframe_set_maxframe(t_bs_decodeframe *x, t_atom_long length) {
+    const t_atom_long max_list_length = std::numeric_limits<short>::max();
+    if (length < 1 || length > max_list_length) {
+        object_warn((t_object *) x, "maxframe must be between 1 and %ld, clamping", max_list_length);
+        length = std::clamp<t_atom_long>(length, 1, max_list_length);
     }
-    const auto byte = static_cast<uint8_t>(n);
+    x->maxframe = length;
+    x->slip_decoder.set_max_frame_length(length);
+    x->cobs_decoder.set_max_frame_length(length);
+    x->leb128_decoder.set_max_frame_length(length);
+    x->sysex_decoder.set_max_frame_length(length);
+    x->checksum = make_checksum(static_cast<size_t>(x->crc));
+    // Queued frames may be longer than the new scratch list
+    critical_enter(x->queue_lock);
+    x->queue.clear();
+    critical_exit(x->queue_lock);
+    x->buffer.resize(length);
+    x->buffer.shrink_to_fit();
+    return MAX_ERR_NONE;
+}
 
-    auto process_byte = [x, byte](auto &decoder) {
-        uint8_t decoded_byte;
-        if (decoder.process_byte(byte, &decoded_byte)) {
-            t_atom atom;
-            atom_setlong(&atom, decoded_byte);
-            x->buffer.push_back(atom);
+// The decoders never hold more than maxframe bytes, so the scratch list always has room
+static void bs_decodeframe_output(t_bs_decodeframe *x, std::span<const uint8_t> frame) {
+    if (x->outstream) {
+        x->output.assign(frame.begin(), frame.end());
+        object_method(x->outstream, sadam::stream_addarray, &x->output);
+        object_method(x->outstream, sadam::stream_clear);
+        return;
+    }
+    std::ranges::transform(frame, x->buffer.begin(), [](const uint8_t byte) -> t_atom {
+        return { .a_type = A_LONG, .a_w.w_long = byte };
+    });
+    outlet_list(x->out, nullptr, frame.size(), x->buffer.data());
+}
+
+// Drops the queued frames if delivery has changed since they were queued. Call inside queue_lock.
+static void bs_decodeframe_check_delivery(t_bs_decodeframe *x) {
+    if (x->queued_delivery != x->delivery) {
+        x->queued_delivery = x->delivery;
+        x->queue.clear();
+    }
+}
+
+// Outputs what the delivery policy allows this tick, and comes back next tick for the rest
+void bs_decodeframe_tick(t_bs_decodeframe *x) {
+    critical_enter(x->queue_lock);
+    bs_decodeframe_check_delivery(x);
+    size_t budget = x->delivery == t_bs_decodeframe::Delivery::Throttle ? static_cast<size_t>(x->pertick)
+                                                                          : x->queue.size();
+    for (; budget && !x->queue.empty(); --budget) {
+        const std::span<const uint8_t> frame = x->queue.front();
+        x->dequeued.assign(frame.begin(), frame.end());
+        x->queue.pop();
+        critical_exit(x->queue_lock);
+        bs_decodeframe_output(x, x->dequeued);
+        critical_enter(x->queue_lock);
+    }
+    const bool more = !x->queue.empty();
+    critical_exit(x->queue_lock);
+    if (more) {
+        clock_delay(x->clock, 1);
+    }
+}
+
+void bs_decodeframe_process(t_bs_decodeframe *x, std::span<const uint8_t> bytes) {
+    auto emit_frame = [x](std::span<const uint8_t> frame) {
+        if (x->delivery == t_bs_decodeframe::Delivery::Immediate) {
+            bs_decodeframe_output(x, frame);
+            return;
+        }
+        critical_enter(x->queue_lock);
+        if (x->delivery == t_bs_decodeframe::Delivery::Latest) {
+            x->queue.clear();
         }
-        if (decoder.packet_complete()) {
-            outlet_list(x->out, nullptr, x->buffer.size(), x->buffer.data());
-            x->buffer.clear();
-            decoder.reset();
+        // Only the first frame of a burst needs to set the clock
+        const bool first = x->queue.empty();
+        x->queue.push(frame);
+        critical_exit(x->queue_lock);
+        if (first) {
+            clock_delay(x->clock, 0);
         }
     };
 
-    switch (x->mode) {
-        case t_bs_decodeframe::Mode::SLIP:
-            process_byte(x->slip_decoder);
-            break;
-        case t_bs_decodeframe::Mode::COBS:
-            process_byte(x->cobs_decoder);
-            break;
+    critical_enter(x->queue_lock);
+    bs_decodeframe_check_delivery(x);
+    critical_exit(x->queue_lock);
+
+    // Switching checksum mid-frame would leave the partial frame unverifiable, so start afresh
+    if (x->checksum.index() != static_cast<size_t>(x->crc)) {
+        x->checksum = make_checksum(static_cast<size_t>(x->crc));
+        x->slip_decoder.reset();
+        x->cobs_decoder.reset();
+        x->leb128_decoder.reset();
+        x->sysex_decoder.reset();
     }
+
+    // Frames failing the checksum are dropped by the decoder, before any atoms are made for them
+    const size_t dropped = std::visit([x, bytes, &emit_frame](auto &inner) -> size_t {
+        counted_checksum<std::remove_reference_t<decltype(inner)>> checksum{inner, x->crc_errors};
+        switch (x->mode) {
+            case t_bs_decodeframe::Mode::SLIP:
+                return x->slip_decoder.process(bytes, emit_frame, checksum);
+            case t_bs_decodeframe::Mode::COBS:
+                return x->cobs_decoder.process(bytes, emit_frame, checksum);
+            case t_bs_decodeframe::Mode::LEB128: {
+                // It only drops frames that fail the checksum, one each time it loses its place
+                // rather than one for every misread frame it tries while finding it again, so
+                // its drops are its checksum failures
+                const size_t lost = x->leb128_decoder.process(bytes, emit_frame, inner);
+                x->crc_errors += static_cast<t_atom_long>(lost);
+                return lost;
+            }
+            case t_bs_decodeframe::Mode::SysEx:
+                return x->sysex_decoder.process(bytes, emit_frame, checksum);
+        }
+        return 0;
+    }, x->checksum);
+    x->dropped += static_cast<t_atom_long>(dropped);
+}
+
+void bs_decodeframe_int(t_bs_decodeframe *x, long n) {
+    if (n < 0 || n > 255) {
+        object_warn((t_object *) x, "Value %d out of range - clamp to 0-255", n);
+    }
+    const auto byte = static_cast<uint8_t>(n);
+    bs_decodeframe_process(x, std::span(&byte, 1));
 }
 
 void bs_decodeframe_list(t_bs_decodeframe *x, t_symbol *s, long argc, t_atom *argv) {
     std::span<const t_atom> args(argv, argc);
-    for (const t_atom &atom : args) {
-        if (atom.a_type != A_LONG) {
-            object_error((t_object *) x, "Expected list of integers");
-            return;
+    if (!std::ranges::all_of(args, [](const t_atom &atom) { return atom_gettype(&atom) == A_LONG; })) {
+        object_error((t_object *) x, "Expected list of integers");
+        return;
+    }
+
+    x->input.resize(args.size());
+    std::ranges::transform(args, x->input.begin(), [x](const t_atom &atom) {
+        const long value = atom_getlong(&atom);
+        if (value < 0 || value > 255) {
+            object_warn((t_object *) x, "Value %d out of range - clamp to 0-255", value);
+        }
+        return static_cast<uint8_t>(value);
+    });
+    bs_decodeframe_process(x, x->input);
+}
+
+// Streams are referenced by name and may not exist yet; notify() picks the object up when a
+// stream of that name appears and lets go of it when the stream goes away. "none" unsets.
+t_max_err bs_decodeframe_set_stream(t_bs_decodeframe *x, t_symbol *&name, t_object *&stream, t_symbol *new_name) {
+    if (new_name && new_name != _sym_none && new_name != _sym_nothing
+        && (new_name == x->instream_name || new_name == x->outstream_name) && new_name != name) {
+        object_error((t_object *) x, "instream and outstream must be different streams");
+        return MAX_ERR_GENERIC;
+    }
+    if (name) {
+        globalsymbol_dereference((t_object *) x, name->s_name, sadam::stream_classname->s_name);
+    }
+    name = nullptr;
+    stream = nullptr;
+    if (new_name && new_name != _sym_none && new_name != _sym_nothing) {
+        name = new_name;
+        stream = (t_object *) globalsymbol_reference((t_object *) x, name->s_name, sadam::stream_classname->s_name);
+    }
+    return MAX_ERR_NONE;
+}
+
+void bs_decodeframe_notify(t_bs_decodeframe *x, t_symbol *, t_symbol *msg, void *sender, void *data) {
+    if (msg == sadam::stream_before_clear) {
+        if (sender == x->instream) {
+            bs_decodeframe_process(x, *static_cast<std::vector<uint8_t> *>(data));
+        }
+    } else if (msg == sadam::stream_binding) {
+        t_symbol *name = nullptr;
+        object_method(data, sadam::stream_getname, &name);
+        if (name == x->instream_name) {
+            x->instream = (t_object *) data;
+        } else if (name == x->outstream_name) {
+            x->outstream = (t_object *) data;
+        }
+    } else if (msg == sadam::stream_unbinding) {
+        if (data == x->instream) {
+            x->instream = nullptr;
+        } else if (data == x->outstream) {
+            x->outstream = nullptr;
         }
-        bs_decodeframe_int(x, atom_getlong(&atom));
     }
 }
@@ -2,9 +2,16 @@
 #include "c74_max.h"
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_globalsymbol.h"
+#include "sadam.stream.h"
 #include "bytestream/COBS.hpp"
+#include "bytestream/CRC.hpp"
 #include "bytestream/SLIP.hpp"
+#include "bytestream/LEB128.hpp"
+#include "midibitpack.hpp"
 #include "maxutils/attributes.hpp"
+#include <algorithm>
+#include <optional>
 #include <span>
 #include <vector>
 #include <ranges>
@@ -13,11 +20,34 @@ using namespace c74::max;
 
 struct t_bs_encodeframe {
     t_object ob;
-    enum Mode { COBS, SLIP } mode;
+    // SysEx packs the frame into 7-bit bytes between SysEx start and end, to tunnel it over MIDI
+    enum Mode { COBS, SLIP, LEB128, SysEx } mode;
+    enum class CRC { None, CRC8, CRC16, CRC32C } crc;
     t_outlet *out;
-    t_symbol *stream_name;
+    // Each array arriving on instream is framed like a list, and frames go to outstream, when
+    // set, as one array instead of a list of atoms
+    t_symbol *instream_name;
+    t_symbol *outstream_name;
+    t_object *instream;
+    t_object *outstream;
+    std::vector<uint8_t> encoded;
+    std::vector<t_atom> atoms;
+
+    // Frames registered with "define", kept ready to output. A frame is encoded again only if
+    // mode or crc have changed since it last was.
+    struct named_frame {
+        t_symbol *name;
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> encoded;
+        std::vector<t_atom> atoms;
+        Mode mode;
+        CRC crc;
+    };
+    std::vector<named_frame> frames;
 };
 
+static t_max_err bs_encodeframe_set_stream(t_bs_encodeframe *x, t_symbol *&name, t_object *&stream, t_symbol *new_name);
+
 extern "C" {
 // Basic Methods
 void *bs_encodeframe_new(t_symbol *s, long argc, t_atom *argv);
@@ -29,6 +59,10 @@ void bs_encodeframe_assist(t_bs_encodeframe *x, void *b, long m, char *s);
 // Messages
 void bs_encodeframe_int(t_bs_encodeframe *x, long n);
 void bs_encodeframe_list(t_bs_encodeframe *x, t_symbol *s, long argc, t_atom *argv);
+void bs_encodeframe_define(t_bs_encodeframe *x, t_symbol *s, long argc, t_atom *argv);
+void bs_encodeframe_undefine(t_bs_encodeframe *x, t_symbol *name);
+void bs_encodeframe_anything(t_bs_encodeframe *x, t_symbol *s, long argc, t_atom *argv);
+void bs_encodeframe_notify(t_bs_encodeframe *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
 
 // Global class instance
 static t_class *s_bs_encodeframe;
@@ -48,8 +82,27 @@ void ext_main(void *r) {
     class_addmethod(c, (method) bs_encodeframe_assist, "assist", A_CANT, 0);
     class_addmethod(c, (method) bs_encodeframe_int, "int", A_LONG, 0);
     class_addmethod(c, (method) bs_encodeframe_list, "list", A_GIMME, 0);
+    class_addmethod(c, (method) bs_encodeframe_define, "define", A_GIMME, 0);
+    class_addmethod(c, (method) bs_encodeframe_undefine, "undefine", A_SYM, 0);
+    class_addmethod(c, (method) bs_encodeframe_anything, "anything", A_GIMME, 0);
+    class_addmethod(c, (method) bs_encodeframe_notify, "notify", A_CANT, 0);
 
     maxutils::create_attr<&t_bs_encodeframe::mode>(c);
+    maxutils::create_attr<&t_bs_encodeframe::crc>(c);
+    maxutils::create_attr(c, "instream",
+        [](t_bs_encodeframe *x) -> t_symbol * {
+            return x->instream_name ? x->instream_name : _sym_none;
+        },
+        [](t_bs_encodeframe *x, t_symbol *name) -> t_max_err {
+            return bs_encodeframe_set_stream(x, x->instream_name, x->instream, name);
+        });
+    maxutils::create_attr(c, "outstream",
+        [](t_bs_encodeframe *x) -> t_symbol * {
+            return x->outstream_name ? x->outstream_name : _sym_none;
+        },
+        [](t_bs_encodeframe *x, t_symbol *name) -> t_max_err {
+            return bs_encodeframe_set_stream(x, x->outstream_name, x->outstream, name);
+        });
 
     class_register(CLASS_BOX, c);
     s_bs_encodeframe = c;
@@ -61,14 +114,27 @@ void *bs_encodeframe_new(t_symbol *s, long argc, t_atom *argv) {
     auto *x = (t_bs_encodeframe *) object_alloc(s_bs_encodeframe);
     if (x) {
         x->mode = t_bs_encodeframe::Mode::COBS;
+        x->crc = t_bs_encodeframe::CRC::None;
         x->out = listout(x);
+        x->instream_name = nullptr;
+        x->outstream_name = nullptr;
+        x->instream = nullptr;
+        x->outstream = nullptr;
+        x->encoded = {};
+        x->atoms = {};
+        x->frames = {};
         attr_args_process(x, argc, argv);
     }
     return x;
 }
 
 void bs_encodeframe_free(t_bs_encodeframe *x) {
+    bs_encodeframe_set_stream(x, x->instream_name, x->instream, nullptr);
+    bs_encodeframe_set_stream(x, x->outstream_name, x->outstream, nullptr);
     object_free(x->out);
+    x->encoded.~vector();
+    x->atoms.~vector();
+    x->frames.~vector();
 }
 
 void bs_encodeframe_assist(t_bs_encodeframe *x, void *b, long m, char *s) {
@@ -79,13 +145,11 @@ void bs_encodeframe_bang(t_bs_encodeframe *x) {
     /* bang message implementation */
 }
 
-void bs_encodeframe_list(t_bs_encodeframe *x, t_symbol *, long argc, t_atom *argv) {
-    if (!argc) return;
-
-    std::span<const t_atom> args(argv, argc);
+// Checks that every atom is an integer and narrows them to bytes
+static std::optional<std::vector<uint8_t>> bs_encodeframe_payload(t_bs_encodeframe *x, std::span<const t_atom> args) {
     if (!std::ranges::all_of(args, [](const t_atom &atom) { return atom_gettype(&atom) == A_LONG; })) {
         object_error((t_object *) x, "Expected list of integers");
-        return;
+        return std::nullopt;
     }
 
     auto as_bytes = std::ranges::views::transform(args, [x](const t_atom atom) {
@@ -95,35 +159,134 @@ void bs_encodeframe_list(t_bs_encodeframe *x, t_symbol *, long argc, t_atom *arg
         }
         return static_cast<uint8_t>(value);
     });
-    std::vector bytes(as_bytes.begin(), as_bytes.end());
-
-    std::vector<uint8_t> encoded;
+    return std::vector(as_bytes.begin(), as_bytes.end());
+}
 
-    switch (x->mode) {
-        case t_bs_encodeframe::Mode::SLIP: {
-            encoded.resize(slip_encoded_max_length(bytes.size()));
-            auto encoded_end = slip_encode_frame(bytes.begin(), bytes.end(), encoded.begin());
-            encoded.resize(std::distance(encoded.begin(), encoded_end));
-            break;
+// Frames payload with the current mode and crc into encoded, reusing its storage
+static void bs_encodeframe_encode(t_bs_encodeframe *x, std::span<const uint8_t> bytes, std::vector<uint8_t> &encoded) {
+    // The trailer is computed in the same pass that encodes the payload
+    std::visit([&](auto checksum) {
+        const size_t framed_size = bytes.size() + checksum.size;
+        switch (x->mode) {
+            case t_bs_encodeframe::Mode::SLIP: {
+                encoded.resize(slip_encoded_length(bytes) + 2 * checksum.size);
+                SLIPEncoder encoder(encoded.data());
+                push_with_checksum(encoder, bytes, checksum);
+                encoded.resize(encoder.finish());
+                break;
+            }
+            case t_bs_encodeframe::Mode::COBS: {
+                encoded.resize(cobs_encoded_max_length(framed_size));
+                COBSEncoder encoder(encoded.data());
+                push_with_checksum(encoder, bytes, checksum);
+                encoded.resize(encoder.finish());
+                break;
+            }
+            case t_bs_encodeframe::Mode::LEB128: {
+                encoded.resize(leb128_encoded_length(framed_size));
+                auto out = leb128_encode(framed_size, encoded.begin());
+                out = std::copy(bytes.begin(), bytes.end(), out);
+                checksum.update(bytes.data(), bytes.size());
+                checksum.write(out);
+                break;
+            }
+            case t_bs_encodeframe::Mode::SysEx: {
+                encoded.resize(midi_sysex_encoded_length(framed_size));
+                MIDISysExEncoder encoder(encoded.data());
+                push_with_checksum(encoder, bytes, checksum);
+                encoded.resize(encoder.finish());
+                break;
+            }
         }
-        case t_bs_encodeframe::Mode::COBS: {
-            encoded.resize(cobs_encoded_max_length(bytes.size()));
-            auto encoded_end = cobs_encode_frame(bytes.begin(), bytes.end(), encoded.begin());
-            encoded.resize(std::distance(encoded.begin(), encoded_end));
-            break;
-        }
-    }
+    }, make_checksum(static_cast<size_t>(x->crc)));
+}
 
-    if (encoded.empty()) {
+static void bs_encodeframe_to_atoms(std::span<const uint8_t> encoded, std::vector<t_atom> &atoms) {
+    atoms.resize(encoded.size());
+    std::ranges::transform(encoded, atoms.begin(), [](const uint8_t byte) -> t_atom {
+        return { .a_type = A_LONG, .a_w.w_long = byte };
+    });
+}
+
+// Frames payload and sends it on, to outstream if there is one and out as a list otherwise
+static void bs_encodeframe_send(t_bs_encodeframe *x, std::span<const uint8_t> payload) {
+    bs_encodeframe_encode(x, payload, x->encoded);
+    if (x->encoded.empty()) {
         object_error((t_object *) x, "Failed to encode frame");
         return;
     }
+    if (x->outstream) {
+        object_method(x->outstream, sadam::stream_addarray, &x->encoded);
+        object_method(x->outstream, sadam::stream_clear);
+        return;
+    }
+    bs_encodeframe_to_atoms(x->encoded, x->atoms);
+    outlet_list(x->out, nullptr, x->atoms.size(), x->atoms.data());
+}
 
-    auto as_atoms = std::ranges::views::transform(encoded, [](const uint8_t byte) -> t_atom {
-        return { .a_type = A_LONG, .a_w.w_long = byte };
-    });
-    std::vector atoms_out(as_atoms.begin(), as_atoms.end());
-    outlet_list(x->out, nullptr, atoms_out.size(), atoms_out.data());
+void bs_encodeframe_list(t_bs_encodeframe *x, t_symbol *, long argc, t_atom *argv) {
+    if (!argc) return;
+
+    const auto bytes = bs_encodeframe_payload(x, std::span<const t_atom>(argv, argc));
+    if (!bytes) return;
+
+    bs_encodeframe_send(x, *bytes);
+}
+
+// "define <name> <bytes...>" encodes a fixed frame once; the message <name> then outputs it.
+// Redefining a name replaces its frame.
+void bs_encodeframe_define(t_bs_encodeframe *x, t_symbol *, long argc, t_atom *argv) {
+    if (argc < 1 || atom_gettype(argv) != A_SYM) {
+        object_error((t_object *) x, "define expects a name followed by a list of integers");
+        return;
+    }
+    t_symbol *name = atom_getsym(argv);
+    if (zgetfn((t_object *) x, name) || object_attr_get(x, name)) {
+        object_error((t_object *) x, "Cannot define %s: the name is taken by a message", name->s_name);
+        return;
+    }
+
+    auto bytes = bs_encodeframe_payload(x, std::span<const t_atom>(argv + 1, argc - 1));
+    if (!bytes) return;
+
+    t_bs_encodeframe::named_frame frame{name, std::move(*bytes), {}, {}, x->mode, x->crc};
+    bs_encodeframe_encode(x, frame.payload, frame.encoded);
+    bs_encodeframe_to_atoms(frame.encoded, frame.atoms);
+
+    auto existing = std::ranges::find(x->frames, name, &t_bs_encodeframe::named_frame::name);
+    if (existing != x->frames.end()) {
+        *existing = std::move(frame);
+    } else {
+        x->frames.push_back(std::move(frame));
+    }
+}
+
+void bs_encodeframe_undefine(t_bs_encodeframe *x, t_symbol *name) {
+    std::erase_if(x->frames, [name](const auto &frame) { return frame.name == name; });
+}
+
+// Outputs a frame registered with "define"
+void bs_encodeframe_anything(t_bs_encodeframe *x, t_symbol *s, long argc, t_atom *) {
+    auto frame = std::ranges::find(x->frames, s, &t_bs_encodeframe::named_frame::name);
+    if (frame == x->frames.end()) {
+        object_error((t_object *) x, "No frame defined as %s", s->s_name);
+        return;
+    }
+    if (argc) {
+        object_warn((t_object *) x, "Arguments to %s ignored", s->s_name);
+    }
+    if (frame->mode != x->mode || frame->crc != x->crc) {
+        bs_encodeframe_encode(x, frame->payload, frame->encoded);
+        bs_encodeframe_to_atoms(frame->encoded, frame->atoms);
+        frame->mode = x->mode;
+        frame->crc = x->crc;
+    }
+    if (x->outstream) {
+        object_method(x->outstream, sadam::stream_addarray, &frame->encoded);
+        object_method(x->outstream, sadam::stream_clear);
+        return;
+    }
+    outlet_list(x->out, nullptr, frame->atoms.size(), frame->atoms.data());
 }
 
 void bs_encodeframe_int(t_bs_encodeframe *x, long n) {
@@ -131,3 +294,45 @@ void bs_encodeframe_int(t_bs_encodeframe *x, long n) {
     atom_setlong(&atom, n);
     bs_encodeframe_list(x, _sym_list, 1, &atom);
 }
+
+// Streams are referenced by name and may not exist yet; notify() picks the object up when a
+// stream of that name appears and lets go of it when the stream goes away. "none" unsets.
+t_max_err bs_encodeframe_set_stream(t_bs_encodeframe *x, t_symbol *&name, t_object *&stream, t_symbol *new_name) {
+    if (new_name && new_name != _sym_none && new_name != _sym_nothing
+        && (new_name == x->instream_name || new_name == x->outstream_name) && new_name != name) {
+        object_error((t_object *) x, "instream and outstream must be different streams");
+        return MAX_ERR_GENERIC;
+    }
+    if (name) {
+        globalsymbol_dereference((t_object *) x, name->s_name, sadam::stream_classname->s_name);
+    }
+    name = nullptr;
+    stream = nullptr;
+    if (new_name && new_name != _sym_none && new_name != _sym_nothing) {
+        name = new_name;
+        stream = (t_object *) globalsymbol_reference((t_object *) x, name->s_name, sadam::stream_classname->s_name);
+    }
+    return MAX_ERR_NONE;
+}
+
+void bs_encodeframe_notify(t_bs_encodeframe *x, t_symbol *, t_symbol *msg, void *sender, void *data) {
+    if (msg == sadam::stream_before_clear) {
+        if (sender == x->instream) {
+            bs_encodeframe_send(x, *static_cast<std::vector<uint8_t> *>(data));
+        }
+    } else if (msg == sadam::stream_binding) {
+        t_symbol *name = nullptr;
+        object_method(data, sadam::stream_getname, &name);
+        if (name == x->instream_name) {
+            x->instream = (t_object *) data;
+        } else if (name == x->outstream_name) {
+            x->outstream = (t_object *) data;
+        }
+    } else if (msg == sadam::stream_unbinding) {
+        if (data == x->instream) {
+            x->instream = nullptr;
+        } else if (data == x->outstream) {
+            x->outstream = nullptr;
+        }
+    }
+}
@@ -10,6 +10,10 @@ using namespace c74::max;
 #include "atom_views.hpp"
 #include "type_info.hpp"
 #include "storage.hpp"
+#include "bytestream/delta_record.hpp"
+#include <algorithm>
+#include <bit>
+#include <optional>
 #include <ranges>
 #include <sadam.stream.h>
 
@@ -23,10 +27,30 @@ struct t_bs_frombytes {
     t_object ob;
     Endianness endianness;
     std::vector<t_outlet *> outlets;
+    // Asks the bs.tobytes at the other end for a keyframe. Only a box with @delta in its
+    // arguments has it, so one without keeps an outlet per field; delta turned on later by a
+    // message can't ask, and waits for the sender's next keyframe instead.
+    t_outlet *keyframe_outlet;
     std::vector<storage> storages;
+    // The storages laid out for plan_endianness, rebuilt if endianness changes
+    serialisation_plan plan;
+    Endianness plan_endianness;
+    // Between begin and end, the record arriving in chunks, read into the storages as it comes
+    std::optional<serialisation_plan::reader> chunked;
+    // Set when a chunked record turns out to be bad: the rest of its chunks, up to end, are
+    // dropped rather than read as records of their own
+    bool discarding;
+    std::vector<uint8_t> input;
+    // With delta on, records arrive as delta records from a bs.tobytes with delta on, and are
+    // rebuilt against the last one. One arriving in chunks is gathered until end to be decoded.
+    t_atom_long delta;
+    delta_decoder decoder;
+    std::optional<std::vector<uint8_t>> gathered;
     t_object *stream;
 };
 
+static void bs_frombytes_build_plan(t_bs_frombytes *x);
+
 BEGIN_USING_C_LINKAGE
 void *bs_frombytes_new(t_symbol *s, long argc, t_atom *argv);
 void bs_frombytes_free(t_bs_frombytes *x);
@@ -34,6 +58,8 @@ void bs_frombytes_assist(t_bs_frombytes *x, void *b, long io, long index, char *
 void bs_frombytes_notify(t_bs_frombytes *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
 void bs_frombytes_int(t_bs_frombytes *x, long n);
 void bs_frombytes_list(t_bs_frombytes *x, t_symbol *s, long argc, t_atom *argv);
+void bs_frombytes_begin(t_bs_frombytes *x, t_atom_long length);
+void bs_frombytes_end(t_bs_frombytes *x);
 
 static t_class *s_bs_frombytes = nullptr;
 
@@ -53,8 +79,12 @@ void ext_main(void *) {
     class_addmethod(c, (method) bs_frombytes_notify, "notify", A_CANT, 0);
     class_addmethod(c, (method) bs_frombytes_int, "int", A_LONG, 0);
     class_addmethod(c, (method) bs_frombytes_list, "list", A_GIMME, 0);
+    class_addmethod(c, (method) bs_frombytes_begin, "begin", A_LONG, 0);
+    class_addmethod(c, (method) bs_frombytes_end, "end", 0);
 
     maxutils::create_attr<&t_bs_frombytes::endianness>(c);
+    CLASS_ATTR_ATOM_LONG(c, "delta", 0, t_bs_frombytes, delta);
+    CLASS_ATTR_FILTER_CLIP(c, "delta", 0, 1);
     maxutils::create_attr(c, "stream",
         [](t_bs_frombytes *x) -> t_symbol * {
             t_symbol *name = _sym_none;
@@ -96,6 +126,11 @@ void *bs_frombytes_new(t_symbol *, long argc, t_atom *argv) {
             | std::views::transform([](const type_info &ti) { return storage(ti); });
         x->storages = std::vector(storages.begin(), storages.end());
 
+        // Outlets are created right to left
+        const bool delta_box = std::ranges::any_of(attrs, [](const t_atom &a) {
+            return atom_gettype(&a) == A_SYM && atom_getsym(&a) == gensym("@delta");
+        });
+        x->keyframe_outlet = delta_box ? outlet_new(x, nullptr) : nullptr;
         for (size_t i = 0; i < x->storages.size(); i++) {
             x->outlets.push_back(outlet_new(x, nullptr));
         }
@@ -106,7 +141,15 @@ void *bs_frombytes_new(t_symbol *, long argc, t_atom *argv) {
 
     x->endianness = Endianness::Native;
     x->stream = nullptr;
+    x->plan = {};
+    x->chunked = std::nullopt;
+    x->discarding = false;
+    x->input = {};
+    x->delta = 0;
+    x->decoder = {};
+    x->gathered = std::nullopt;
     attr_args_process(x, attrs.size(), attrs.data());
+    bs_frombytes_build_plan(x);
 
     return x;
 }
@@ -115,8 +158,16 @@ void bs_frombytes_free(t_bs_frombytes *x) {
     for (auto &outlet: x->outlets) {
         object_free(outlet);
     }
+    if (x->keyframe_outlet) {
+        object_free(x->keyframe_outlet);
+    }
     x->outlets.~vector();
     x->storages.~vector();
+    x->plan.~serialisation_plan();
+    x->chunked.~optional();
+    x->input.~vector();
+    x->decoder.~delta_decoder();
+    x->gathered.~optional();
 }
 
 void bs_frombytes_assist(t_bs_frombytes *x, void *b, long io, long index, char *s) {
@@ -125,6 +176,10 @@ void bs_frombytes_assist(t_bs_frombytes *x, void *b, long io, long index, char *
             strncpy_zero(s, "serialised bytes", 512);
             break;
         case 2: {
+            if (static_cast<size_t>(index) == x->storages.size()) {
+                strncpy_zero(s, "keyframe requests", 512);
+                break;
+            }
             std::string type = x->storages[index].info().to_string();
             strncpy_zero(s, type.c_str(), 512);
             break;
@@ -134,42 +189,196 @@ void bs_frombytes_assist(t_bs_frombytes *x, void *b, long io, long index, char *
     }
 }
 
-void bs_frombytes_handle_data(t_bs_frombytes *x, std::span<uint8_t> data) {
+// Lays the storages out once for the current endianness, so that deserialising is a loop of
+// copies with no per-field dispatch
+void bs_frombytes_build_plan(t_bs_frombytes *x) {
+    bool swap = false;
+    switch (x->endianness) {
+        case Endianness::Big:
+        case Endianness::Network:
+            swap = std::endian::native != std::endian::big;
+            break;
+        case Endianness::Little:
+            swap = std::endian::native != std::endian::little;
+            break;
+        case Endianness::Native:
+            break;
+    }
+    x->plan = serialisation_plan(swap);
+    std::vector<size_t> element_sizes;
+    for (auto &s: x->storages) {
+        s.add_to(x->plan);
+        element_sizes.push_back(s.info().element_bytes());
+    }
+    x->plan_endianness = x->endianness;
+    x->decoder = delta_decoder(element_sizes, (std::endian::native == std::endian::big) != swap);
+}
+
+static void bs_frombytes_output(t_bs_frombytes *x) {
+    for (size_t i = x->storages.size(); i != 0; --i) {
+        const auto &container = x->storages[i - 1];
+        const auto &outlet = x->outlets[x->outlets.size() - i];
+        std::vector<t_atom> atoms;
+        atoms.reserve(container.size());
+        container.store_to_atoms(std::back_inserter(atoms));
+        outlet_list(outlet, nullptr, atoms.size(), atoms.data());
+    }
+}
+
+// Rebuilds the record from a delta record and outputs it. A delta that doesn't follow on from
+// the last record is dropped, and the first of them since a keyframe asks for another. Given
+// length, data may hold more records after this one, and length is set to the bytes it took.
+static void bs_frombytes_read_delta(t_bs_frombytes *x, std::span<const uint8_t> data, size_t *length = nullptr) {
+    if (x->plan_endianness != x->endianness) {
+        bs_frombytes_build_plan(x);
+    }
     try {
-        switch (x->endianness) {
-            case Endianness::Big: {
-                zpp::bits::in in(data, zpp::bits::endian::big{});
-                in(zpp::bits::unsized(x->storages)).or_throw();
+        const auto outcome = length ? x->decoder.decode_first(data, *length) : x->decoder.decode(data);
+        switch (outcome) {
+            case delta_decoder::outcome::applied:
+                x->plan.read(x->decoder.record());
+                bs_frombytes_output(x);
                 break;
-            }
-            case Endianness::Little: {
-                zpp::bits::in in(data, zpp::bits::endian::little{});
-                in(zpp::bits::unsized(x->storages)).or_throw();
+            case delta_decoder::outcome::lost:
+                if (x->keyframe_outlet) {
+                    outlet_anything(x->keyframe_outlet, gensym("keyframe"), 0, nullptr);
+                }
                 break;
-            }
-            case Endianness::Network: {
-                zpp::bits::in in(data, zpp::bits::endian::network{});
-                in(zpp::bits::unsized(x->storages)).or_throw();
-                break;
-            }
-            case Endianness::Native: {
-                zpp::bits::in in(data, zpp::bits::endian::native{});
-                in(zpp::bits::unsized(x->storages)).or_throw();
+            case delta_decoder::outcome::waiting:
                 break;
+        }
+    } catch (const std::exception &e) {
+        object_error((t_object *) x, e.what());
+        if (length) {
+            *length = data.size();
+        }
+    }
+}
+
+// A stream holds every record added to it since it was last cleared: several when a bs.tobytes
+// coalesces a tick's records, or is banged more than once between clears. They are read one
+// after another, and each is output. Records don't say how long they are, so after a bad one
+// the rest of the stream is dropped.
+static void bs_frombytes_read_stream(t_bs_frombytes *x, std::span<const uint8_t> data) {
+    if (x->plan_endianness != x->endianness) {
+        bs_frombytes_build_plan(x);
+    }
+    while (!data.empty()) {
+        size_t length = data.size();
+        if (x->delta) {
+            bs_frombytes_read_delta(x, data, &length);
+        } else {
+            try {
+                length = x->plan.read(data);
+            } catch (const std::exception &e) {
+                object_error((t_object *) x, e.what());
             }
+            bs_frombytes_output(x);
+        }
+        if (!length) {
+            break; // a schema of no bytes
         }
+        data = data.subspan(length);
+    }
+}
+
+void bs_frombytes_handle_data(t_bs_frombytes *x, std::span<uint8_t> data) {
+    if (x->discarding) {
+        return;
+    }
+    if (x->gathered) {
+        x->gathered->insert(x->gathered->end(), data.begin(), data.end());
+        return;
+    }
+    if (x->delta) {
+        bs_frombytes_read_delta(x, data);
+        return;
+    }
+    if (x->chunked) {
+        try {
+            x->chunked->feed(data);
+        } catch (const std::exception &e) {
+            object_error((t_object *) x, e.what());
+            x->chunked.reset();
+            x->discarding = true;
+        }
+        return;
+    }
+
+    if (x->plan_endianness != x->endianness) {
+        bs_frombytes_build_plan(x);
+    }
+    try {
+        x->plan.read(data);
     } catch (const std::exception &e) {
         object_error((t_object *) x, e.what());
     }
+    bs_frombytes_output(x);
+}
 
-    for (size_t i = x->storages.size(); i != 0; --i) {
-        const auto &container = x->storages[i - 1];
-        const auto &outlet = x->outlets[x->outlets.size() - i];
-        std::vector<t_atom> atoms;
-        atoms.reserve(container.size());
-        container.store_to_atoms(std::back_inserter(atoms));
-        outlet_list(outlet, nullptr, atoms.size(), atoms.data());
+// Starts a record of length bytes sent in chunks. The lists up to end are read into the
+// storages as they arrive rather than gathered first.
+void bs_frombytes_begin(t_bs_frombytes *x, t_atom_long length) {
+    if (length < 0) {
+        object_error((t_object *) x, "begin: expected a length of 0 or more bytes");
+        return;
+    }
+    x->discarding = false;
+    if (x->chunked || x->gathered) {
+        object_warn((t_object *) x, "begin before end, dropping the record in progress");
+        x->chunked.reset();
+        x->gathered.reset();
+    }
+    if (x->delta) {
+        x->gathered.emplace();
+        x->gathered->reserve(static_cast<size_t>(length));
+        return;
+    }
+    // The least a record can take, its variable fields empty and its varints a byte each.
+    // Anything shorter is dropped up to end rather than found wanting there.
+    std::vector<type_info> schema;
+    schema.reserve(x->storages.size());
+    for (auto &s: x->storages) {
+        schema.push_back(s.info());
+    }
+    const size_t least = type_info::schema_size_bytes(schema);
+    if (static_cast<size_t>(length) < least) {
+        object_error((t_object *) x, "begin: %ld bytes is less than the schema's %ld",
+                     static_cast<long>(length), static_cast<long>(least));
+        x->discarding = true;
+        return;
+    }
+    if (x->plan_endianness != x->endianness) {
+        bs_frombytes_build_plan(x);
+    }
+    x->chunked.emplace(x->plan, static_cast<size_t>(length));
+}
+
+void bs_frombytes_end(t_bs_frombytes *x) {
+    if (x->gathered) {
+        const std::vector<uint8_t> record = std::move(*x->gathered);
+        x->gathered.reset();
+        bs_frombytes_read_delta(x, record);
+        return;
+    }
+    if (x->discarding) {
+        // The record's error has been reported already
+        x->discarding = false;
+        return;
+    }
+    if (!x->chunked) {
+        object_error((t_object *) x, "end without begin");
+        return;
+    }
+    const size_t missing = x->chunked->remaining();
+    const bool complete = x->chunked->complete();
+    x->chunked.reset();
+    if (!complete) {
+        object_error((t_object *) x, "Not enough bytes for the schema");
+    } else if (missing) {
+        object_warn((t_object *) x, "end came %ld bytes early", static_cast<long>(missing));
     }
+    bs_frombytes_output(x);
 }
 
 void bs_frombytes_int(t_bs_frombytes *x, long n) {
@@ -186,8 +395,8 @@ void bs_frombytes_list(t_bs_frombytes *x, t_symbol *s, long argc, t_atom *argv)
             }
             throw std::runtime_error("Expected integer");
         });
-        std::vector data(to_bytes.begin(), to_bytes.end());
-        bs_frombytes_handle_data(x, data);
+        x->input.assign(to_bytes.begin(), to_bytes.end());
+        bs_frombytes_handle_data(x, x->input);
     } catch (const std::exception &e) {
         object_error((t_object *) x, e.what());
     }
@@ -199,6 +408,6 @@ void bs_frombytes_notify(t_bs_frombytes *x, t_symbol *s, t_symbol *msg, void *se
     } else if (msg == sadam::stream_unbinding) {
         x->stream = nullptr;
     } else if (msg == sadam::stream_before_clear) {
-        bs_frombytes_handle_data(x, *static_cast<std::vector<uint8_t> *>(data));
+        bs_frombytes_read_stream(x, *static_cast<std::vector<uint8_t> *>(data));
     }
 }
@@ -9,7 +9,11 @@ using namespace c74::max;
 #include "storage.hpp"
 #include "atom_views.hpp"
 #include "sadam.stream.h"
+#include "bytestream/delta_record.hpp"
+#include "bytestream/framed_writer.hpp"
+#include <bit>
 #include <ranges>
+#include <utility>
 
 #include "maxutils/attributes.hpp"
 
@@ -24,15 +28,86 @@ struct t_bs_tobytes {
     size_t num_args;
 
     enum class Endianness { Big, Little, Network, Native } endianness;
+    enum class Framing { None, COBS, SLIP } framing;
+    // How a multi-plane matrix's elements are laid out: cell by cell as in memory, or one whole
+    // plane after another
+    enum class Layout { Interleaved, Planar } layout;
+    // Bytes per list or stream addition, 0 for the whole record at once. Chunked lists are
+    // bracketed by begin <bytes> and end.
+    t_atom_long chunksize;
+    // With coalesce on, hot inlets only mark the record dirty, and it is sent once at the end of
+    // the scheduler tick however many of them changed. Stream records are then cleared through
+    // to the stream once per tick too, all that tick's records together, which bs.frombytes
+    // reads one after another.
+    t_atom_long coalesce;
+    bool dirty;
+    bool stream_pending;
+    bool tick_scheduled;
+    t_clock *clock;
+
+    // With changesonly on, a bang sends nothing unless a field has changed since the record was
+    // last sent, float fields by more than their deadband. Only the fields loaded since then are
+    // compared, and those that changed are patched into image, the record as last sent.
+    t_atom_long changesonly;
+    t_atom deadband[max_args];
+    long num_deadbands;
+    std::vector<::deadband> deadbands;
+    std::vector<uint8_t> image;
+    bool image_valid;
+    Endianness image_endianness;
+    std::vector<size_t> image_offsets;
+    // Per field: loaded since it was last compared, the value image holds, and whether image
+    // holds a matrix's bytes instead
+    std::vector<bool> reloaded;
+    std::vector<storage> sent;
+    std::vector<bool> sent_from_matrix;
+    std::vector<uint8_t> field_bytes;
+
+    // With delta on for any field, records go out as delta records, see delta_record.hpp. A
+    // field with delta on is sent as its changes from the last record when that is shorter than
+    // the field, and any other field is sent whole when it changes. Every keyinterval deltas, and
+    // when a keyframe message comes, as bs.frombytes sends after missing one, every field is sent
+    // whole instead.
+    long delta[max_args];
+    long num_delta;
+    // Per field, the bytes of each element it is compared by, 0 for fields without delta on
+    std::vector<size_t> delta_sizes;
+    bool delta_records;
+    delta_encoder encoder;
+    t_atom_long keyinterval;
+    t_atom_long since_keyframe;
+    bool keyframe_due;
 
     t_outlet *outlet;
     std::vector<void *> proxies;
     std::vector<storage> storages;
+    // The storages laid out for plan_endianness, rebuilt if endianness changes
+    serialisation_plan plan;
+    Endianness plan_endianness;
+    // Per field, a matrix sent to it through a hot inlet and not yet output. The record it
+    // triggers is serialised straight from the locked matrix; nullptr otherwise.
+    std::vector<t_symbol *> matrices;
+    // Per field, whether it is kept as the elements last serialised straight from a matrix, and
+    // those bytes, in plan_endianness. The matrix may have moved on by the next record, which
+    // is written from them instead, until the field is loaded again. They are only read into
+    // the storage if the values themselves are needed, for a new byte order.
+    std::vector<bool> keeping;
+    std::vector<std::vector<uint8_t>> kept;
+    // Where each field goes in a record written with no image to index it
+    std::vector<size_t> record_offsets;
+
+    // Scratch reused from bang to bang
+    std::vector<serialisation_plan::strided_source> sources;
+    std::vector<std::pair<t_jit_object *, void *>> locks;
+    std::vector<uint8_t> out_bytes;
+    std::vector<uint8_t> out_chunk;
+    std::vector<t_atom> out_atoms;
 
     t_object *stream;
 };
 
 static void bs_tobytes_handle_data(t_bs_tobytes *x, long index, auto data);
+static void bs_tobytes_build_plan(t_bs_tobytes *x);
 
 BEGIN_USING_C_LINKAGE
 void *bs_tobytes_new(t_symbol *s, long argc, t_atom *argv);
@@ -45,6 +120,10 @@ void bs_tobytes_int(t_bs_tobytes *x, long n);
 void bs_tobytes_float(t_bs_tobytes *x, double f);
 void bs_tobytes_list(t_bs_tobytes *x, t_symbol *s, long argc, t_atom *argv);
 void bs_tobytes_jit_matrix(t_bs_tobytes *x, t_symbol *s, long argc, t_atom *argv);
+void bs_tobytes_tick(t_bs_tobytes *x);
+void bs_tobytes_keyframe(t_bs_tobytes *x);
+t_max_err bs_tobytes_set_deadband(t_bs_tobytes *x, void *attr, long argc, t_atom *argv);
+t_max_err bs_tobytes_set_delta(t_bs_tobytes *x, void *attr, long argc, t_atom *argv);
 
 static t_class *s_bs_tobytes = nullptr;
 
@@ -65,11 +144,26 @@ void ext_main(void *) {
     class_addmethod(c, (method) bs_tobytes_float, "float", A_FLOAT, 0);
     class_addmethod(c, (method) bs_tobytes_list, "list", A_GIMME, 0);
     class_addmethod(c, (method) bs_tobytes_jit_matrix, "jit_matrix", A_GIMME, 0);
+    class_addmethod(c, (method) bs_tobytes_keyframe, "keyframe", 0);
     class_addmethod(c, (method) bs_tobytes_notify, "notify", A_CANT, 0);
 
     CLASS_ATTR_LONG_VARSIZE(c, "triggers", 0, t_bs_tobytes, triggers, num_args, t_bs_tobytes::max_args);
 
     maxutils::create_attr<&t_bs_tobytes::endianness>(c);
+    maxutils::create_attr<&t_bs_tobytes::framing>(c);
+    maxutils::create_attr<&t_bs_tobytes::layout>(c);
+    CLASS_ATTR_ATOM_LONG(c, "chunksize", 0, t_bs_tobytes, chunksize);
+    CLASS_ATTR_FILTER_CLIP(c, "chunksize", 0, std::numeric_limits<short>::max());
+    CLASS_ATTR_ATOM_LONG(c, "coalesce", 0, t_bs_tobytes, coalesce);
+    CLASS_ATTR_FILTER_CLIP(c, "coalesce", 0, 1);
+    CLASS_ATTR_ATOM_LONG(c, "changesonly", 0, t_bs_tobytes, changesonly);
+    CLASS_ATTR_FILTER_CLIP(c, "changesonly", 0, 1);
+    CLASS_ATTR_ATOM_VARSIZE(c, "deadband", 0, t_bs_tobytes, deadband, num_deadbands, t_bs_tobytes::max_args);
+    CLASS_ATTR_ACCESSORS(c, "deadband", nullptr, bs_tobytes_set_deadband);
+    CLASS_ATTR_LONG_VARSIZE(c, "delta", 0, t_bs_tobytes, delta, num_delta, t_bs_tobytes::max_args);
+    CLASS_ATTR_ACCESSORS(c, "delta", nullptr, bs_tobytes_set_delta);
+    CLASS_ATTR_ATOM_LONG(c, "keyinterval", 0, t_bs_tobytes, keyinterval);
+    CLASS_ATTR_FILTER_MIN(c, "keyinterval", 0);
     maxutils::create_attr(c, "stream",
         [](t_bs_tobytes *x) -> t_symbol * {
             t_symbol *name = nullptr;
@@ -111,6 +205,8 @@ void *bs_tobytes_new(t_symbol *, long argc, t_atom *argv) {
     if (!x) {
         return nullptr;
     }
+    // Before anything that can fail, as free() unsets it
+    x->clock = clock_new(x, (method) bs_tobytes_tick);
 
     try {
         std::ranges::transform(args, std::back_inserter(x->storages), [](const t_atom &a) {
@@ -132,20 +228,77 @@ void *bs_tobytes_new(t_symbol *, long argc, t_atom *argv) {
     x->triggers[0] = 0;
     x->num_args = 1;
     x->endianness = t_bs_tobytes::Endianness::Native;
-
-    x->outlet = listout(x);
+    x->framing = t_bs_tobytes::Framing::None;
+    x->layout = t_bs_tobytes::Layout::Interleaved;
+    x->chunksize = 0;
+    x->coalesce = 0;
+    x->dirty = false;
+    x->stream_pending = false;
+    x->tick_scheduled = false;
+    x->changesonly = 0;
+    x->num_deadbands = 0;
+    x->deadbands = {};
+    x->image = {};
+    x->image_valid = false;
+    x->image_endianness = x->endianness;
+    x->image_offsets = {};
+    x->reloaded = std::vector<bool>(x->storages.size(), false);
+    x->sent = {};
+    x->sent_from_matrix = std::vector<bool>(x->storages.size(), false);
+    x->field_bytes = {};
+    x->num_delta = 0;
+    x->delta_sizes = std::vector<size_t>(x->storages.size(), 0);
+    x->delta_records = false;
+    x->encoder = {};
+    x->keyinterval = 30;
+    x->since_keyframe = 0;
+    x->keyframe_due = false;
+
+    x->outlet = outlet_new(x, nullptr);
     x->stream = nullptr;
+    x->plan = {};
+    x->matrices = std::vector<t_symbol *>(x->storages.size(), nullptr);
+    x->keeping = std::vector<bool>(x->storages.size(), false);
+    x->kept = std::vector<std::vector<uint8_t>>(x->storages.size());
+    x->record_offsets = {};
+    x->sources = {};
+    x->locks = {};
+    x->out_bytes = {};
+    x->out_chunk = {};
+    x->out_atoms = {};
     attr_args_process(x, (short)attrs.size(), attrs.data());
+    bs_tobytes_build_plan(x);
     return x;
 }
 
 void bs_tobytes_free(t_bs_tobytes *x) {
+    clock_unset(x->clock);
+    clock_free(x->clock);
     object_free(x->outlet);
     for (auto &p: x->proxies) {
         proxy_delete(p);
     }
     x->proxies.~vector();
     x->storages.~vector();
+    x->plan.~serialisation_plan();
+    x->matrices.~vector();
+    x->keeping.~vector();
+    x->kept.~vector();
+    x->record_offsets.~vector();
+    x->sources.~vector();
+    x->locks.~vector();
+    x->out_bytes.~vector();
+    x->out_chunk.~vector();
+    x->out_atoms.~vector();
+    x->deadbands.~vector();
+    x->image.~vector();
+    x->image_offsets.~vector();
+    x->reloaded.~vector();
+    x->sent.~vector();
+    x->sent_from_matrix.~vector();
+    x->field_bytes.~vector();
+    x->delta_sizes.~vector();
+    x->encoder.~delta_encoder();
     if (x->stream) {
         t_symbol *name;
         object_method(x->stream, sadam::stream_getname, &name);
@@ -168,50 +321,531 @@ void bs_tobytes_assist(t_bs_tobytes *x, void *b, long io, long index, char *s) {
     }
 }
 
+static void bs_tobytes_schedule_tick(t_bs_tobytes *x) {
+    if (!x->tick_scheduled) {
+        x->tick_scheduled = true;
+        clock_delay(x->clock, 0);
+    }
+}
+
+// A hot inlet has changed the record: send it now, or once this tick when coalescing
+static void bs_tobytes_trigger(t_bs_tobytes *x) {
+    if (x->coalesce) {
+        x->dirty = true;
+        bs_tobytes_schedule_tick(x);
+    } else {
+        bs_tobytes_bang(x);
+    }
+}
+
 void bs_tobytes_handle_data(t_bs_tobytes *x, long index, auto data) {
     x->storages[index].load(data);
+    x->matrices[index] = nullptr;
+    x->keeping[index] = false;
+    x->reloaded[index] = true;
 
     char cold = 0;
     bs_tobytes_inletinfo(x, nullptr, index, &cold);
     if (!cold) {
-        bs_tobytes_bang(x);
+        bs_tobytes_trigger(x);
     }
 }
 
-void bs_tobytes_bang(t_bs_tobytes *x) {
-    std::vector<uint8_t> out_bytes;
+// Lays the storages out once for the current endianness, so that serialising is a loop of
+// copies with no per-field dispatch
+void bs_tobytes_build_plan(t_bs_tobytes *x) {
+    bool swap = false;
     switch (x->endianness) {
-        case t_bs_tobytes::Endianness::Big: {
-            zpp::bits::out{out_bytes, zpp::bits::endian::big{}}(zpp::bits::unsized(x->storages)).or_throw();
+        case t_bs_tobytes::Endianness::Big:
+        case t_bs_tobytes::Endianness::Network:
+            swap = std::endian::native != std::endian::big;
             break;
-        }
-        case t_bs_tobytes::Endianness::Little: {
-            zpp::bits::out{out_bytes, zpp::bits::endian::little{}}(zpp::bits::unsized(x->storages)).or_throw();
+        case t_bs_tobytes::Endianness::Little:
+            swap = std::endian::native != std::endian::little;
             break;
-        }
-        case t_bs_tobytes::Endianness::Network: {
-            zpp::bits::out{out_bytes, zpp::bits::endian::network{}}(zpp::bits::unsized(x->storages)).or_throw();
+        case t_bs_tobytes::Endianness::Native:
             break;
+    }
+    // Fields kept as bytes hold them in the old byte order, so they are read back into their
+    // storages with the old plan first
+    for (size_t i = 0; i < x->keeping.size(); ++i) {
+        if (x->keeping[i]) {
+            x->plan.read_elements(i, x->kept[i]);
+            x->keeping[i] = false;
         }
-        case t_bs_tobytes::Endianness::Native: {
-            zpp::bits::out{out_bytes}(zpp::bits::unsized(x->storages)).or_throw();
-            break;
+    }
+    x->plan = serialisation_plan(swap);
+    for (auto &s: x->storages) {
+        s.add_to(x->plan);
+    }
+    x->plan_endianness = x->endianness;
+    // Records in the old byte order can't be compared with the new, so the next is a keyframe
+    x->encoder = delta_encoder(x->delta_sizes, (std::endian::native == std::endian::big) != swap);
+}
+
+static void bs_tobytes_index_image(t_bs_tobytes *x);
+
+// Serialises the record into image, unless changesonly already has, and encodes it against the
+// last one sent
+static void bs_tobytes_serialise_delta(t_bs_tobytes *x, auto &out_bytes) {
+    if (!x->changesonly) {
+        x->plan.write(x->image, x->sources);
+        bs_tobytes_index_image(x);
+    }
+    const bool keyframe = x->keyframe_due || (x->keyinterval && x->since_keyframe >= x->keyinterval);
+    if (x->encoder.encode(x->image, x->image_offsets, keyframe, out_bytes)) {
+        x->since_keyframe = 0;
+    } else {
+        ++x->since_keyframe;
+    }
+    x->keyframe_due = false;
+}
+
+static void bs_tobytes_serialise(t_bs_tobytes *x, auto &out_bytes) {
+    if (x->delta_records) {
+        bs_tobytes_serialise_delta(x, out_bytes);
+        return;
+    }
+    if (x->changesonly) {
+        out_bytes.resize(x->image.size());
+        std::ranges::copy(x->image, reinterpret_cast<uint8_t *>(out_bytes.data()));
+        return;
+    }
+    x->plan.write(out_bytes, x->sources);
+}
+
+// Finds where each field goes in the record, with the end of the last at the back
+static void bs_tobytes_index_fields(t_bs_tobytes *x, std::vector<size_t> &offsets) {
+    offsets.resize(x->storages.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < x->storages.size(); ++i) {
+        offsets[i + 1] = offsets[i] + x->plan.field_size(i, x->sources);
+    }
+}
+
+static void bs_tobytes_index_image(t_bs_tobytes *x) {
+    bs_tobytes_index_fields(x, x->image_offsets);
+}
+
+// Keeps the elements of the fields following matrices from the part of the record in bytes,
+// which starts offset bytes into it, to write later records from once the matrices are
+// unlocked. Called for each part of a record in turn, or once with the whole of it.
+static void bs_tobytes_keep_matrices(t_bs_tobytes *x, std::span<const uint8_t> bytes, size_t offset,
+                                     const std::vector<size_t> &offsets) {
+    for (size_t i = 0; i < x->matrices.size(); ++i) {
+        if (!x->matrices[i]) {
+            continue;
+        }
+        const size_t from = std::max(offsets[i] + x->plan.prefix_size(i), offset);
+        const size_t to = std::min(offsets[i + 1], offset + bytes.size());
+        if (from < to) {
+            const auto part = bytes.subspan(from - offset, to - from);
+            x->kept[i].insert(x->kept[i].end(), part.begin(), part.end());
+        }
+    }
+}
+
+// Keeps the matrices' elements from the record just written, before any framing: image, with
+// changesonly or delta records, or record
+static void bs_tobytes_keep_written(t_bs_tobytes *x, std::span<const uint8_t> record) {
+    if (x->locks.empty()) {
+        return;
+    }
+    if (x->changesonly || x->delta_records) {
+        bs_tobytes_keep_matrices(x, x->image, 0, x->image_offsets);
+        return;
+    }
+    bs_tobytes_index_fields(x, x->record_offsets);
+    bs_tobytes_keep_matrices(x, record, 0, x->record_offsets);
+}
+
+// Brings image up to date with the fields, returning whether anything in it changed. Fields
+// loaded since the last bang are compared with what image holds, within their deadbands, and
+// patched in place if they changed; matrix fields have their bytes compared instead. Anything
+// that changes a field's size has the whole image written again.
+static bool bs_tobytes_update_image(t_bs_tobytes *x) {
+    const size_t fields = x->storages.size();
+    bool rewrite = !x->image_valid || x->image_endianness != x->plan_endianness;
+    bool changed = rewrite;
+
+    for (size_t i = 0; i < fields && !rewrite; ++i) {
+        // A bit field's bytes are its whole group's, which are indexed under its first field
+        const size_t group = x->plan.group_of(i);
+        const size_t old_size = x->image_offsets[group + 1] - x->image_offsets[group];
+        if (x->matrices[i]) {
+            x->field_bytes.resize(x->plan.field_size(group, x->sources));
+            x->plan.write_field(group, x->field_bytes.data(), x->sources);
+            x->sent_from_matrix[i] = true;
+            if (x->field_bytes.size() != old_size) {
+                rewrite = true;
+            } else if (!std::ranges::equal(x->field_bytes, std::span(x->image).subspan(x->image_offsets[group], old_size))) {
+                std::ranges::copy(x->field_bytes, x->image.begin() + static_cast<ptrdiff_t>(x->image_offsets[group]));
+                changed = true;
+            }
+            continue;
+        }
+        if (!x->reloaded[i]) {
+            continue;
+        }
+        x->reloaded[i] = false;
+        const ::deadband band = i < x->deadbands.size() ? x->deadbands[i] : ::deadband{};
+        if (!x->sent_from_matrix[i] && !x->storages[i].differs(x->sent[i], band)) {
+            continue;
+        }
+        x->sent[i] = x->storages[i];
+        x->sent_from_matrix[i] = false;
+        changed = true;
+        if (x->plan.field_size(group, x->sources) != old_size) {
+            rewrite = true;
+        } else {
+            x->plan.write_field(group, x->image.data() + x->image_offsets[group], x->sources);
+        }
+    }
+
+    if (rewrite) {
+        x->plan.write(x->image, x->sources);
+        bs_tobytes_index_image(x);
+        x->sent = x->storages;
+        for (size_t i = 0; i < fields; ++i) {
+            x->reloaded[i] = false;
+            x->sent_from_matrix[i] = x->matrices[i] != nullptr || x->keeping[i];
+        }
+        x->image_valid = true;
+        x->image_endianness = x->plan_endianness;
+        return true;
+    }
+    return changed;
+}
+
+// Parses one deadband per field: a number is an absolute amount, and a symbol such as 5% a
+// fraction of the value last sent
+t_max_err bs_tobytes_set_deadband(t_bs_tobytes *x, void *, long argc, t_atom *argv) {
+    argc = std::min<long>(argc, t_bs_tobytes::max_args);
+    std::vector<::deadband> parsed;
+    for (const t_atom &a : std::span(argv, static_cast<size_t>(argc))) {
+        ::deadband band;
+        if (atom_gettype(&a) == A_LONG || atom_gettype(&a) == A_FLOAT) {
+            band.amount = atom_getfloat(&a);
+        } else if (atom_gettype(&a) == A_SYM) {
+            const char *text = atom_getsym(&a)->s_name;
+            char *end = nullptr;
+            band.amount = std::strtod(text, &end) / 100;
+            band.relative = true;
+            if (end == text || std::strcmp(end, "%") != 0) {
+                object_error((t_object *)x, "deadband: expected numbers or percentages such as 5%%");
+                return MAX_ERR_GENERIC;
+            }
+        }
+        if (!(band.amount >= 0)) {
+            object_error((t_object *)x, "deadband: deadbands can't be negative");
+            return MAX_ERR_GENERIC;
+        }
+        parsed.push_back(band);
+    }
+
+    std::copy(argv, argv + argc, x->deadband);
+    x->num_deadbands = argc;
+    x->deadbands = std::move(parsed);
+    return MAX_ERR_NONE;
+}
+
+// Turns delta on or off field by field. Fields are compared an element at a time, so varint and
+// bit fields, whose elements take no fixed number of bytes, can't have it.
+t_max_err bs_tobytes_set_delta(t_bs_tobytes *x, void *, long argc, t_atom *argv) {
+    argc = std::min<long>(argc, t_bs_tobytes::max_args);
+    std::vector<size_t> sizes(x->storages.size(), 0);
+    for (size_t i = 0; i < static_cast<size_t>(argc) && i < sizes.size(); ++i) {
+        if (!atom_getlong(argv + i)) {
+            continue;
+        }
+        const type_info info = x->storages[i].info();
+        sizes[i] = info.element_bytes();
+        if (!sizes[i]) {
+            object_error((t_object *)x, "delta: field %ld is %s, whose elements can't be compared",
+                         static_cast<long>(i), info.to_string().c_str());
+            return MAX_ERR_GENERIC;
+        }
+    }
+
+    for (long i = 0; i < argc; ++i) {
+        x->delta[i] = atom_getlong(argv + i) ? 1 : 0;
+    }
+    x->num_delta = argc;
+    x->delta_sizes = std::move(sizes);
+    x->delta_records = std::ranges::any_of(x->delta_sizes, [](size_t size) { return size != 0; });
+    bs_tobytes_build_plan(x);
+    return MAX_ERR_NONE;
+}
+
+// Locks the matrices fields follow and points the plan at their data, so they are serialised
+// in one pass with no copy into the storages. A matrix that has gone, or whose elements aren't
+// already the field's type and size, is loaded into its field instead and no longer followed.
+// Fields kept as the bytes of an earlier matrix are written from those.
+static void bs_tobytes_lock_matrices(t_bs_tobytes *x) {
+    x->sources.clear();
+    for (size_t i = 0; i < x->matrices.size(); ++i) {
+        t_symbol *name = x->matrices[i];
+        if (!name) {
+            continue;
+        }
+        auto *matrix = (t_jit_object *)jit_object_findregistered(name);
+        if (!matrix) {
+            object_error((t_object *)x, "Couldn't find matrix %s", name->s_name);
+            x->matrices[i] = nullptr;
+            continue;
+        }
+
+        x->locks.emplace_back(matrix, jit_object_method(matrix, _jit_sym_lock, 1));
+        t_jit_matrix_info matrix_info;
+        jit_object_method(matrix, _jit_sym_getinfo, &matrix_info);
+        char *data = nullptr;
+        jit_object_method(matrix, _jit_sym_getdata, &data);
+
+        const bool planar = x->layout == t_bs_tobytes::Layout::Planar;
+        if (auto source = x->storages[i].matrix_source(i, matrix_info, data, planar)) {
+            x->sources.push_back(*source);
+            x->keeping[i] = false;
+            x->kept[i].clear();
+        } else {
+            x->matrices[i] = nullptr;
+            x->keeping[i] = false;
+            x->reloaded[i] = true;
+            try {
+                x->storages[i].load(matrix, planar);
+            } catch (const std::exception &e) {
+                object_error((t_object *)x, e.what());
+            }
+        }
+    }
+
+    for (size_t i = 0; i < x->keeping.size(); ++i) {
+        if (!x->keeping[i]) {
+            continue;
+        }
+        const size_t element_size = x->storages[i].info().element_bytes();
+        strided_source source;
+        source.field = i;
+        source.data = x->kept[i].data();
+        source.bytes = x->kept[i].size();
+        source.dim[0] = x->kept[i].size() / element_size;
+        source.stride[0] = static_cast<ptrdiff_t>(element_size);
+        source.serialised = true;
+        x->sources.push_back(source);
+    }
+}
+
+// Stops following the matrices just serialised. Once written, their fields are kept as the
+// bytes written; if the record failed, the matrices are loaded into their fields instead, while
+// they still hold what was to be sent.
+static void bs_tobytes_unlock_matrices(t_bs_tobytes *x, bool written) {
+    const bool planar = x->layout == t_bs_tobytes::Layout::Planar;
+    for (size_t i = 0; i < x->matrices.size(); ++i) {
+        t_symbol *name = std::exchange(x->matrices[i], nullptr);
+        if (!name) {
+            continue;
+        }
+        if (written) {
+            x->keeping[i] = true;
+            continue;
+        }
+        try {
+            x->storages[i].load((t_jit_object *)jit_object_findregistered(name), planar);
+        } catch (const std::exception &e) {
+            object_error((t_object *)x, e.what());
         }
     }
+    for (auto [matrix, lock] : std::views::reverse(x->locks)) {
+        jit_object_method(matrix, _jit_sym_lock, lock);
+    }
+    x->locks.clear();
+    x->sources.clear();
+}
+
+static void bs_tobytes_send_list(t_bs_tobytes *x, std::span<const uint8_t> bytes) {
+    auto &out_atoms = x->out_atoms;
+    out_atoms.clear();
+    std::ranges::transform(bytes, std::back_inserter(out_atoms), [](const uint8_t b) -> t_atom {
+        return { .a_type = A_LONG, .a_w.w_long = b };
+    });
+    outlet_list(x->outlet, nullptr, static_cast<short>(out_atoms.size()), out_atoms.data());
+}
 
+// Sends bytes a chunk at a time: lists between begin and end, or additions to the stream that
+// it is only cleared after
+static void bs_tobytes_send_chunk(t_bs_tobytes *x, std::span<const uint8_t> chunk) {
     if (x->stream) {
-        object_method(x->stream, sadam::stream_addarray, &out_bytes);
+        x->out_chunk.assign(chunk.begin(), chunk.end());
+        object_method(x->stream, sadam::stream_addarray, &x->out_chunk);
+    } else {
+        bs_tobytes_send_list(x, chunk);
+    }
+}
+
+// Ends a record added to the stream, or when coalescing leaves that to the end of the tick so
+// listeners get all of the tick's records at once
+static void bs_tobytes_clear_stream(t_bs_tobytes *x) {
+    if (x->coalesce) {
+        x->stream_pending = true;
+        bs_tobytes_schedule_tick(x);
+    } else {
         object_method(x->stream, sadam::stream_clear);
+    }
+}
+
+static void bs_tobytes_send_begin(t_bs_tobytes *x, size_t total) {
+    if (!x->stream) {
+        t_atom length;
+        atom_setlong(&length, static_cast<t_atom_long>(total));
+        outlet_anything(x->outlet, gensym("begin"), 1, &length);
+    }
+}
+
+static void bs_tobytes_send_end(t_bs_tobytes *x) {
+    if (x->stream) {
+        bs_tobytes_clear_stream(x);
     } else {
-        std::vector<t_atom> out_atoms;
-        out_atoms.reserve(out_bytes.size());
-        std::ranges::transform(out_bytes, std::back_inserter(out_atoms), [](const uint8_t b) -> t_atom {
-            return { .a_type = A_LONG, .a_w.w_long = b };
-        });
-        if (out_atoms.size() > std::numeric_limits<short>::max()) {
-            object_warn((t_object *) x, "Output list too long");
+        outlet_anything(x->outlet, gensym("end"), 0, nullptr);
+    }
+}
+
+// Serialises the record straight into chunks and sends each as it fills, so however large its
+// matrices only one chunk of it is ever held
+static void bs_tobytes_serialise_chunked(t_bs_tobytes *x) {
+    const size_t total = x->plan.size(x->sources);
+    x->out_bytes.resize(static_cast<size_t>(x->chunksize));
+
+    if (!x->locks.empty()) {
+        bs_tobytes_index_fields(x, x->record_offsets);
+    }
+
+    // write_chunked throws before its first chunk if at all, so begin waits for that
+    bool begun = false;
+    size_t sent = 0;
+    x->plan.write_chunked(x->out_bytes, [x, total, &begun, &sent](std::span<const uint8_t> chunk) {
+        if (!begun) {
+            bs_tobytes_send_begin(x, total);
+            begun = true;
+        }
+        if (!x->locks.empty()) {
+            bs_tobytes_keep_matrices(x, chunk, sent, x->record_offsets);
+        }
+        sent += chunk.size();
+        bs_tobytes_send_chunk(x, chunk);
+    }, x->sources);
+    if (!begun) {
+        bs_tobytes_send_begin(x, total);
+    }
+    bs_tobytes_send_end(x);
+}
+
+void bs_tobytes_bang(t_bs_tobytes *x) {
+    // With framing on, the record is serialised straight into the buffer it is framed in. Either
+    // way the buffer is the previous bang's, so a record that has stopped growing is written
+    // without allocating. Unframed chunked records never exist whole; a frame has to, to be
+    // encoded, and is then sent in chunks, as are a delta record and the image a changesonly
+    // record is kept in.
+    const auto chunksize = static_cast<size_t>(x->chunksize);
+    x->dirty = false;
+    // The byte order is settled before anything is locked, as a new one reads the fields kept
+    // as bytes back into their storages
+    if (x->plan_endianness != x->endianness) {
+        bs_tobytes_build_plan(x);
+    }
+    bs_tobytes_lock_matrices(x);
+    try {
+        if (!x->changesonly) {
+            x->image_valid = false;
+        } else {
+            const bool changed = bs_tobytes_update_image(x);
+            bs_tobytes_keep_written(x, x->image);
+            if (!changed && !x->keyframe_due) {
+                bs_tobytes_unlock_matrices(x, true);
+                return;
+            }
+        }
+
+        switch (x->framing) {
+            case t_bs_tobytes::Framing::None: {
+                if (chunksize && !x->changesonly && !x->delta_records) {
+                    bs_tobytes_serialise_chunked(x);
+                } else {
+                    bs_tobytes_serialise(x, x->out_bytes);
+                    if (!x->changesonly) {
+                        bs_tobytes_keep_written(x, x->out_bytes);
+                    }
+                }
+                break;
+            }
+            case t_bs_tobytes::Framing::COBS: {
+                framed_writer<cobs_framing> writer(std::move(x->out_bytes));
+                bs_tobytes_serialise(x, writer);
+                if (!x->changesonly) {
+                    bs_tobytes_keep_written(x, std::span(writer.data(), writer.size()));
+                }
+                x->out_bytes = writer.finish();
+                break;
+            }
+            case t_bs_tobytes::Framing::SLIP: {
+                framed_writer<slip_framing> writer(std::move(x->out_bytes));
+                bs_tobytes_serialise(x, writer);
+                if (!x->changesonly) {
+                    bs_tobytes_keep_written(x, std::span(writer.data(), writer.size()));
+                }
+                x->out_bytes = writer.finish();
+                break;
+            }
+        }
+    } catch (const std::exception &e) {
+        bs_tobytes_unlock_matrices(x, false);
+        object_error((t_object *)x, e.what());
+        return;
+    }
+    bs_tobytes_unlock_matrices(x, true);
+
+    if (chunksize) {
+        if (x->framing != t_bs_tobytes::Framing::None || x->changesonly || x->delta_records) {
+            const std::span<const uint8_t> frame(x->out_bytes);
+            bs_tobytes_send_begin(x, frame.size());
+            for (size_t offset = 0; offset < frame.size(); offset += chunksize) {
+                bs_tobytes_send_chunk(x, frame.subspan(offset, std::min(chunksize, frame.size() - offset)));
+            }
+            bs_tobytes_send_end(x);
+        }
+        return;
+    }
+
+    auto &out_bytes = x->out_bytes;
+    if (x->stream) {
+        object_method(x->stream, sadam::stream_addarray, &out_bytes);
+        bs_tobytes_clear_stream(x);
+    } else if (out_bytes.size() > static_cast<size_t>(std::numeric_limits<short>::max())) {
+        object_error((t_object *) x, "Output of %ld bytes is too long for a list, set chunksize to send it in parts",
+                     static_cast<long>(out_bytes.size()));
+    } else {
+        bs_tobytes_send_list(x, out_bytes);
+    }
+}
+
+// The end of a tick in which the record changed, or a record was added to the stream. The clock
+// counts as set until the end, so sending here doesn't set it again.
+void bs_tobytes_tick(t_bs_tobytes *x) {
+    if (x->dirty) {
+        bs_tobytes_bang(x);
+    }
+    if (x->stream_pending) {
+        x->stream_pending = false;
+        if (x->stream) {
+            object_method(x->stream, sadam::stream_clear);
         }
-        outlet_list(x->outlet, nullptr, static_cast<short>(out_atoms.size()), out_atoms.data());
+    }
+    x->tick_scheduled = false;
+}
+
+// Sends every field whole in the next record, at once unless coalescing
+void bs_tobytes_keyframe(t_bs_tobytes *x) {
+    if (x->delta_records) {
+        x->keyframe_due = true;
+        bs_tobytes_trigger(x);
     }
 }
 
@@ -251,10 +885,27 @@ void bs_tobytes_jit_matrix(t_bs_tobytes *x, t_symbol *s, long argc, t_atom *argv
     t_symbol *name = atom_getsym(argv);
     t_jit_object *matrix = (t_jit_object *)jit_object_findregistered(name);
     if (matrix) {
+        const long index = proxy_getinlet((t_object *)x);
+        char cold = 0;
+        bs_tobytes_inletinfo(x, nullptr, index, &cold);
+        // Output now, so the matrix can be read in place rather than copied first. Coalesced
+        // output comes at the end of the tick, by when the matrix may have changed.
+        if (!cold && !x->coalesce) {
+            x->matrices[index] = name;
+            bs_tobytes_trigger(x);
+            return;
+        }
         try {
-            bs_tobytes_handle_data(x, proxy_getinlet((t_object *)x ), matrix);
+            x->storages[index].load(matrix, x->layout == t_bs_tobytes::Layout::Planar);
+            x->matrices[index] = nullptr;
+            x->keeping[index] = false;
+            x->reloaded[index] = true;
         } catch (const std::exception &e) {
             object_error((t_object *)x, e.what());
+            return;
+        }
+        if (!cold) {
+            bs_tobytes_trigger(x);
         }
     }
     else {
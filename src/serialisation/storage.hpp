@@ -6,8 +6,88 @@
 #define STORAGE_HPP
 
 #include "type_info.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <string>
 #include <vector>
-#include "maxutils/jit_matrix_view_v2.hpp"
+#include "bytestream/packed_float.hpp"
+#include "bytestream/serialisation_plan.hpp"
+#include "bytestream/strided_copy.hpp"
+#include "jit.common.h"
+#include "atom_views.hpp"
+
+// The jit matrix type whose elements are laid out as T, or nullptr if there is none
+template <typename T>
+t_symbol *jit_matrix_type() {
+    if constexpr (std::is_same_v<T, uint8_t> || std::is_same_v<T, int8_t>) {
+        return _jit_sym_char;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        return _jit_sym_long;
+    } else if constexpr (std::is_same_v<T, float>) {
+        return _jit_sym_float32;
+    } else if constexpr (std::is_same_v<T, double>) {
+        return _jit_sym_float64;
+    } else {
+        return nullptr;
+    }
+}
+
+// Elements kept in their wire form, packed from numbers as they are loaded and unpacked as they
+// are output, so that serialising them is a plain copy
+struct half_element {
+    uint16_t bits;
+};
+
+template <typename Raw>
+struct fixed_element {
+    Raw raw;
+};
+
+template <typename T>
+inline constexpr bool is_packed_element = false;
+template <>
+inline constexpr bool is_packed_element<half_element> = true;
+template <typename Raw>
+inline constexpr bool is_packed_element<fixed_element<Raw>> = true;
+
+// How far a float field's elements may move before the field counts as changed: an absolute
+// amount, or a fraction of the value it is compared with. Other fields change on any difference.
+struct deadband {
+    double amount{0};
+    bool relative{false};
+};
+
+// Bytes in an element of a jit matrix type, or 0 for a type that isn't supported
+inline size_t jit_matrix_element_size(t_symbol *type) {
+    if (type == _jit_sym_char) {
+        return 1;
+    } else if (type == _jit_sym_long || type == _jit_sym_float32) {
+        return 4;
+    } else if (type == _jit_sym_float64) {
+        return 8;
+    }
+    return 0;
+}
+
+// The cells of a locked matrix, every dimension and plane, to copy out interleaved or planar
+inline strided_source jit_matrix_source(const t_jit_matrix_info &matrix_info, const char *matrix_data, bool planar) {
+    if (matrix_info.dimcount < 1 || matrix_info.dimcount > static_cast<long>(strided_source::max_dims)) {
+        throw std::runtime_error("Matrix must have 1 to 32 dimensions");
+    }
+    strided_source source;
+    source.data = reinterpret_cast<const uint8_t *>(matrix_data);
+    source.bytes = matrix_data ? static_cast<size_t>(std::max(matrix_info.size, 0L)) : 0;
+    source.dimcount = static_cast<size_t>(matrix_info.dimcount);
+    for (size_t d = 0; d < source.dimcount; ++d) {
+        source.dim[d] = static_cast<size_t>(std::max(matrix_info.dim[d], 0L));
+        source.stride[d] = matrix_info.dimstride[d];
+    }
+    source.planes = static_cast<size_t>(std::max(matrix_info.planecount, 0L));
+    source.planar = planar;
+    return source;
+}
 
 template <typename T>
 struct atom_storage {
@@ -30,17 +110,43 @@ struct atom_storage {
         if (info.is_variable_length()) {
             data.resize(1);
         }
-        data[0] = value;
+        if constexpr (is_packed_element<T>) {
+            const auto number = static_cast<float>(value);
+            pack(0, &number, 1);
+        } else if constexpr (std::is_integral_v<T>) {
+            const auto range = bit_range();
+            data[0] = range ? saturate(value, *range) : static_cast<T>(value);
+        } else {
+            data[0] = value;
+        }
     }
 
     void load(std::span<const t_atom> values) {
-        constexpr static auto from_atom = [](const t_atom &atom) {
+        if constexpr (is_packed_element<T>) {
+            if (info.is_variable_length()) {
+                data.resize(values.size());
+            }
+            const size_t count = std::min(values.size(), data.size());
+            float batch[batch_size];
+            for (size_t done = 0; done < count; done += batch_size) {
+                const size_t n = std::min(batch_size, count - done);
+                for (size_t i = 0; i < n; ++i) {
+                    batch[i] = static_cast<float>(atom_getfloat(&values[done + i]));
+                }
+                pack(done, batch, n);
+            }
+            return;
+        }
+
+        const auto range = bit_range();
+        const auto from_atom = [&](const t_atom &atom) {
             if constexpr (std::is_integral_v<T>) {
-                return static_cast<T>(atom_getlong(&atom));
+                return range ? saturate(atom_getlong(&atom), *range) : static_cast<T>(atom_getlong(&atom));
             } else if constexpr (std::is_floating_point_v<T>) {
                 return static_cast<T>(atom_getfloat(&atom));
             } else {
-                static_assert(sizeof(T) == 0, "Unsupported type");
+                static_assert(is_packed_element<T>, "Unsupported type");
+                return T{};
             }
         };
 
@@ -53,35 +159,79 @@ struct atom_storage {
         }
     }
 
-    void load(t_jit_object *matrix) {
-        t_jit_matrix_info matrix_info;
-        jit_object_method(matrix, _jit_sym_getinfo, &matrix_info);
-        if (matrix_info.dimcount > 2) {
-            throw std::runtime_error("more than 2d matrices not supported");
+    // Copies the matrix into this field, cells interleaved as in memory or planar, converting
+    // its elements to T. A variable field takes the matrix's size; a fixed one must be at least
+    // as large, and keeps its elements past the matrix's.
+    void load(t_jit_object *matrix, bool planar) {
+        void *lock = jit_object_method(matrix, _jit_sym_lock, 1);
+        try {
+            load_locked(matrix, planar);
+        } catch (...) {
+            jit_object_method(matrix, _jit_sym_lock, lock);
+            throw;
         }
+        jit_object_method(matrix, _jit_sym_lock, lock);
+    }
 
+    // A locked matrix's data as a plan source for this field, if its elements are already of
+    // this type and fill the field exactly, and aren't re-encoded as varints or bit packed;
+    // otherwise it has to be load()ed and converted.
+    std::optional<strided_source> matrix_source(size_t field, const t_jit_matrix_info &matrix_info,
+                                                const char *matrix_data, bool planar) const {
+        if (!matrix_data || matrix_info.type != jit_matrix_type<T>() || info.is_varint() || info.is_bit_field()) {
+            return std::nullopt;
+        }
+        strided_source source = jit_matrix_source(matrix_info, matrix_data, planar);
+        source.field = field;
+        if (!info.is_variable_length() && source.count() != data.size()) {
+            return std::nullopt;
+        }
+        return source;
+    }
 
-        auto copy = [this]<typename U>(maxutils::matrix_view<U> m) {
-            if (info.is_variable_length()) {
-                data.resize(m.nrows() * m.ncols());
+    // Whether this field differs from previous, a copy of it from earlier, by more than band
+    [[nodiscard]] bool differs(const atom_storage &previous, const deadband &band) const {
+        if (data.size() != previous.data.size()) {
+            return true;
+        }
+        if (data.empty()) {
+            return false;
+        }
+        if constexpr (std::is_floating_point_v<T> || is_packed_element<T>) {
+            if (band.amount > 0) {
+                for (size_t i = 0; i < data.size(); ++i) {
+                    if (std::memcmp(&data[i], &previous.data[i], sizeof(T)) == 0) {
+                        continue;
+                    }
+                    const double was = previous.number_at(i);
+                    const double limit = band.relative ? band.amount * std::abs(was) : band.amount;
+                    if (!(std::abs(number_at(i) - was) <= limit)) {
+                        return true;
+                    }
+                }
+                return false;
             }
+        }
+        return std::memcmp(data.data(), previous.data.data(), data.size() * sizeof(T)) != 0;
+    }
 
-            for (size_t row_index = 0; row_index < m.nrows(); ++row_index) {
-                std::span row_span = m.row(row_index).as_1d_span();
-                auto data_start = data.begin() + row_index * row_span.size();
-                std::copy(row_span.begin(), row_span.end(), data_start);
+    template <typename OutIt>
+    OutIt store_to_atoms(OutIt out) const {
+        if constexpr (is_packed_element<T>) {
+            float batch[batch_size];
+            for (size_t done = 0; done < data.size(); done += batch_size) {
+                const size_t n = std::min(batch_size, data.size() - done);
+                unpack(batch, done, n);
+                for (size_t i = 0; i < n; ++i) {
+                    *out++ = atom_from(static_cast<double>(batch[i]));
+                }
+            }
+        } else {
+            for (const auto &value : data) {
+                *out++ = atom_from(value);
             }
-        };
-
-        if (matrix_info.type == _jit_sym_char) {
-            copy(maxutils::matrix_view<char>(matrix));
-        } else if (matrix_info.type == _jit_sym_long) {
-            copy(maxutils::matrix_view<int32_t>(matrix));
-        } else if (matrix_info.type == _jit_sym_float32) {
-            copy(maxutils::matrix_view<float>(matrix));
-        } else if (matrix_info.type == _jit_sym_float64) {
-            copy(maxutils::matrix_view<double>(matrix));
         }
+        return out;
     }
 
     constexpr static auto serialize(auto &archive, atom_storage &self) {
@@ -91,6 +241,159 @@ struct atom_storage {
             return archive(zpp::bits::unsized(self.data));
         }
     }
+
+private:
+    // Packed elements are converted to and from floats this many at a time
+    static constexpr size_t batch_size = 64;
+
+    // The values a bit field can hold; numbers loaded into it saturate to them
+    struct value_range {
+        int64_t lowest;
+        int64_t highest;
+    };
+
+    [[nodiscard]] std::optional<value_range> bit_range() const {
+        if (!info.is_bit_field()) {
+            return std::nullopt;
+        }
+        const unsigned width = info.bit_width();
+        if (info.is_signed_bit_field()) {
+            return value_range{-(int64_t{1} << (width - 1)), (int64_t{1} << (width - 1)) - 1};
+        }
+        return value_range{0, (int64_t{1} << width) - 1};
+    }
+
+    template <typename U>
+    [[nodiscard]] static T saturate(U value, const value_range &range) {
+        if constexpr (std::is_floating_point_v<U>) {
+            const auto number = static_cast<double>(value);
+            if (!(number >= static_cast<double>(range.lowest))) {
+                return static_cast<T>(range.lowest);
+            }
+            return static_cast<T>(std::min(number, static_cast<double>(range.highest)));
+        } else {
+            return static_cast<T>(std::clamp(static_cast<int64_t>(value), range.lowest, range.highest));
+        }
+    }
+
+    // Wire units per unit of a fixed point field's values
+    [[nodiscard]] float fixed_point_factor() const {
+        return static_cast<float>(std::ldexp(1.0, info.fraction_bits()) / info.scale);
+    }
+
+    // count numbers into packed elements from offset on
+    void pack(size_t offset, const float *numbers, size_t count) {
+        auto *dst = reinterpret_cast<uint8_t *>(data.data() + offset);
+        if constexpr (std::is_same_v<T, half_element>) {
+            bytestream::detail::floats_to_halves(dst, numbers, count);
+        } else {
+            bytestream::detail::floats_to_fixed<decltype(T::raw)>(dst, numbers, count, fixed_point_factor());
+        }
+    }
+
+    void unpack(float *numbers, size_t offset, size_t count) const {
+        const auto *src = reinterpret_cast<const uint8_t *>(data.data() + offset);
+        if constexpr (std::is_same_v<T, half_element>) {
+            bytestream::detail::halves_to_floats(numbers, src, count);
+        } else {
+            bytestream::detail::fixed_to_floats<decltype(T::raw)>(numbers, src, count, 1 / fixed_point_factor());
+        }
+    }
+
+    [[nodiscard]] double number_at(size_t i) const {
+        if constexpr (is_packed_element<T>) {
+            float number;
+            unpack(&number, i, 1);
+            return number;
+        } else {
+            return static_cast<double>(data[i]);
+        }
+    }
+
+    void load_locked(t_jit_object *matrix, bool planar) {
+        t_jit_matrix_info matrix_info;
+        jit_object_method(matrix, _jit_sym_getinfo, &matrix_info);
+        char *matrix_data = nullptr;
+        jit_object_method(matrix, _jit_sym_getdata, &matrix_data);
+
+        const size_t element_size = jit_matrix_element_size(matrix_info.type);
+        if (!element_size) {
+            throw std::runtime_error("Unsupported matrix type");
+        }
+        const strided_source source = jit_matrix_source(matrix_info, matrix_data, planar);
+        source.check(element_size);
+
+        const size_t count = source.count();
+        if (info.is_variable_length()) {
+            data.resize(count);
+        } else if (count > data.size()) {
+            throw std::runtime_error("Matrix of " + std::to_string(count) + " elements doesn't fit a field of "
+                                     + std::to_string(data.size()));
+        }
+
+        const auto range = bit_range();
+        if (matrix_info.type == jit_matrix_type<T>() && !range) {
+            copy_strided(reinterpret_cast<uint8_t *>(data.data()), source, sizeof(T),
+                         bytestream::detail::copy_elements<sizeof(T), false>,
+                         bytestream::detail::deinterleave_elements<sizeof(T), false>);
+            return;
+        }
+
+        const auto convert = [&]<typename U>() {
+            const size_t cells = source.cells();
+            const bool split = source.planar && source.planes > 1;
+            size_t cell = 0;
+            if constexpr (is_packed_element<T>) {
+                // A run at a time as numbers, then packed, each plane on its own if split
+                std::vector<float> numbers(source.dim[0] * source.planes);
+                bytestream::detail::for_each_run(source, [&](const uint8_t *run) {
+                    for (size_t i = 0; i < source.dim[0]; ++i) {
+                        const uint8_t *elements = run + static_cast<ptrdiff_t>(i) * source.stride[0];
+                        for (size_t p = 0; p < source.planes; ++p) {
+                            U value;
+                            std::memcpy(&value, elements + p * sizeof(U), sizeof(U));
+                            numbers[split ? p * source.dim[0] + i : i * source.planes + p] = static_cast<float>(value);
+                        }
+                    }
+                    if (split) {
+                        for (size_t p = 0; p < source.planes; ++p) {
+                            pack(p * cells + cell, numbers.data() + p * source.dim[0], source.dim[0]);
+                        }
+                    } else {
+                        pack(cell * source.planes, numbers.data(), numbers.size());
+                    }
+                    cell += source.dim[0];
+                });
+                return;
+            }
+            bytestream::detail::for_each_run(source, [&](const uint8_t *run) {
+                for (size_t i = 0; i < source.dim[0]; ++i, ++cell) {
+                    const uint8_t *elements = run + static_cast<ptrdiff_t>(i) * source.stride[0];
+                    for (size_t p = 0; p < source.planes; ++p) {
+                        U value;
+                        std::memcpy(&value, elements + p * sizeof(U), sizeof(U));
+                        T element;
+                        if constexpr (std::is_integral_v<T>) {
+                            element = range ? saturate(value, *range) : static_cast<T>(value);
+                        } else {
+                            element = static_cast<T>(value);
+                        }
+                        data[split ? p * cells + cell : cell * source.planes + p] = element;
+                    }
+                }
+            });
+        };
+
+        if (matrix_info.type == _jit_sym_char) {
+            convert.template operator()<uint8_t>();
+        } else if (matrix_info.type == _jit_sym_long) {
+            convert.template operator()<int32_t>();
+        } else if (matrix_info.type == _jit_sym_float32) {
+            convert.template operator()<float>();
+        } else {
+            convert.template operator()<double>();
+        }
+    }
 };
 
 using storage_variant = std::variant<
@@ -103,7 +406,12 @@ using storage_variant = std::variant<
     atom_storage<int32_t>,
     atom_storage<int64_t>,
     atom_storage<float>,
-    atom_storage<double>
+    atom_storage<double>,
+    atom_storage<half_element>,
+    atom_storage<fixed_element<int8_t>>,
+    atom_storage<fixed_element<int16_t>>,
+    atom_storage<fixed_element<uint8_t>>,
+    atom_storage<fixed_element<uint16_t>>
 >;
 
 struct matrix_storage {
@@ -131,20 +439,80 @@ public:
         return std::visit([&archive](auto &s) { return archive(s); }, self.sv);
     }
 
-    template <typename OutIt>
-    auto store_to_atoms(OutIt out) const {
-        return std::visit([out](auto &s) mutable {
-            for (const auto &value: s) {
-                *out++ = atom_from(value);
+    // Adds this field to plan, laid out as serialize() would, except that only the plan encodes
+    // varint fields as varints and packs bit fields. The plan refers to the data in place, so the storage must not
+    // move while the plan is in use.
+    void add_to(serialisation_plan &plan) {
+        std::visit([&plan](auto &s) {
+            using T = typename std::decay_t<decltype(s.data)>::value_type;
+            if constexpr (std::is_integral_v<T> && sizeof(T) <= 4) {
+                if (s.info.is_bit_field()) {
+                    if (s.info.is_variable_length()) {
+                        plan.add_bit_field(s.data, s.info.bit_width());
+                    } else {
+                        plan.add_bit_field(s.data.data(), s.data.size(), s.info.bit_width());
+                    }
+                    return;
+                }
+            }
+            const auto encoding = plan_encoding(s.info);
+            if (s.info.is_variable_length()) {
+                plan.add_variable(s.data, encoding);
+            } else {
+                plan.add_fixed(s.data.data(), s.data.size(), encoding);
             }
-            return out;
         }, sv);
     }
 
+    void load(t_jit_object *matrix, bool planar) {
+        std::visit([&](auto &s) { s.load(matrix, planar); }, sv);
+    }
+
+    // previous must be a copy of this storage from earlier
+    [[nodiscard]] bool differs(const storage &previous, const deadband &band) const {
+        return std::visit([&](const auto &s) {
+            return s.differs(std::get<std::decay_t<decltype(s)>>(previous.sv), band);
+        }, sv);
+    }
+
+    std::optional<strided_source> matrix_source(size_t field, const t_jit_matrix_info &matrix_info,
+                                                const char *matrix_data, bool planar) const {
+        return std::visit([&](auto &s) { return s.matrix_source(field, matrix_info, matrix_data, planar); }, sv);
+    }
+
+    template <typename OutIt>
+    auto store_to_atoms(OutIt out) const {
+        return std::visit([out](auto &s) { return s.store_to_atoms(out); }, sv);
+    }
+
 private:
     storage_variant sv;
 
+    static serialisation_plan::encoding plan_encoding(const type_info &info) {
+        switch (info.type) {
+            case type_info::primitive_type::v32:
+            case type_info::primitive_type::v64:
+                return serialisation_plan::encoding::varint;
+            case type_info::primitive_type::z32:
+            case type_info::primitive_type::z64:
+                return serialisation_plan::encoding::zigzag;
+            default:
+                return serialisation_plan::encoding::raw;
+        }
+    }
+
     static storage_variant create_variant(const type_info &info) {
+        if (info.is_bit_field()) {
+            // Held in the smallest integer that fits, b1 as 0 or 1
+            const unsigned width = info.bit_width();
+            const bool is_signed = info.is_signed_bit_field();
+            if (width < 8) {
+                return is_signed ? storage_variant(atom_storage<int8_t>(info)) : atom_storage<uint8_t>(info);
+            } else if (width < 16) {
+                return is_signed ? storage_variant(atom_storage<int16_t>(info)) : atom_storage<uint16_t>(info);
+            }
+            return is_signed ? storage_variant(atom_storage<int32_t>(info)) : atom_storage<uint32_t>(info);
+        }
         switch (info.type) {
 #define CASE(type, type_enum)                               \
             case type_info::primitive_type::type_enum:      \
@@ -159,6 +527,15 @@ private:
             CASE(int64_t, i64)
             CASE(float, f32)
             CASE(double, f64)
+            CASE(uint32_t, v32)
+            CASE(uint64_t, v64)
+            CASE(int32_t, z32)
+            CASE(int64_t, z64)
+            CASE(half_element, f16)
+            CASE(fixed_element<int8_t>, q7)
+            CASE(fixed_element<int16_t>, q15)
+            CASE(fixed_element<uint8_t>, uq8)
+            CASE(fixed_element<uint16_t>, uq16)
 #undef CASE
             default:
                 throw std::runtime_error("Unsupported type");
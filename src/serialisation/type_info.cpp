@@ -3,11 +3,13 @@
 //
 
 #include "type_info.hpp"
+#include <cmath>
 #include <regex>
+#include <sstream>
 #include "magic_enum.hpp"
 
 type_info::type_info(const std::string & type_string) {
-    static const std::regex re(R"((\w+)(\[(\d+)?\])?)");
+    static const std::regex re(R"((\w+)(?:\(([^()]+)\))?(\[(\d+)?\])?)");
     std::smatch matches;
     if (!std::regex_match(type_string, matches, re)) {
         throw std::runtime_error("Invalid type string: " + type_string);
@@ -15,10 +17,24 @@ type_info::type_info(const std::string & type_string) {
     if (auto type_opt = magic_enum::enum_cast<primitive_type>(matches[1].str())) {
         type = *type_opt;
         if (matches[2].matched) {
-            if (matches[3].str().empty()) {
+            if (!is_fixed_point()) {
+                throw std::runtime_error("Only fixed point types take a scale: " + type_string);
+            }
+            size_t parsed = 0;
+            try {
+                scale = std::stod(matches[2].str(), &parsed);
+            } catch (const std::exception &) {
+                parsed = 0;
+            }
+            if (parsed != static_cast<size_t>(matches[2].length()) || !std::isfinite(scale) || scale <= 0) {
+                throw std::runtime_error("Scale must be a positive number: " + matches[2].str());
+            }
+        }
+        if (matches[3].matched) {
+            if (matches[4].str().empty()) {
                 size = variable_size;
             } else {
-                size = std::stoull(matches[3].str());
+                size = std::stoull(matches[4].str());
                 if (size == 0) {
                     throw std::runtime_error("Array array_length must be greater than zero");
                 }
@@ -33,6 +49,11 @@ type_info::type_info(const std::string & type_string) {
 
 std::string type_info::to_string() const {
     auto result = std::string(magic_enum::enum_name(type));
+    if (scale != 1) {
+        std::ostringstream text;
+        text << scale;
+        result += "(" + text.str() + ")";
+    }
     if (!is_scalar()) {
         if (is_variable_length()) {
             result += "[]";
@@ -43,13 +64,78 @@ std::string type_info::to_string() const {
     return result;
 }
 
+bool type_info::is_varint() const {
+    switch (type) {
+        case primitive_type::v32:
+        case primitive_type::v64:
+        case primitive_type::z32:
+        case primitive_type::z64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool type_info::is_bit_field() const {
+    return type >= primitive_type::b1;
+}
+
+bool type_info::is_signed_bit_field() const {
+    return type >= primitive_type::i1;
+}
+
+unsigned type_info::bit_width() const {
+    if (!is_bit_field()) {
+        return 0;
+    }
+    if (type == primitive_type::b1) {
+        return 1;
+    }
+    return static_cast<unsigned>(std::stoul(std::string(magic_enum::enum_name(type).substr(1))));
+}
+
+bool type_info::is_fixed_point() const {
+    return fraction_bits() != 0;
+}
+
+int type_info::fraction_bits() const {
+    switch (type) {
+        case primitive_type::q7:
+            return 7;
+        case primitive_type::uq8:
+            return 8;
+        case primitive_type::q15:
+            return 15;
+        case primitive_type::uq16:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t type_info::size_bits() const {
+    if (is_bit_field()) {
+        return size * bit_width();
+    }
+    return size_bytes() * 8;
+}
+
+// For varints, the most the elements can take
 size_t type_info::size_bytes() const {
+    if (is_bit_field()) {
+        return (size_bits() + 7) / 8;
+    }
     switch (type) {
         case primitive_type::u8:
         case primitive_type::i8:
+        case primitive_type::q7:
+        case primitive_type::uq8:
             return size;
         case primitive_type::u16:
         case primitive_type::i16:
+        case primitive_type::f16:
+        case primitive_type::q15:
+        case primitive_type::uq16:
             return size * 2;
         case primitive_type::u32:
         case primitive_type::i32:
@@ -59,7 +145,45 @@ size_t type_info::size_bytes() const {
         case primitive_type::i64:
         case primitive_type::f64:
             return size * 8;
+        case primitive_type::v32:
+        case primitive_type::z32:
+            return size * 5;
+        case primitive_type::v64:
+        case primitive_type::z64:
+            return size * 10;
         default:
             throw std::runtime_error("Invalid type");
     }
 }
+
+size_t type_info::element_bytes() const {
+    if (is_varint() || is_bit_field()) {
+        return 0;
+    }
+    type_info element = *this;
+    element.size = 1;
+    return element.size_bytes();
+}
+
+size_t type_info::schema_size_bytes(std::span<const type_info> schema) {
+    constexpr size_t count_prefix = 4;
+    size_t bytes = 0;
+    size_t group_bits = 0;
+    for (const type_info &field : schema) {
+        // A variable field's count, like any whole byte field, ends the group before it
+        if (!field.is_bit_field() || field.is_variable_length()) {
+            bytes += (group_bits + 7) / 8;
+            group_bits = 0;
+        }
+        if (field.is_variable_length()) {
+            bytes += count_prefix;
+        } else if (field.is_varint()) {
+            bytes += field.size; // a byte each at the least
+        } else if (field.is_bit_field()) {
+            group_bits += field.size_bits();
+        } else {
+            bytes += field.size_bytes();
+        }
+    }
+    return bytes + (group_bits + 7) / 8;
+}
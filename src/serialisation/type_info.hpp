@@ -5,19 +5,48 @@
 #ifndef TYPE_INFO_HPP
 #define TYPE_INFO_HPP
 
+#include <span>
 #include <string>
 
 struct type_info {
     explicit type_info(const std::string &type_string);
+    // v32 and v64 are unsigned LEB128 varints, z32 and z64 signed ones zigzag encoded first.
+    // f16 is an IEEE half. q7 and q15 are signed fixed point fractions, uq8 and uq16 unsigned
+    // ones, covering -scale to scale, or 0 to scale, in 8 or 16 bits: q15(2.5)[4].
+    // b1 is a flag, and u1 to u31 and i1 to i31 unsigned and signed integers of that many bits,
+    // packed together with the bit fields either side of them; u8, u16, i8 and i16 are the
+    // whole byte types.
     enum class primitive_type {
-        u8, i8, u16, i16, u32, i32, u64, i64, f32, f64 // TODO: Add string and boolean types
+        u8, i8, u16, i16, u32, i32, u64, i64, f32, f64, v32, v64, z32, z64, f16, q7, q15, uq8, uq16,
+        b1,
+        u1, u2, u3, u4, u5, u6, u7, u9, u10, u11, u12, u13, u14, u15,
+        u17, u18, u19, u20, u21, u22, u23, u24, u25, u26, u27, u28, u29, u30, u31,
+        i1, i2, i3, i4, i5, i6, i7, i9, i10, i11, i12, i13, i14, i15,
+        i17, i18, i19, i20, i21, i22, i23, i24, i25, i26, i27, i28, i29, i30, i31 // TODO: Add a string type
     } type;
     size_t size;
+    double scale{1};
     static constexpr size_t variable_size = -1;
     [[nodiscard]] bool is_variable_length() const { return size == variable_size; }
     [[nodiscard]] bool is_scalar() const { return size == 1; }
+    [[nodiscard]] bool is_varint() const;
+    [[nodiscard]] bool is_fixed_point() const;
+    // Bits after the point of a fixed point type
+    [[nodiscard]] int fraction_bits() const;
+    [[nodiscard]] bool is_bit_field() const;
+    [[nodiscard]] bool is_signed_bit_field() const;
+    // Bits an element of a bit field takes
+    [[nodiscard]] unsigned bit_width() const;
+    // Bytes each element takes whatever its value, 0 for varints and bit fields
+    [[nodiscard]] size_t element_bytes() const;
     [[nodiscard]] std::string to_string() const;
+    [[nodiscard]] size_t size_bits() const;
+    // A field on its own, padded to a whole byte. For several, see schema_size_bytes().
     [[nodiscard]] size_t size_bytes() const;
+    // The fewest bytes a record of the schema can take, bit fields packed into groups as
+    // serialisation_plan packs them. Variable fields count as just their 4 byte count, and
+    // varints as a byte an element.
+    [[nodiscard]] static size_t schema_size_bytes(std::span<const type_info> schema);
 };
 
 #endif //TYPE_INFO_HPP
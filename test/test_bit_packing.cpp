@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "bit_packing.hpp"
+
+using namespace bytestream::detail;
+
+namespace {
+
+// The packing spelled out bit by bit, for the word at a time writer to agree with
+std::vector<uint8_t> reference_pack(const std::vector<uint32_t> &values, unsigned width, bool msb) {
+    std::vector<uint8_t> packed(packed_bytes(values.size() * width));
+    size_t at = 0;
+    for (const uint32_t value : values) {
+        for (unsigned b = 0; b < width; ++b, ++at) {
+            const bool bit = msb ? (value >> (width - 1 - b)) & 1 : (value >> b) & 1;
+            if (bit) {
+                packed[at / 8] |= static_cast<uint8_t>(msb ? 0x80 >> (at % 8) : 1 << (at % 8));
+            }
+        }
+    }
+    return packed;
+}
+
+std::vector<uint32_t> random_values(size_t count, unsigned width, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> values(count);
+    for (auto &value : values) {
+        value = static_cast<uint32_t>(rng() & low_bits_mask(width));
+    }
+    return values;
+}
+
+} // namespace
+
+TEST_CASE("Bit writer and reader round trip", "[bit_packing]") {
+    const unsigned width = GENERATE(1, 3, 7, 8, 12, 17, 31, 32);
+    const size_t count = GENERATE(0, 1, 5, 33, 100);
+    const bool msb = GENERATE(false, true);
+    const auto values = random_values(count, width, width * 1000 + static_cast<unsigned>(count));
+    const auto expected = reference_pack(values, width, msb);
+
+    std::vector<uint8_t> packed(expected.size() + 8);
+    bit_writer writer(msb);
+    uint8_t *out = packed.data();
+    for (const uint32_t value : values) {
+        out = writer.put(out, value | ~static_cast<uint32_t>(low_bits_mask(width)), width);
+    }
+    out = writer.finish(out);
+    packed.resize(static_cast<size_t>(out - packed.data()));
+    REQUIRE(packed == expected);
+
+    SECTION("Read whole") {
+        bit_reader reader(msb);
+        reader.source(packed.data(), packed.data() + packed.size());
+        for (const uint32_t value : values) {
+            uint32_t got;
+            REQUIRE(reader.get(width, got));
+            CHECK(got == value);
+        }
+        CHECK(reader.position() == packed.data() + packed.size());
+    }
+
+    SECTION("Read a piece at a time") {
+        const size_t piece = GENERATE(1, 3, 5);
+        bit_reader reader(msb);
+        size_t fed = 0;
+        for (const uint32_t value : values) {
+            uint32_t got;
+            while (!reader.get(width, got)) {
+                REQUIRE(fed < packed.size());
+                const size_t n = std::min(piece, packed.size() - fed);
+                reader.source(packed.data() + fed, packed.data() + fed + n);
+                fed += n;
+            }
+            CHECK(got == value);
+        }
+        CHECK(fed == packed.size());
+    }
+}
+
+TEST_CASE("Bit fields of signed elements are sign extended", "[bit_packing]") {
+    const bool msb = GENERATE(false, true);
+    const std::vector<int16_t> values{0, 1, -1, 2047, -2048, -300, 5};
+    std::vector<uint8_t> src(values.size() * sizeof(int16_t));
+    std::memcpy(src.data(), values.data(), src.size());
+
+    std::vector<uint8_t> packed(packed_bytes(values.size() * 12) + 4);
+    bit_writer writer(msb);
+    uint8_t *out = pack_bits<int16_t>(writer, packed.data(), src.data(), values.size(), 12);
+    out = writer.finish(out);
+    REQUIRE(static_cast<size_t>(out - packed.data()) == packed_bytes(values.size() * 12));
+
+    bit_reader reader(msb);
+    reader.source(packed.data(), out);
+    std::vector<uint8_t> dst(src.size());
+    REQUIRE(unpack_bits<int16_t>(reader, dst.data(), values.size(), 12) == values.size());
+    CHECK(dst == src);
+
+    SECTION("Unsigned elements aren't") {
+        bit_reader unsigned_reader(msb);
+        unsigned_reader.source(packed.data(), out);
+        std::vector<uint16_t> raw(values.size());
+        REQUIRE(unpack_bits<uint16_t>(unsigned_reader, reinterpret_cast<uint8_t *>(raw.data()), raw.size(), 12) ==
+                raw.size());
+        CHECK(raw[2] == 0xFFF);
+        CHECK(raw[4] == 0x800);
+    }
+
+    SECTION("Running out part way") {
+        bit_reader short_reader(msb);
+        short_reader.source(packed.data(), packed.data() + 4);
+        CHECK(unpack_bits<int16_t>(short_reader, dst.data(), values.size(), 12) == 2);
+    }
+}
@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "byte_swap.hpp"
+
+namespace {
+
+template <size_t Size>
+std::vector<uint8_t> reference_swap(const uint8_t *src, size_t count) {
+    std::vector<uint8_t> out(count * Size);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < Size; ++b) {
+            out[i * Size + b] = src[i * Size + Size - 1 - b];
+        }
+    }
+    return out;
+}
+
+template <size_t Size>
+void check_copy_swapped() {
+    // Counts either side of every vector width, from unaligned offsets
+    const size_t count = GENERATE(0, 1, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 1000);
+    const size_t offset = GENERATE(0, 1, 3);
+
+    std::vector<uint8_t> source(count * Size + offset);
+    std::iota(source.begin(), source.end(), uint8_t{1});
+    const uint8_t *src = source.data() + offset;
+    const auto expected = reference_swap<Size>(src, count);
+
+    std::vector<uint8_t> destination(count * Size + offset + 1, 0xEE);
+    bytestream::detail::copy_swapped<Size>(destination.data() + offset, src, count);
+    REQUIRE(std::vector<uint8_t>(destination.begin() + offset, destination.end() - 1) == expected);
+    REQUIRE(destination.back() == 0xEE);
+
+    std::vector<uint8_t> in_place(src, src + count * Size);
+    bytestream::detail::copy_swapped<Size>(in_place.data(), in_place.data(), count);
+    REQUIRE(in_place == expected);
+}
+
+} // namespace
+
+TEST_CASE("Byte swapping copy of 2 byte elements", "[byte_swap]") {
+    check_copy_swapped<2>();
+}
+
+TEST_CASE("Byte swapping copy of 4 byte elements", "[byte_swap]") {
+    check_copy_swapped<4>();
+}
+
+TEST_CASE("Byte swapping copy of 8 byte elements", "[byte_swap]") {
+    check_copy_swapped<8>();
+}
+
+TEST_CASE("Scalar byte swap", "[byte_swap]") {
+    STATIC_REQUIRE(sizeof(bytestream::detail::byteswap(uint16_t{0})) == 2);
+    REQUIRE(bytestream::detail::byteswap(uint16_t{0x0102}) == 0x0201);
+    REQUIRE(bytestream::detail::byteswap(uint32_t{0x01020304}) == 0x04030201);
+    REQUIRE(bytestream::detail::byteswap(uint64_t{0x0102030405060708}) == 0x0807060504030201);
+}
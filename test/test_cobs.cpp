@@ -1,4 +1,6 @@
+#include <span>
 #include <vector>
+#include <random>
 
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
@@ -115,4 +117,125 @@ TEST_CASE("COBS encoding and decoding", "[cobs]") {
         REQUIRE(decoder.packet_complete());
         REQUIRE(decoded == data.decoded);
     }
+
+    SECTION("Bulk decoding") {
+        const size_t chunk_size = GENERATE(1, 3, 64);
+        std::vector<uint8_t> stream(data.encoded.begin(), data.encoded.end());
+        stream.insert(stream.end(), data.encoded.begin(), data.encoded.end());
+
+        COBSDecoder decoder;
+        std::vector<std::vector<int>> frames;
+        for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+            const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+            decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+                frames.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == data.decoded);
+        REQUIRE(frames[1] == data.decoded);
+    }
+}
+
+TEST_CASE("COBS contiguous encoder matches generic encoder", "[cobs]") {
+    const size_t size = GENERATE(0, 1, 253, 254, 255, 508, 509, 4096);
+    const int zero_one_in = GENERATE(0, 2, 300);
+
+    std::mt19937 rng(static_cast<unsigned>(size * 31 + zero_one_in));
+    std::vector<uint8_t> input(size);
+    for (auto &byte : input) {
+        byte = static_cast<uint8_t>(rng() % 255 + 1);
+        if (zero_one_in && rng() % zero_one_in == 0) {
+            byte = 0;
+        }
+    }
+
+    std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+    expected.resize(std::distance(expected.begin(), cobs_encode_frame(input.begin(), input.end(), expected.begin())));
+
+    std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+    encoded.resize(cobs_encode_frame(input, encoded.data()));
+
+    REQUIRE(encoded == expected);
+}
+
+TEST_CASE("COBS contiguous decoder", "[cobs]") {
+    const size_t size = GENERATE(0, 1, 253, 254, 255, 508, 509, 4096);
+    const int zero_one_in = GENERATE(0, 2, 300);
+
+    std::mt19937 rng(static_cast<unsigned>(size * 17 + zero_one_in));
+    std::vector<uint8_t> input(size);
+    for (auto &byte : input) {
+        byte = static_cast<uint8_t>(rng() % 255 + 1);
+        if (zero_one_in && rng() % zero_one_in == 0) {
+            byte = 0;
+        }
+    }
+    std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+    encoded.resize(cobs_encode_frame(input, encoded.data()));
+
+    SECTION("Into a separate buffer") {
+        std::vector<uint8_t> decoded(encoded.size());
+        const auto decoded_size = cobs_decode_frame(encoded, decoded.data());
+        REQUIRE(decoded_size.has_value());
+        decoded.resize(*decoded_size);
+        REQUIRE(decoded == input);
+    }
+
+    SECTION("In place") {
+        const auto decoded_size = cobs_decode_frame_in_place(encoded);
+        REQUIRE(decoded_size.has_value());
+        encoded.resize(*decoded_size);
+        REQUIRE(encoded == input);
+    }
+
+    SECTION("Without trailing delimiter") {
+        std::vector<uint8_t> decoded(encoded.size());
+        const auto decoded_size = cobs_decode_frame(std::span(encoded).first(encoded.size() - 1), decoded.data());
+        REQUIRE(decoded_size == input.size());
+    }
+}
+
+TEST_CASE("COBS contiguous decoder rejects malformed frames", "[cobs]") {
+    std::vector<uint8_t> decoded(16);
+
+    SECTION("Code byte past the end") {
+        const std::vector<uint8_t> frame{0x05, 0x11, 0x22};
+        REQUIRE_FALSE(cobs_decode_frame(frame, decoded.data()).has_value());
+    }
+
+    SECTION("Embedded zero") {
+        const std::vector<uint8_t> frame{0x04, 0x11, 0x00, 0x22, 0x00};
+        REQUIRE_FALSE(cobs_decode_frame(frame, decoded.data()).has_value());
+    }
+}
+
+TEST_CASE("COBS decoder drops frames longer than the maximum", "[cobs]") {
+    COBSDecoder decoder;
+    decoder.set_max_frame_length(8);
+
+    const std::vector<uint8_t> fits{1, 0, 2, 3, 4, 5, 6, 7};
+    const std::vector<uint8_t> too_long{1, 2, 3, 4, 0, 5, 6, 7, 8};
+    std::vector<uint8_t> stream(cobs_encoded_max_length(fits.size()) * 2 + cobs_encoded_max_length(too_long.size()));
+    auto out = stream.begin();
+    out = cobs_encode_frame(fits.begin(), fits.end(), out);
+    out = cobs_encode_frame(too_long.begin(), too_long.end(), out);
+    out = cobs_encode_frame(fits.begin(), fits.end(), out);
+    stream.erase(out, stream.end());
+
+    auto chunk_size = GENERATE(size_t{1}, size_t{3}, size_t{64});
+    std::vector<std::vector<uint8_t>> frames;
+    size_t dropped = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        dropped += decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        });
+    }
+
+    REQUIRE(dropped == 1);
+    REQUIRE(frames.size() == 2);
+    REQUIRE(frames[0] == fits);
+    REQUIRE(frames[1] == fits);
 }
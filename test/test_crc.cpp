@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <array>
+#include <random>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "COBS.hpp"
+#include "CRC.hpp"
+#include "LEB128.hpp"
+#include "SLIP.hpp"
+
+namespace {
+
+template <typename Checksum>
+auto checksum_of(std::span<const uint8_t> data) {
+    Checksum checksum;
+    checksum.update(data.data(), data.size());
+    return checksum.value();
+}
+
+std::vector<uint8_t> random_payload(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> payload(size);
+    for (auto &b : payload) {
+        b = static_cast<uint8_t>(byte(rng));
+    }
+    return payload;
+}
+
+struct Framed {
+    std::vector<uint8_t> encoded;
+    size_t payload_offset; // where the payload starts in encoded, for corrupting it
+};
+
+template <typename Checksum>
+Framed encode_cobs(std::span<const uint8_t> payload) {
+    std::vector<uint8_t> encoded(cobs_encoded_max_length(payload.size() + Checksum::size));
+    COBSEncoder encoder(encoded.data());
+    Checksum checksum;
+    push_with_checksum(encoder, payload, checksum);
+    encoded.resize(encoder.finish());
+    return {encoded, 1};
+}
+
+template <typename Checksum>
+Framed encode_slip(std::span<const uint8_t> payload) {
+    // Worst case: every byte escaped
+    std::vector<uint8_t> encoded(2 * (payload.size() + Checksum::size) + 1);
+    SLIPEncoder encoder(encoded.data());
+    Checksum checksum;
+    push_with_checksum(encoder, payload, checksum);
+    encoded.resize(encoder.finish());
+    return {encoded, 0};
+}
+
+template <typename Checksum>
+Framed encode_leb128(std::span<const uint8_t> payload) {
+    Checksum checksum;
+    checksum.update(payload.data(), payload.size());
+    std::vector<uint8_t> body(payload.begin(), payload.end());
+    body.resize(payload.size() + Checksum::size);
+    checksum.write(body.begin() + static_cast<std::ptrdiff_t>(payload.size()));
+    std::vector<uint8_t> encoded(leb128_encoded_length(body.size()));
+    leb128_encode_frame(body.begin(), body.size(), encoded.begin());
+    return {encoded, leb128_length(body.size())};
+}
+
+// Feeds three copies of the frame, the middle one with a corrupted byte, and checks that
+// only the intact ones come out. The LEB128 decoder scans a frame that fails its checksum again
+// for a header, trying every byte of it as one; with CRC-8 or CRC-16 one of those misread frames
+// can pass and swallow the last copy, so only CRC-32C is sure to find it. It may also be left
+// partway through a misread frame, so it is given zeros, empty frames, to finish that one.
+template <typename Decoder, typename Checksum>
+void check_round_trip(const Framed &framed, std::span<const uint8_t> payload, size_t chunk_size) {
+    constexpr bool rescans = std::is_same_v<Decoder, LEB128Decoder>;
+    std::vector<uint8_t> stream(framed.encoded);
+    std::vector<uint8_t> corrupted(framed.encoded);
+    // Never a delimiter or escape in any of the codecs, so only the checksum can catch it
+    auto &victim = corrupted[framed.payload_offset];
+    victim = victim == 0x01 ? 0x02 : 0x01;
+    stream.insert(stream.end(), corrupted.begin(), corrupted.end());
+    stream.insert(stream.end(), framed.encoded.begin(), framed.encoded.end());
+    if constexpr (rescans) {
+        stream.resize(stream.size() + Decoder::default_max_frame_length + 10, 0);
+    }
+
+    Decoder decoder;
+    Checksum checksum;
+    std::vector<std::vector<uint8_t>> frames;
+    size_t dropped = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        dropped += decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        }, checksum);
+    }
+
+    const std::vector<uint8_t> expected(payload.begin(), payload.end());
+    if constexpr (rescans) {
+        REQUIRE(dropped >= 1);
+        REQUIRE(frames.front() == expected);
+        if (Checksum::size == 4) {
+            // One for the corrupted copy, however many misread frames the hunt tried on the
+            // way, and one for the zeros after the last copy, empty frames with no checksum
+            REQUIRE(dropped == 2);
+            REQUIRE(frames.size() == 2);
+            REQUIRE(frames[1] == expected);
+        }
+        return;
+    }
+    REQUIRE(dropped == 1);
+    REQUIRE(frames.size() == 2);
+    REQUIRE(frames[0] == expected);
+    REQUIRE(frames[1] == expected);
+}
+
+} // namespace
+
+TEST_CASE("CRC check values", "[crc]") {
+    constexpr std::string_view check = "123456789";
+    const std::span data(reinterpret_cast<const uint8_t *>(check.data()), check.size());
+
+    REQUIRE(checksum_of<CRC8>(data) == 0xF4);
+    REQUIRE(checksum_of<CRC16>(data) == 0x29B1);
+    REQUIRE(checksum_of<CRC32C>(data) == 0xE3069283);
+}
+
+TEST_CASE("CRC bulk update matches bytewise update", "[crc]") {
+    const auto data = random_payload(1000, 1);
+
+    CRC8 crc8;
+    CRC16 crc16;
+    CRC32C crc32c;
+    for (const uint8_t byte : data) {
+        crc8.update(&byte, 1);
+        crc16.update(&byte, 1);
+        crc32c.update(&byte, 1);
+    }
+    REQUIRE(checksum_of<CRC8>(data) == crc8.value());
+    REQUIRE(checksum_of<CRC16>(data) == crc16.value());
+    REQUIRE(checksum_of<CRC32C>(data) == crc32c.value());
+}
+
+TEST_CASE("CRC trailers round trip through the framing codecs", "[crc]") {
+    const size_t size = GENERATE(1, 100, 254, 255, 5000);
+    const size_t chunk_size = GENERATE(1, 7, 4096);
+    const auto payload = random_payload(size, static_cast<unsigned>(size));
+
+    SECTION("COBS") {
+        check_round_trip<COBSDecoder, CRC8>(encode_cobs<CRC8>(payload), payload, chunk_size);
+        check_round_trip<COBSDecoder, CRC16>(encode_cobs<CRC16>(payload), payload, chunk_size);
+        check_round_trip<COBSDecoder, CRC32C>(encode_cobs<CRC32C>(payload), payload, chunk_size);
+    }
+
+    SECTION("SLIP") {
+        check_round_trip<SLIPDecoder, CRC8>(encode_slip<CRC8>(payload), payload, chunk_size);
+        check_round_trip<SLIPDecoder, CRC16>(encode_slip<CRC16>(payload), payload, chunk_size);
+        check_round_trip<SLIPDecoder, CRC32C>(encode_slip<CRC32C>(payload), payload, chunk_size);
+    }
+
+    SECTION("LEB128") {
+        check_round_trip<LEB128Decoder, CRC8>(encode_leb128<CRC8>(payload), payload, chunk_size);
+        check_round_trip<LEB128Decoder, CRC16>(encode_leb128<CRC16>(payload), payload, chunk_size);
+        check_round_trip<LEB128Decoder, CRC32C>(encode_leb128<CRC32C>(payload), payload, chunk_size);
+    }
+}
@@ -0,0 +1,243 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "delta_record.hpp"
+
+using namespace bytestream::detail;
+
+namespace {
+
+// A record of an f32[256], an i16[] behind its count, a u64[4] and a u8, as serialisation_plan
+// would lay it out
+struct record {
+    std::vector<float> levels = std::vector<float>(256);
+    std::vector<int16_t> samples;
+    std::vector<uint64_t> counters = std::vector<uint64_t>(4);
+    uint8_t flags{0};
+
+    void serialise(std::vector<uint8_t> &bytes, std::vector<size_t> &offsets) const {
+        bytes.clear();
+        offsets.assign(1, 0);
+        const auto append = [&](const void *data, size_t size) {
+            const auto *p = static_cast<const uint8_t *>(data);
+            bytes.insert(bytes.end(), p, p + size);
+        };
+        append(levels.data(), levels.size() * sizeof(float));
+        offsets.push_back(bytes.size());
+        const auto count = static_cast<uint32_t>(samples.size());
+        append(&count, sizeof(count));
+        append(samples.data(), samples.size() * sizeof(int16_t));
+        offsets.push_back(bytes.size());
+        append(counters.data(), counters.size() * sizeof(uint64_t));
+        offsets.push_back(bytes.size());
+        append(&flags, 1);
+        offsets.push_back(bytes.size());
+    }
+};
+
+const std::vector<size_t> element_sizes{4, 2, 8, 0};
+constexpr bool native_big = std::endian::native == std::endian::big;
+
+// The tag each field was sent with
+std::vector<delta_tag> tags_of(const std::vector<uint8_t> &delta) {
+    std::vector<delta_tag> tags;
+    const uint8_t *in = delta.data() + delta_header_size;
+    const uint8_t *const end = delta.data() + delta.size();
+    while (in != end) {
+        const auto tag = static_cast<delta_tag>(*in++);
+        tags.push_back(tag);
+        if (tag == delta_tag::whole) {
+            uint64_t size = 0;
+            const uint8_t *const data = varint_decode(in, end, size);
+            REQUIRE(data);
+            REQUIRE(size <= static_cast<uint64_t>(end - data));
+            in = data + size;
+        } else if (tag != delta_tag::same) {
+            break; // the rest can't be skipped without the reference
+        }
+    }
+    return tags;
+}
+
+} // namespace
+
+TEST_CASE("Delta records rebuild each record", "[delta_record]") {
+    const bool big = GENERATE(false, true);
+    delta_encoder encoder(element_sizes, big);
+    delta_decoder decoder(element_sizes, big);
+    std::mt19937 rng(42);
+
+    record r;
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> delta;
+    for (int n = 0; n < 200; ++n) {
+        switch (n % 5) {
+            case 0:
+                for (auto &level : r.levels) {
+                    level += 0.001f * static_cast<float>(static_cast<int>(rng() % 21) - 10);
+                }
+                break;
+            case 1:
+                r.levels[rng() % r.levels.size()] = static_cast<float>(rng());
+                break;
+            case 2:
+                r.samples.resize(rng() % 40);
+                for (auto &sample : r.samples) {
+                    sample = static_cast<int16_t>(rng());
+                }
+                break;
+            case 3:
+                for (auto &counter : r.counters) {
+                    counter -= rng() % 3;
+                }
+                break;
+            default:
+                r.flags = static_cast<uint8_t>(rng());
+                break;
+        }
+        r.serialise(bytes, offsets);
+        const bool keyframe = encoder.encode(bytes, offsets, n % 50 == 49, delta);
+        CHECK(keyframe == (n == 0 || n % 50 == 49));
+        CHECK(delta.size() <= encoder.max_size(bytes.size()));
+        REQUIRE(decoder.decode(delta) == delta_decoder::outcome::applied);
+        REQUIRE(std::ranges::equal(decoder.record(), bytes));
+    }
+}
+
+TEST_CASE("Delta records send each field the shortest way", "[delta_record]") {
+    // The record is serialised in native byte order, which its elements are compared in
+    const bool big = native_big;
+    delta_encoder encoder(element_sizes, big);
+    record r;
+    r.samples.resize(10);
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> delta;
+    r.serialise(bytes, offsets);
+    encoder.encode(bytes, offsets, false, delta);
+    REQUIRE(delta[0] == static_cast<uint8_t>(delta_kind::keyframe));
+    CHECK(tags_of(delta) == std::vector(4, delta_tag::whole));
+
+    SECTION("Unchanged fields are sent as the same") {
+        encoder.encode(bytes, offsets, false, delta);
+        CHECK(delta[0] == static_cast<uint8_t>(delta_kind::delta));
+        CHECK(delta.size() == delta_header_size + 4);
+        const uint8_t second = big ? delta[2] : delta[1];
+        CHECK(second == 1);
+    }
+
+    SECTION("A few changes are sparse") {
+        r.levels[3] = 1.0f;
+        r.levels[100] = -1.0f;
+        r.serialise(bytes, offsets);
+        encoder.encode(bytes, offsets, false, delta);
+        CHECK(tags_of(delta) == std::vector{delta_tag::sparse});
+        // The count, then a gap and four bytes for each
+        CHECK(delta.size() == delta_header_size + 1 + 1 + 2 * 5 + 3);
+    }
+
+    SECTION("Small changes everywhere are differences") {
+        for (auto &level : r.levels) {
+            level = std::nextafter(level, 1.0f);
+        }
+        r.serialise(bytes, offsets);
+        encoder.encode(bytes, offsets, false, delta);
+        CHECK(tags_of(delta) == std::vector{delta_tag::difference});
+        CHECK(delta.size() < 256 * 2 + 10);
+    }
+
+    SECTION("Large changes everywhere, and resized fields, are whole") {
+        std::mt19937 rng(1);
+        for (auto &level : r.levels) {
+            level = static_cast<float>(rng()) * (rng() % 2 ? 1.0f : -1.0f);
+        }
+        r.samples.resize(11);
+        r.flags = 1;
+        r.serialise(bytes, offsets);
+        encoder.encode(bytes, offsets, false, delta);
+        CHECK(tags_of(delta) == std::vector{delta_tag::whole, delta_tag::whole, delta_tag::same, delta_tag::whole});
+    }
+
+    SECTION("Reset makes a keyframe") {
+        encoder.reset();
+        CHECK(encoder.encode(bytes, offsets, false, delta));
+        CHECK(delta[0] == static_cast<uint8_t>(delta_kind::keyframe));
+    }
+
+    CHECK_THROWS_AS(encoder.encode(bytes, std::span(offsets).first(3), false, delta), std::invalid_argument);
+}
+
+TEST_CASE("Delta decoder waits for a keyframe after a loss", "[delta_record]") {
+    delta_encoder encoder(element_sizes, native_big);
+    delta_decoder decoder(element_sizes, native_big);
+    record r;
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+    std::vector<std::vector<uint8_t>> deltas(6);
+    for (size_t n = 0; n < deltas.size(); ++n) {
+        r.levels[n] = static_cast<float>(n);
+        r.serialise(bytes, offsets);
+        encoder.encode(bytes, offsets, n == 4, deltas[n]);
+    }
+
+    SECTION("Deltas before the first keyframe") {
+        CHECK(decoder.decode(deltas[1]) == delta_decoder::outcome::lost);
+        CHECK(decoder.decode(deltas[2]) == delta_decoder::outcome::waiting);
+        CHECK(decoder.decode(deltas[4]) == delta_decoder::outcome::applied);
+        CHECK(decoder.decode(deltas[5]) == delta_decoder::outcome::applied);
+        CHECK(std::ranges::equal(decoder.record(), bytes));
+    }
+
+    SECTION("A delta lost on the way") {
+        CHECK(decoder.decode(deltas[0]) == delta_decoder::outcome::applied);
+        CHECK(decoder.decode(deltas[1]) == delta_decoder::outcome::applied);
+        CHECK(decoder.decode(deltas[3]) == delta_decoder::outcome::lost);
+        CHECK(decoder.decode(deltas[5]) == delta_decoder::outcome::waiting);
+        CHECK(decoder.decode(deltas[4]) == delta_decoder::outcome::applied);
+        CHECK(decoder.decode(deltas[5]) == delta_decoder::outcome::applied);
+        CHECK(std::ranges::equal(decoder.record(), bytes));
+    }
+
+    SECTION("Records one after another") {
+        std::vector<uint8_t> joined;
+        for (size_t n = 0; n < 3; ++n) {
+            joined.insert(joined.end(), deltas[n].begin(), deltas[n].end());
+        }
+        std::span<const uint8_t> rest(joined);
+        for (size_t n = 0; n < 3; ++n) {
+            size_t length = 0;
+            CHECK(decoder.decode_first(rest, length) == delta_decoder::outcome::applied);
+            CHECK(length == deltas[n].size());
+            rest = rest.subspan(length);
+        }
+        CHECK(rest.empty());
+        size_t length = 0;
+        CHECK(decoder.decode_first(deltas[5], length) == delta_decoder::outcome::lost);
+        CHECK(length == deltas[5].size());
+    }
+
+    SECTION("Malformed records keep the last record") {
+        REQUIRE(decoder.decode(deltas[0]) == delta_decoder::outcome::applied);
+        const std::vector<uint8_t> kept(decoder.record().begin(), decoder.record().end());
+        auto truncated = deltas[1];
+        truncated.pop_back();
+        CHECK_THROWS_AS(decoder.decode(truncated), std::runtime_error);
+        auto longer = deltas[1];
+        longer.push_back(0);
+        CHECK_THROWS_AS(decoder.decode(longer), std::runtime_error);
+        auto bad_tag = deltas[0];
+        bad_tag[delta_header_size] = 7;
+        CHECK_THROWS_AS(decoder.decode(bad_tag), std::runtime_error);
+        CHECK_THROWS_AS(decoder.decode(std::vector<uint8_t>{2, 0, 0}), std::runtime_error);
+        CHECK(std::ranges::equal(decoder.record(), kept));
+        CHECK(decoder.decode(deltas[1]) == delta_decoder::outcome::applied);
+    }
+}
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+
+#include "frame_queue.hpp"
+
+namespace {
+
+std::vector<uint8_t> frame_of(uint8_t value, size_t size) {
+    return std::vector<uint8_t>(size, value);
+}
+
+std::vector<uint8_t> pop_front(frame_queue &queue) {
+    const auto frame = queue.front();
+    std::vector<uint8_t> copy(frame.begin(), frame.end());
+    queue.pop();
+    return copy;
+}
+
+} // namespace
+
+TEST_CASE("Frame queue hands frames back in order", "[frame_queue]") {
+    frame_queue queue;
+    REQUIRE(queue.empty());
+
+    queue.push(frame_of(1, 3));
+    queue.push(frame_of(2, 0));
+    queue.push(frame_of(3, 5));
+    REQUIRE(queue.size() == 3);
+
+    REQUIRE(pop_front(queue) == frame_of(1, 3));
+    REQUIRE(pop_front(queue) == frame_of(2, 0));
+
+    // Pushing after popping reclaims the space in front without disturbing what is queued
+    queue.push(frame_of(4, 2));
+    REQUIRE(pop_front(queue) == frame_of(3, 5));
+    REQUIRE(pop_front(queue) == frame_of(4, 2));
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("Frame queue stays in order when interleaving pushes and pops", "[frame_queue]") {
+    frame_queue queue;
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < round % 7; ++i, ++next_in) {
+            queue.push(frame_of(next_in, next_in % 11));
+        }
+        for (int i = 0; i < round % 5 && !queue.empty(); ++i, ++next_out) {
+            REQUIRE(pop_front(queue) == frame_of(next_out, next_out % 11));
+        }
+    }
+    while (!queue.empty()) {
+        REQUIRE(pop_front(queue) == frame_of(next_out, next_out % 11));
+        ++next_out;
+    }
+    REQUIRE(next_out == next_in);
+}
+
+TEST_CASE("Full frame queue drops the oldest frame", "[frame_queue]") {
+    frame_queue queue;
+    queue.set_max_frames(2);
+
+    REQUIRE(queue.push(frame_of(1, 1)));
+    REQUIRE(queue.push(frame_of(2, 2)));
+    REQUIRE_FALSE(queue.push(frame_of(3, 3)));
+    REQUIRE(queue.size() == 2);
+    REQUIRE(pop_front(queue) == frame_of(2, 2));
+    REQUIRE(pop_front(queue) == frame_of(3, 3));
+
+    SECTION("Lowering the limit drops the oldest frames") {
+        queue.push(frame_of(4, 1));
+        queue.push(frame_of(5, 1));
+        queue.set_max_frames(1);
+        REQUIRE(queue.size() == 1);
+        REQUIRE(pop_front(queue) == frame_of(5, 1));
+    }
+}
@@ -0,0 +1,118 @@
+#include <cstring>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "COBS.hpp"
+#include "SLIP.hpp"
+#include "framed_writer.hpp"
+
+namespace {
+
+std::vector<uint8_t> random_payload(size_t size, int special_one_in, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> special(0, special_one_in - 1);
+    std::vector<uint8_t> payload(size);
+    for (auto &b : payload) {
+        const int pick = special(rng);
+        b = pick == 0 ? 0x00 : pick == 1 ? SLIP_END : pick == 2 ? SLIP_ESC : static_cast<uint8_t>(byte(rng) | 1);
+    }
+    return payload;
+}
+
+// Writes the payload the way zpp::bits::out does: a piece at a time, growing the destination
+// ahead of the write position, and fitting it to size at the end.
+template <typename Writer>
+void serialise(Writer &writer, std::span<const uint8_t> payload, size_t piece_size) {
+    size_t position = 0;
+    while (position < payload.size()) {
+        const size_t n = std::min(piece_size, payload.size() - position);
+        if (writer.size() < position + n) {
+            writer.resize((position + n) * 3 / 2);
+        }
+        std::memcpy(writer.data() + position, payload.data() + position, n);
+        position += n;
+    }
+    writer.resize(position);
+}
+
+} // namespace
+
+TEST_CASE("COBS in-place encoder matches contiguous encoder", "[cobs]") {
+    const size_t size = GENERATE(0, 1, 253, 254, 255, 508, 509, 5000);
+    const int special_one_in = GENERATE(3, 300, 100000);
+    const auto payload = random_payload(size, special_one_in, static_cast<unsigned>(size));
+
+    std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+    expected.resize(cobs_encode_frame(payload, expected.data()));
+
+    const size_t offset = cobs_in_place_headroom(size);
+    std::vector<uint8_t> buffer(offset + size + 1);
+    std::ranges::copy(payload, buffer.begin() + static_cast<std::ptrdiff_t>(offset));
+    buffer.resize(cobs_encode_frame_in_place(buffer, offset));
+    REQUIRE(buffer == expected);
+}
+
+TEST_CASE("SLIP in-place encoder matches contiguous encoder", "[slip]") {
+    const size_t size = GENERATE(0, 1, 100, 5000);
+    const int special_one_in = GENERATE(3, 300, 100000);
+    const auto payload = random_payload(size, special_one_in, static_cast<unsigned>(size));
+
+    std::vector<uint8_t> expected(slip_encoded_length(payload));
+    slip_encode_frame(payload, expected.data());
+
+    std::vector<uint8_t> buffer(payload);
+    buffer.resize(expected.size());
+    REQUIRE(slip_encode_frame_in_place(buffer, size) == expected.size());
+    REQUIRE(buffer == expected);
+}
+
+TEST_CASE("Framed writer frames what is serialised into it", "[framed_writer]") {
+    const size_t size = GENERATE(0, 1, 254, 255, 5000);
+    const size_t piece_size = GENERATE(1, 8, 1000);
+    const auto payload = random_payload(size, 50, static_cast<unsigned>(size));
+
+    SECTION("COBS") {
+        std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+        expected.resize(cobs_encode_frame(payload, expected.data()));
+
+        framed_writer<cobs_framing> writer;
+        serialise(writer, payload, piece_size);
+        REQUIRE(writer.size() == size);
+        REQUIRE(writer.finish() == expected);
+
+        // Reusable for the next record
+        serialise(writer, payload, piece_size);
+        REQUIRE(writer.finish() == expected);
+    }
+
+    SECTION("COBS into a previous frame's buffer") {
+        std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+        expected.resize(cobs_encode_frame(payload, expected.data()));
+
+        std::vector<uint8_t> previous(random_payload(size + 300, 3, 1));
+        const uint8_t *allocation = previous.data();
+        framed_writer<cobs_framing> writer(std::move(previous));
+        writer.resize(size);
+        if (size) {
+            std::memcpy(writer.data(), payload.data(), size);
+        }
+        const auto frame = writer.finish();
+        REQUIRE(frame == expected);
+        CHECK(frame.data() == allocation);
+    }
+
+    SECTION("SLIP") {
+        std::vector<uint8_t> expected(slip_encoded_length(payload));
+        slip_encode_frame(payload, expected.data());
+
+        framed_writer<slip_framing> writer;
+        serialise(writer, payload, piece_size);
+        REQUIRE(writer.size() == size);
+        REQUIRE(writer.finish() == expected);
+    }
+}
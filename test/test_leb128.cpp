@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "CRC.hpp"
+#include "LEB128.hpp"
+#include "test_data_helpers.hpp"
+
+struct LEB128Data {
+    uint64_t value;
+    std::vector<uint8_t> encoded;
+};
+
+TEST_CASE("LEB128 values", "[leb128]") {
+    auto data = GENERATE(values<LEB128Data>({
+        {0, {0x00}},
+        {1, {0x01}},
+        {127, {0x7F}},
+        {128, {0x80, 0x01}},
+        {300, {0xAC, 0x02}},
+        {16383, {0xFF, 0x7F}},
+        {16384, {0x80, 0x80, 0x01}},
+        {UINT64_MAX, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01}},
+    }));
+
+    SECTION("Length") {
+        REQUIRE(leb128_length(data.value) == data.encoded.size());
+    }
+
+    SECTION("Encoding") {
+        std::vector<uint8_t> encoded(10);
+        encoded.resize(std::distance(encoded.begin(), leb128_encode(data.value, encoded.begin())));
+        REQUIRE(encoded == data.encoded);
+    }
+
+    SECTION("Decoding") {
+        const auto decoded = leb128_decode(data.encoded);
+        REQUIRE(decoded.has_value());
+        REQUIRE(decoded->value == data.value);
+        REQUIRE(decoded->length == data.encoded.size());
+    }
+
+    SECTION("Truncated input") {
+        REQUIRE_FALSE(leb128_decode(std::span(data.encoded).first(data.encoded.size() - 1)).has_value());
+    }
+}
+
+TEST_CASE("LEB128 framing", "[leb128]") {
+    const size_t size = GENERATE(0, 1, 127, 128, 300);
+    const auto payload = vec_from_range<int>(0, static_cast<int>(size));
+    std::vector<uint8_t> bytes(payload.begin(), payload.end());
+
+    std::vector<uint8_t> encoded(leb128_encoded_length(size));
+    REQUIRE(leb128_encode_frame(bytes.begin(), bytes.size(), encoded.begin()) == encoded.size());
+
+    SECTION("Piecemeal decoding") {
+        LEB128Decoder decoder;
+        std::vector<uint8_t> decoded;
+        for (const uint8_t byte : encoded) {
+            uint8_t decoded_byte;
+            if (decoder.process_byte(byte, &decoded_byte)) {
+                decoded.push_back(decoded_byte);
+            }
+            if (decoder.packet_complete()) {
+                break;
+            }
+        }
+        REQUIRE(decoder.packet_complete());
+        REQUIRE(decoded == bytes);
+    }
+
+    SECTION("Bulk decoding") {
+        const size_t chunk_size = GENERATE(1, 3, 1000);
+        std::vector<uint8_t> stream(encoded);
+        stream.insert(stream.end(), encoded.begin(), encoded.end());
+
+        LEB128Decoder decoder;
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+            const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+            decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+                frames.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == bytes);
+        REQUIRE(frames[1] == bytes);
+    }
+}
+
+TEST_CASE("LEB128 decoder resyncs after an implausible header", "[leb128]") {
+    LEB128Decoder decoder;
+    decoder.set_max_frame_length(16);
+
+    // 0x80 0x80 0x80 would announce a huge frame; 0x7F exceeds the limit outright
+    const std::vector<uint8_t> stream{0x80, 0x80, 0x80, 0x7F, 0x02, 0xAA, 0xBB};
+    std::vector<std::vector<uint8_t>> frames;
+    decoder.process(stream, [&frames](std::span<const uint8_t> frame) {
+        frames.emplace_back(frame.begin(), frame.end());
+    });
+
+    REQUIRE(frames.size() == 1);
+    REQUIRE(frames[0] == std::vector<uint8_t>{0xAA, 0xBB});
+}
+
+namespace {
+
+// Frames of random payloads 1 to 60 bytes long, each with a CRC-32C trailer
+std::vector<std::vector<uint8_t>> random_frames(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::vector<uint8_t>> payloads(count);
+    for (auto &payload : payloads) {
+        payload.resize(1 + rng() % 60);
+        for (auto &byte : payload) {
+            byte = static_cast<uint8_t>(rng());
+        }
+    }
+    return payloads;
+}
+
+std::vector<uint8_t> encode_with_crc(const std::vector<std::vector<uint8_t>> &payloads) {
+    std::vector<uint8_t> stream;
+    for (const auto &payload : payloads) {
+        CRC32C crc;
+        crc.update(payload.data(), payload.size());
+        std::vector<uint8_t> body(payload);
+        body.resize(payload.size() + CRC32C::size);
+        crc.write(body.begin() + static_cast<std::ptrdiff_t>(payload.size()));
+        leb128_encode(body.size(), std::back_inserter(stream));
+        stream.insert(stream.end(), body.begin(), body.end());
+    }
+    return stream;
+}
+
+std::vector<std::vector<uint8_t>> decode_with_crc(const std::vector<uint8_t> &stream, size_t chunk_size) {
+    LEB128Decoder decoder;
+    decoder.set_max_frame_length(64 + CRC32C::size);
+    CRC32C crc;
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        }, crc);
+    }
+    return frames;
+}
+
+// frames is payloads from some point on, give or take the frames in skipped
+void check_recovered(const std::vector<std::vector<uint8_t>> &frames,
+                     const std::vector<std::vector<uint8_t>> &payloads, size_t skipped) {
+    REQUIRE(frames.size() >= payloads.size() - skipped);
+    const auto tail = std::span(payloads).last(frames.size());
+    REQUIRE(std::ranges::equal(frames, tail));
+}
+
+} // namespace
+
+TEST_CASE("LEB128 decoder with a checksum resyncs after starting mid-frame", "[leb128]") {
+    const auto payloads = random_frames(40, 3);
+    const auto stream = encode_with_crc(payloads);
+    const size_t chunk_size = GENERATE(1, 5, 4096);
+
+    // Started a few bytes into the first frame's payload
+    const std::vector<uint8_t> joined(stream.begin() + 5, stream.end());
+    const auto frames = decode_with_crc(joined, chunk_size);
+    check_recovered(frames, payloads, 3);
+}
+
+TEST_CASE("LEB128 decoder with a checksum resyncs after a lost byte", "[leb128]") {
+    const auto payloads = random_frames(40, 4);
+    auto stream = encode_with_crc(payloads);
+    const size_t chunk_size = GENERATE(1, 5, 4096);
+    // A byte of the tenth frame, or its header, lost on the way
+    size_t lost = 0;
+    for (size_t i = 0; i < 9; ++i) {
+        lost += leb128_encoded_length(payloads[i].size() + CRC32C::size);
+    }
+    const size_t which = GENERATE(0, 1, 10);
+    stream.erase(stream.begin() + static_cast<std::ptrdiff_t>(lost + which));
+
+    const auto frames = decode_with_crc(stream, chunk_size);
+    // The first nine come out as sent, then those after the damage
+    REQUIRE(frames.size() >= 9);
+    REQUIRE(std::equal(frames.begin(), frames.begin() + 9, payloads.begin()));
+    const std::vector<std::vector<uint8_t>> after(frames.begin() + 9, frames.end());
+    const std::vector<std::vector<uint8_t>> rest(payloads.begin() + 10, payloads.end());
+    check_recovered(after, rest, 3);
+}
+
+TEST_CASE("LEB128 decoder counts a resync as one drop", "[leb128]") {
+    // Long frames give the hunt hundreds of plausible headers to try on the way back
+    std::vector<std::vector<uint8_t>> payloads(10, std::vector<uint8_t>(1000));
+    std::mt19937 rng(5);
+    for (auto &payload : payloads) {
+        for (auto &byte : payload) {
+            byte = static_cast<uint8_t>(rng());
+        }
+    }
+    auto stream = encode_with_crc(payloads);
+    const size_t chunk_size = GENERATE(1, 5, 4096, 100000);
+    // A payload byte of the fourth frame flipped
+    const size_t fourth = 3 * leb128_encoded_length(1000 + CRC32C::size);
+    stream[fourth + 500] ^= 0x01;
+
+    LEB128Decoder decoder;
+    decoder.set_max_frame_length(1000 + CRC32C::size);
+    CRC32C crc;
+    std::vector<std::vector<uint8_t>> frames;
+    size_t dropped = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        dropped += decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        }, crc);
+    }
+
+    REQUIRE(dropped == 1);
+    REQUIRE(frames.size() == 9);
+    REQUIRE(std::equal(frames.begin(), frames.begin() + 3, payloads.begin()));
+    REQUIRE(std::equal(frames.begin() + 3, frames.end(), payloads.begin() + 4));
+}
@@ -0,0 +1,226 @@
+#include <random>
+#include <span>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+#include "catch2/generators/catch_generators_range.hpp"
+
+#include "CRC.hpp"
+#include "midibitpack.hpp"
+
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+// The packing spelled out bit by bit, for the fast paths to agree with
+std::vector<uint8_t> reference_pack(const std::vector<uint8_t> &input) {
+    std::vector<uint8_t> packed;
+    for (size_t i = 0; i < input.size(); i += 7) {
+        const size_t n = std::min<size_t>(7, input.size() - i);
+        uint8_t header = 0;
+        for (size_t j = 0; j < n; ++j) {
+            if (input[i + j] & 0x80) {
+                header |= static_cast<uint8_t>(1 << j);
+            }
+        }
+        packed.push_back(header);
+        for (size_t j = 0; j < n; ++j) {
+            packed.push_back(input[i + j] & 0x7F);
+        }
+    }
+    return packed;
+}
+
+// Feeds stream to decoder chunk_size bytes at a time, collecting the frames and dropped count
+template <typename Checksum = no_checksum>
+size_t decode_in_chunks(MIDISysExDecoder &decoder, const std::vector<uint8_t> &stream, size_t chunk_size,
+                        std::vector<std::vector<uint8_t>> &frames, Checksum &&checksum = {}) {
+    size_t dropped = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        dropped += decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        }, checksum);
+    }
+    return dropped;
+}
+
+void append_frame(std::vector<uint8_t> &stream, const std::vector<uint8_t> &payload) {
+    const size_t offset = stream.size();
+    stream.resize(offset + midi_sysex_encoded_length(payload.size()));
+    stream.resize(offset + midi_sysex_encode_frame(payload, stream.data() + offset));
+}
+
+} // namespace
+
+TEST_CASE("MIDI 7-bit packing", "[midibitpack]") {
+    const size_t size = GENERATE(0, 1, 6, 7, 8, 13, 14, 15, 16, 27, 28, 29, 100, 4096);
+    const auto payload = random_bytes(size, static_cast<unsigned>(size));
+    const auto expected = reference_pack(payload);
+
+    std::vector<uint8_t> packed(midi_packed_length(size));
+    REQUIRE(packed.size() == expected.size());
+    REQUIRE(midi_pack(payload, packed.data()) == packed.size());
+    REQUIRE(packed == expected);
+    REQUIRE(midi_unpacked_length(packed.size()) == size);
+
+    SECTION("Unpacking") {
+        std::vector<uint8_t> unpacked(size);
+        REQUIRE(midi_unpack(packed, unpacked.data()) == size);
+        REQUIRE(unpacked == payload);
+    }
+
+    SECTION("Unpacking in place") {
+        auto buffer = packed;
+        buffer.resize(midi_unpack(buffer, buffer.data()).value());
+        REQUIRE(buffer == payload);
+    }
+
+    SECTION("Unpacking rejects bytes with the high bit set") {
+        std::vector<uint8_t> unpacked(size);
+        for (size_t at = 0; at < packed.size(); at += 5) {
+            auto corrupt = packed;
+            corrupt[at] |= 0x80;
+            REQUIRE_FALSE(midi_unpack(corrupt, unpacked.data()));
+        }
+    }
+}
+
+TEST_CASE("MIDI unpacking rejects a lone header byte", "[midibitpack]") {
+    const std::vector<uint8_t> packed{0x7F, 1, 2, 3, 4, 5, 6, 7, 0x01};
+    std::vector<uint8_t> unpacked(8);
+    REQUIRE_FALSE(midi_unpack(packed, unpacked.data()));
+}
+
+TEST_CASE("MIDI SysEx encoder packs pieces as one payload", "[midibitpack]") {
+    const auto payload = random_bytes(100, 7);
+    std::vector<uint8_t> expected;
+    append_frame(expected, payload);
+    REQUIRE(expected.front() == SYSEX_START);
+    REQUIRE(expected[1] == SYSEX_NON_COMMERCIAL_ID);
+    REQUIRE(expected.back() == SYSEX_END);
+
+    const size_t piece = GENERATE(1, 3, 7, 9, 50);
+    std::vector<uint8_t> encoded(midi_sysex_encoded_length(payload.size()));
+    MIDISysExEncoder encoder(encoded.data());
+    for (size_t offset = 0; offset < payload.size(); offset += piece) {
+        encoder.push(std::span(payload).subspan(offset, std::min(piece, payload.size() - offset)));
+    }
+    REQUIRE(encoder.finish() == encoded.size());
+    REQUIRE(encoded == expected);
+}
+
+TEST_CASE("MIDI SysEx decoder", "[midibitpack]") {
+    const std::vector<std::vector<uint8_t>> payloads{random_bytes(0, 1), random_bytes(1, 2), random_bytes(7, 3),
+                                                     random_bytes(30, 4), random_bytes(300, 5)};
+    std::vector<uint8_t> stream;
+    for (const auto &payload : payloads) {
+        append_frame(stream, payload);
+    }
+    const size_t chunk_size = GENERATE(1, 2, 5, 9, 17, 1000);
+
+    SECTION("Frames across chunk boundaries") {
+        MIDISysExDecoder decoder;
+        std::vector<std::vector<uint8_t>> frames;
+        REQUIRE(decode_in_chunks(decoder, stream, chunk_size, frames) == 0);
+        REQUIRE(frames == payloads);
+    }
+
+    SECTION("Byte by byte") {
+        MIDISysExDecoder decoder;
+        std::vector<std::vector<uint8_t>> frames(1);
+        for (const uint8_t byte : stream) {
+            uint8_t output;
+            if (decoder.process_byte(byte, &output)) {
+                frames.back().push_back(output);
+            }
+            if (decoder.packet_complete()) {
+                frames.emplace_back();
+            }
+        }
+        frames.pop_back();
+        REQUIRE(frames == payloads);
+    }
+
+    SECTION("Real-time bytes interleaved") {
+        std::vector<uint8_t> interleaved;
+        for (size_t i = 0; i < stream.size(); ++i) {
+            if (i % 11 == 3) {
+                interleaved.push_back(0xF8); // timing clock
+            }
+            interleaved.push_back(stream[i]);
+        }
+        MIDISysExDecoder decoder;
+        std::vector<std::vector<uint8_t>> frames;
+        REQUIRE(decode_in_chunks(decoder, interleaved, chunk_size, frames) == 0);
+        REQUIRE(frames == payloads);
+    }
+
+    SECTION("Other manufacturers and channel messages are skipped") {
+        std::vector<uint8_t> mixed{0x90, 0x3C, 0x40, SYSEX_START, 0x41, 0x10, 0x20, SYSEX_END};
+        mixed.insert(mixed.end(), stream.begin(), stream.end());
+        mixed.insert(mixed.end(), {0xB0, 0x07, 0x64});
+        MIDISysExDecoder decoder;
+        std::vector<std::vector<uint8_t>> frames;
+        REQUIRE(decode_in_chunks(decoder, mixed, chunk_size, frames) == 0);
+        REQUIRE(frames == payloads);
+    }
+}
+
+TEST_CASE("MIDI SysEx decoder drops damaged frames", "[midibitpack]") {
+    const auto good = random_bytes(20, 11);
+    const size_t chunk_size = GENERATE(range(size_t{1}, size_t{12}));
+    MIDISysExDecoder decoder;
+    decoder.set_max_frame_length(24);
+
+    std::vector<uint8_t> stream;
+    append_frame(stream, good);
+    // Cut short by a note on
+    append_frame(stream, good);
+    stream[stream.size() - 4] = 0x90;
+    // Ending on a lone header byte
+    stream.insert(stream.end(), {SYSEX_START, SYSEX_NON_COMMERCIAL_ID, 0x00, 1, 2, 3, 4, 5, 6, 7, 0x00, SYSEX_END});
+    // Restarted before the end
+    stream.insert(stream.end(), {SYSEX_START, SYSEX_NON_COMMERCIAL_ID, 0x00, 0x01});
+    // Longer than the maximum
+    append_frame(stream, random_bytes(25, 12));
+    append_frame(stream, good);
+
+    std::vector<std::vector<uint8_t>> frames;
+    REQUIRE(decode_in_chunks(decoder, stream, chunk_size, frames) == 4);
+    REQUIRE(frames.size() == 2);
+    REQUIRE(frames[0] == good);
+    REQUIRE(frames[1] == good);
+}
+
+TEST_CASE("MIDI SysEx decoder checks a checksum trailer", "[midibitpack]") {
+    const auto payload = random_bytes(50, 13);
+    auto framed = payload;
+    CRC16 crc;
+    crc.update(payload.data(), payload.size());
+    framed.resize(payload.size() + CRC16::size);
+    crc.write(framed.begin() + static_cast<std::ptrdiff_t>(payload.size()));
+
+    std::vector<uint8_t> stream;
+    append_frame(stream, framed);
+    auto corrupt = framed;
+    corrupt[10] ^= 0x04;
+    append_frame(stream, corrupt);
+    append_frame(stream, framed);
+
+    const size_t chunk_size = GENERATE(1, 7, 64);
+    MIDISysExDecoder decoder;
+    std::vector<std::vector<uint8_t>> frames;
+    REQUIRE(decode_in_chunks(decoder, stream, chunk_size, frames, CRC16{}) == 1);
+    REQUIRE(frames.size() == 2);
+    REQUIRE(frames[0] == payload);
+    REQUIRE(frames[1] == payload);
+}
@@ -0,0 +1,131 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "packed_float.hpp"
+
+using namespace bytestream::detail;
+
+namespace {
+
+template <typename Element>
+std::vector<Element> from_bytes(const std::vector<uint8_t> &bytes) {
+    std::vector<Element> elements(bytes.size() / sizeof(Element));
+    if (!bytes.empty()) {
+        std::memcpy(elements.data(), bytes.data(), bytes.size());
+    }
+    return elements;
+}
+
+// Every count either side of the vector widths, including a scalar tail
+const std::vector<size_t> counts{0, 1, 7, 8, 9, 17, 100};
+
+template <typename Raw>
+void check_fixed_point(float factor) {
+    const size_t count = GENERATE_REF(from_range(counts));
+    const float lowest = static_cast<float>(std::numeric_limits<Raw>::lowest()) / factor;
+    const float highest = static_cast<float>(std::numeric_limits<Raw>::max()) / factor;
+
+    std::vector<float> numbers(count);
+    for (size_t i = 0; i < count; ++i) {
+        numbers[i] = lowest + (highest - lowest) * static_cast<float>(i) / static_cast<float>(count);
+    }
+    if (count > 3) {
+        numbers[0] = highest * 2;
+        numbers[1] = lowest * 2 - 1;
+        numbers[2] = std::numeric_limits<float>::quiet_NaN();
+        numbers[3] = 0.5f / factor; // a tie, to even
+    }
+
+    std::vector<uint8_t> packed(count * sizeof(Raw));
+    floats_to_fixed<Raw>(packed.data(), numbers.data(), count, factor);
+    const auto raw = from_bytes<Raw>(packed);
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(raw[i] == float_to_fixed<Raw>(numbers[i], factor));
+    }
+    if (count > 3) {
+        CHECK(raw[0] == std::numeric_limits<Raw>::max());
+        CHECK(raw[1] == std::numeric_limits<Raw>::lowest());
+        CHECK(raw[2] == std::numeric_limits<Raw>::lowest());
+        CHECK(raw[3] == 0);
+    }
+
+    std::vector<float> unpacked(count);
+    fixed_to_floats<Raw>(unpacked.data(), packed.data(), count, 1 / factor);
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(unpacked[i] == static_cast<float>(raw[i]) / factor);
+        if (i > 3) {
+            CHECK(std::abs(unpacked[i] - numbers[i]) <= 0.5f / factor * 1.0001f);
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("Half floats of special values", "[packed_float]") {
+    CHECK(float_to_half(0.0f) == 0x0000);
+    CHECK(float_to_half(-0.0f) == 0x8000);
+    CHECK(float_to_half(1.0f) == 0x3C00);
+    CHECK(float_to_half(-2.0f) == 0xC000);
+    CHECK(float_to_half(65504.0f) == 0x7BFF);
+    CHECK(float_to_half(65520.0f) == 0x7C00); // rounds up past the largest half
+    CHECK(float_to_half(std::numeric_limits<float>::infinity()) == 0x7C00);
+    CHECK((float_to_half(std::numeric_limits<float>::quiet_NaN()) & 0x7FFF) > 0x7C00);
+    CHECK(float_to_half(std::ldexp(1.0f, -24)) == 0x0001); // smallest subnormal
+    CHECK(float_to_half(std::ldexp(1.0f, -26)) == 0x0000);
+    CHECK(float_to_half(1.0f + std::ldexp(1.0f, -11)) == 0x3C00); // a tie, to even
+    CHECK(float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3C02);
+
+    CHECK(half_to_float(0x3C00) == 1.0f);
+    CHECK(half_to_float(0x0001) == std::ldexp(1.0f, -24));
+    CHECK(half_to_float(0xFC00) == -std::numeric_limits<float>::infinity());
+    CHECK(std::isnan(half_to_float(0x7E00)));
+}
+
+TEST_CASE("Half float arrays round trip", "[packed_float]") {
+    // Every half there is, back and forth
+    std::vector<uint8_t> halves(0x10000 * 2);
+    for (uint32_t h = 0; h < 0x10000; ++h) {
+        const auto half = static_cast<uint16_t>(h);
+        std::memcpy(halves.data() + h * 2, &half, 2);
+    }
+    std::vector<float> floats(0x10000);
+    halves_to_floats(floats.data(), halves.data(), floats.size());
+    std::vector<uint8_t> again(halves.size());
+    floats_to_halves(again.data(), floats.data(), floats.size());
+    const auto original = from_bytes<uint16_t>(halves);
+    const auto round_tripped = from_bytes<uint16_t>(again);
+    for (size_t h = 0; h < original.size(); ++h) {
+        if (std::isnan(floats[h])) {
+            CHECK(std::isnan(half_to_float(round_tripped[h])));
+        } else {
+            CHECK(round_tripped[h] == original[h]);
+        }
+    }
+}
+
+TEST_CASE("Half float arrays round as single halves do", "[packed_float]") {
+    const size_t count = GENERATE_REF(from_range(counts));
+    std::vector<float> numbers(count);
+    for (size_t i = 0; i < count; ++i) {
+        numbers[i] = std::ldexp(static_cast<float>(i) * 1.37f - 20, static_cast<int>(i % 40) - 25);
+    }
+    std::vector<uint8_t> packed(count * 2);
+    floats_to_halves(packed.data(), numbers.data(), count);
+    const auto vector_halves = from_bytes<uint16_t>(packed);
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(vector_halves[i] == float_to_half(numbers[i]));
+    }
+}
+
+TEST_CASE("Fixed point arrays", "[packed_float]") {
+    SECTION("q7") { check_fixed_point<int8_t>(128.0f); }
+    SECTION("q15, scaled") { check_fixed_point<int16_t>(32768.0f / 2.5f); }
+    SECTION("uq8") { check_fixed_point<uint8_t>(256.0f); }
+    SECTION("uq16, scaled") { check_fixed_point<uint16_t>(65536.0f / 100); }
+}
@@ -0,0 +1,88 @@
+#include <random>
+#include <span>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "COBS.hpp"
+#include "parallel_cobs.hpp"
+
+namespace {
+
+// Roughly one byte in zero_one_in is zero; 0 means none, 1 means all
+std::vector<uint8_t> random_payload(size_t size, unsigned zero_one_in, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> payload(size);
+    for (auto &byte : payload) {
+        byte = static_cast<uint8_t>(rng() % 255 + 1);
+        if (zero_one_in && rng() % zero_one_in == 0) {
+            byte = 0;
+        }
+    }
+    return payload;
+}
+
+} // namespace
+
+TEST_CASE("COBS exact encoded length", "[cobs]") {
+    const size_t size = GENERATE(0, 1, 253, 254, 255, 508, 5000);
+    const unsigned zero_one_in = GENERATE(0u, 1u, 3u, 300u);
+    const auto payload = random_payload(size, zero_one_in, static_cast<unsigned>(size));
+
+    std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+    REQUIRE(cobs_encoded_length(payload) == cobs_encode_frame(payload, encoded.data()));
+}
+
+TEST_CASE("Parallel COBS matches sequential COBS", "[cobs]") {
+    worker_pool pool(4);
+    const size_t segment_size = GENERATE(300, 1000, 4096);
+    const unsigned zero_one_in = GENERATE(0u, 1u, 2u, 200u, 1000u, 100000u);
+    const size_t size = GENERATE(1000, 65536, 100003);
+    const auto payload = random_payload(size, zero_one_in, static_cast<unsigned>(size + zero_one_in));
+
+    std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+    expected.resize(cobs_encode_frame(payload, expected.data()));
+
+    SECTION("Encoding") {
+        std::vector<uint8_t> encoded(cobs_encoded_max_length(size));
+        encoded.resize(cobs_encode_frame_parallel(payload, encoded.data(), pool, segment_size));
+        REQUIRE(encoded == expected);
+    }
+
+    SECTION("Decoding") {
+        std::vector<uint8_t> decoded(size);
+        const auto decoded_size = cobs_decode_frame_parallel(expected, decoded.data(), pool, segment_size);
+        REQUIRE(decoded_size == size);
+        REQUIRE(decoded == payload);
+    }
+
+    SECTION("Decoding rejects an embedded zero") {
+        auto corrupted = expected;
+        corrupted[corrupted.size() / 2 | 1] = 0;
+        std::vector<uint8_t> sequential(size + 1);
+        std::vector<uint8_t> parallel(size + 1);
+        const auto sequential_size = cobs_decode_frame(std::span(corrupted), sequential.data());
+        const auto parallel_size = cobs_decode_frame_parallel(corrupted, parallel.data(), pool, segment_size);
+        REQUIRE(parallel_size.has_value() == sequential_size.has_value());
+    }
+}
+
+TEST_CASE("Parallel COBS with zeros on block boundaries", "[cobs]") {
+    worker_pool pool(3);
+    std::vector<uint8_t> payload(20000, 0x55);
+    for (size_t i = 254; i < payload.size(); i += 255) {
+        payload[i] = 0;
+    }
+
+    std::vector<uint8_t> expected(cobs_encoded_max_length(payload.size()));
+    expected.resize(cobs_encode_frame(payload, expected.data()));
+
+    std::vector<uint8_t> encoded(cobs_encoded_max_length(payload.size()));
+    encoded.resize(cobs_encode_frame_parallel(payload, encoded.data(), pool, 1000));
+    REQUIRE(encoded == expected);
+
+    std::vector<uint8_t> decoded(payload.size());
+    REQUIRE(cobs_decode_frame_parallel(expected, decoded.data(), pool, 1000) == payload.size());
+    REQUIRE(decoded == payload);
+}
@@ -1,134 +1,146 @@
+#include <stdexcept>
+#include <string>
 #include <vector>
 
-#include "type_info.hpp"
-
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/generators/catch_generators.hpp"
 
-namespace Catch {
-    template<>
-    struct StringMaker<TypeInfo> {
-        static std::string convert( TypeInfo const& value ) {
-            return value.to_string();
-        }
-    };
-}
-struct TypeInfoTestData {
-    std::string token;
-    TypeInfo expected;
-};
-
-TEST_CASE("Expression evaluator", "") {
-    // SECTION("Simple expressions") {
-    //     REQUIRE(evaluate_expression("1") == 1);
-    //     REQUIRE(evaluate_expression("2") == 2);
-    //     REQUIRE(evaluate_expression("1 + 1") == 2);
-    // }
-
-    SECTION("Operator precedence") {
-        REQUIRE(ExpressionEvaluator("1+2*3").evaluate() == 7);
-        REQUIRE(ExpressionEvaluator("1+2/3").evaluate() == 1);
-        REQUIRE(ExpressionEvaluator("1-2+3").evaluate() == 2);
-        REQUIRE(ExpressionEvaluator("1-2*3").evaluate() == 1);
-    }
-
-    SECTION("Parentheses") {
-        REQUIRE(ExpressionEvaluator("(1+2)*3").evaluate() == 9);
-        REQUIRE(ExpressionEvaluator("1+(2*3)").evaluate() == 7);
-        REQUIRE(ExpressionEvaluator("(1+2)/3").evaluate() == 1);
-        REQUIRE(ExpressionEvaluator("1-(2+3)").evaluate() == 0);
-    }
+#include "type_info.hpp"
 
-    SECTION("Invalid expressions") {
-        REQUIRE_THROWS(ExpressionEvaluator("1+2"));
-        REQUIRE_THROWS(ExpressionEvaluator("a"));
-        REQUIRE_THROWS(ExpressionEvaluator("[]"));
-        REQUIRE_THROWS(ExpressionEvaluator("(1+2"));
-        REQUIRE_THROWS(ExpressionEvaluator("1 + 2"));
-        REQUIRE_THROWS(ExpressionEvaluator("1.2"));
-    }
-}
+using primitive_type = type_info::primitive_type;
 
 TEST_CASE("Parse typeinfo", "[parse_typeinfo]") {
 
-    SECTION("Scalar types") {
-        REQUIRE(parse_type_info("u8") == TypeInfo::create_scalar(PrimitiveType::u8));
-        REQUIRE(parse_type_info("u16") == TypeInfo::create_scalar(PrimitiveType::u16));
-        REQUIRE(parse_type_info("u32") == TypeInfo::create_scalar(PrimitiveType::u32));
-        REQUIRE(parse_type_info("u64") == TypeInfo::create_scalar(PrimitiveType::u64));
-        REQUIRE(parse_type_info("i8") == TypeInfo::create_scalar(PrimitiveType::i8));
-        REQUIRE(parse_type_info("i16") == TypeInfo::create_scalar(PrimitiveType::i16));
-        REQUIRE(parse_type_info("i32") == TypeInfo::create_scalar(PrimitiveType::i32));
-        REQUIRE(parse_type_info("i64") == TypeInfo::create_scalar(PrimitiveType::i64));
-        REQUIRE(parse_type_info("f32") == TypeInfo::create_scalar(PrimitiveType::f32));
-        REQUIRE(parse_type_info("f64") == TypeInfo::create_scalar(PrimitiveType::f64));
+    SECTION("Scalar and array types") {
+        const type_info scalar("f32");
+        REQUIRE(scalar.type == primitive_type::f32);
+        REQUIRE(scalar.is_scalar());
+        REQUIRE(scalar.to_string() == "f32");
+
+        const type_info fixed("i16[10]");
+        REQUIRE(fixed.type == primitive_type::i16);
+        REQUIRE(fixed.size == 10);
+        REQUIRE(fixed.to_string() == "i16[10]");
+
+        const type_info variable("u8[]");
+        REQUIRE(variable.type == primitive_type::u8);
+        REQUIRE(variable.is_variable_length());
+        REQUIRE(variable.to_string() == "u8[]");
     }
 
-    SECTION("Variable array types") {
-        REQUIRE(parse_type_info("u8[]") == TypeInfo::create_variable_array(PrimitiveType::u8));
-        REQUIRE(parse_type_info("u16[]") == TypeInfo::create_variable_array(PrimitiveType::u16));
-        REQUIRE(parse_type_info("u32[]") == TypeInfo::create_variable_array(PrimitiveType::u32));
-        REQUIRE(parse_type_info("u64[]") == TypeInfo::create_variable_array(PrimitiveType::u64));
-        REQUIRE(parse_type_info("i8[]") == TypeInfo::create_variable_array(PrimitiveType::i8));
-        REQUIRE(parse_type_info("i16[]") == TypeInfo::create_variable_array(PrimitiveType::i16));
-        REQUIRE(parse_type_info("i32[]") == TypeInfo::create_variable_array(PrimitiveType::i32));
-        REQUIRE(parse_type_info("i64[]") == TypeInfo::create_variable_array(PrimitiveType::i64));
-        REQUIRE(parse_type_info("f32[]") == TypeInfo::create_variable_array(PrimitiveType::f32));
-        REQUIRE(parse_type_info("f64[]") == TypeInfo::create_variable_array(PrimitiveType::f64));
+    SECTION("Bit fields") {
+        const std::string sign = GENERATE("u", "i");
+        const unsigned width = GENERATE(range(1u, 32u));
+        const std::string name = sign + std::to_string(width);
+        const type_info info(name);
+        REQUIRE(info.to_string() == name);
+        if (width == 8 || width == 16) {
+            // The whole byte types
+            REQUIRE_FALSE(info.is_bit_field());
+            REQUIRE(info.bit_width() == 0);
+        } else {
+            REQUIRE(info.is_bit_field());
+            REQUIRE(info.is_signed_bit_field() == (sign == "i"));
+            REQUIRE(info.bit_width() == width);
+            REQUIRE(info.element_bytes() == 0);
+        }
     }
 
-    SECTION("Fixed array types") {
-        REQUIRE(parse_type_info("u8[1]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 1));
-        REQUIRE(parse_type_info("u16[2]") == TypeInfo::create_fixed_array(PrimitiveType::u16, 2));
-        REQUIRE(parse_type_info("u32[3]") == TypeInfo::create_fixed_array(PrimitiveType::u32, 3));
-        REQUIRE(parse_type_info("u64[4]") == TypeInfo::create_fixed_array(PrimitiveType::u64, 4));
-        REQUIRE(parse_type_info("i8[5]") == TypeInfo::create_fixed_array(PrimitiveType::i8, 5));
-        REQUIRE(parse_type_info("i16[6]") == TypeInfo::create_fixed_array(PrimitiveType::i16, 6));
-        REQUIRE(parse_type_info("i32[7]") == TypeInfo::create_fixed_array(PrimitiveType::i32, 7));
-        REQUIRE(parse_type_info("i64[8]") == TypeInfo::create_fixed_array(PrimitiveType::i64, 8));
-        REQUIRE(parse_type_info("f32[9]") == TypeInfo::create_fixed_array(PrimitiveType::f32, 9));
-        REQUIRE(parse_type_info("f64[10]") == TypeInfo::create_fixed_array(PrimitiveType::f64, 10));
+    SECTION("Flags") {
+        const type_info flag("b1");
+        REQUIRE(flag.is_bit_field());
+        REQUIRE_FALSE(flag.is_signed_bit_field());
+        REQUIRE(flag.bit_width() == 1);
     }
 
-    SECTION("Fixed array types with expressions") {
-        SECTION("Simple expressions") {
-            REQUIRE(parse_type_info("u8[1+1]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 2));
-            REQUIRE(parse_type_info("u8[2*2]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 4));
-            REQUIRE(parse_type_info("u8[3/3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 1));
-            REQUIRE(parse_type_info("u8[4-1]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 3));
-        }
+    SECTION("Varints") {
+        const std::string name = GENERATE("v32", "v64", "z32", "z64");
+        const type_info info(name + "[3]");
+        REQUIRE(info.is_varint());
+        REQUIRE_FALSE(info.is_bit_field());
+        REQUIRE(info.to_string() == name + "[3]");
+        REQUIRE(info.element_bytes() == 0);
+        // The most three of them can take
+        REQUIRE(info.size_bytes() == (name.ends_with("32") ? 15 : 30));
+    }
 
-        SECTION("Operator precedence") {
-            REQUIRE(parse_type_info("u8[1+2*3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 7));
-            REQUIRE(parse_type_info("u8[1+2/3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 1));
-            REQUIRE(parse_type_info("u8[1-2+3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 2));
-            REQUIRE(parse_type_info("u8[1-2*3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 1));
-        }
+    SECTION("Fixed point scale") {
+        const type_info info("q15(2.5)[4]");
+        REQUIRE(info.type == primitive_type::q15);
+        REQUIRE(info.scale == 2.5);
+        REQUIRE(info.size == 4);
+        REQUIRE(info.is_fixed_point());
+        REQUIRE(info.fraction_bits() == 15);
+        REQUIRE(info.to_string() == "q15(2.5)[4]");
+
+        const type_info unscaled("uq8");
+        REQUIRE(unscaled.scale == 1);
+        REQUIRE(unscaled.fraction_bits() == 8);
+        REQUIRE(unscaled.to_string() == "uq8");
+    }
 
-        SECTION("Parentheses") {
-            REQUIRE(parse_type_info("u8[(1+2)*3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 9));
-            REQUIRE(parse_type_info("u8[1+(2*3)]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 7));
-            REQUIRE(parse_type_info("u8[(1+2)/3]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 1));
-            REQUIRE(parse_type_info("u8[1-(2+3)]") == TypeInfo::create_fixed_array(PrimitiveType::u8, 0));
-        }
+    SECTION("Invalid scales") {
+        REQUIRE_THROWS_AS(type_info("u8(2)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("f32(2)[4]"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7(0)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7(-1)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7(inf)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7(one)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7(1.5x)"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("q7()"), std::runtime_error);
+    }
+
+    SECTION("Invalid types") {
+        REQUIRE_THROWS_AS(type_info("int"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("u0"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("u32[0]"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("u8[1+1]"), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info(""), std::runtime_error);
+        REQUIRE_THROWS_AS(type_info("[1]"), std::runtime_error);
+    }
+}
 
-        SECTION("Invalid expressions") {
-            REQUIRE_THROWS(parse_type_info("u8[1+2"));
-            REQUIRE_THROWS(parse_type_info("u8[a]"));
-            REQUIRE_THROWS(parse_type_info("u8[[]"));
-            REQUIRE_THROWS(parse_type_info("u8[(1+2]"));
-            REQUIRE_THROWS(parse_type_info("u8[1 + 2]"));
+TEST_CASE("Type sizes", "[parse_typeinfo]") {
 
-        }
+    SECTION("Whole byte fields") {
+        REQUIRE(type_info("u8").size_bytes() == 1);
+        REQUIRE(type_info("f16[3]").size_bytes() == 6);
+        REQUIRE(type_info("q15(2)[3]").size_bytes() == 6);
+        REQUIRE(type_info("f64[2]").size_bytes() == 16);
+        REQUIRE(type_info("f64[2]").size_bits() == 128);
+        REQUIRE(type_info("i32[5]").element_bytes() == 4);
     }
 
-    SECTION("Invalid types") {
-        REQUIRE_THROWS(parse_type_info("int"));
-        REQUIRE_THROWS(parse_type_info(""));
-        REQUIRE_THROWS(parse_type_info(" "));
-        REQUIRE_THROWS(parse_type_info("[]"));
-        REQUIRE_THROWS(parse_type_info("[1]"));
-        REQUIRE_THROWS(parse_type_info("[0]"));
+    SECTION("Bit fields on their own are padded to a byte") {
+        REQUIRE(type_info("b1").size_bits() == 1);
+        REQUIRE(type_info("b1").size_bytes() == 1);
+        REQUIRE(type_info("u3[5]").size_bits() == 15);
+        REQUIRE(type_info("u3[5]").size_bytes() == 2);
+        REQUIRE(type_info("i31[2]").size_bytes() == 8);
     }
 
-}
\ No newline at end of file
+    SECTION("Schemas") {
+        const auto schema_bytes = [](const std::vector<std::string> &types) {
+            std::vector<type_info> schema;
+            for (const std::string &type : types) {
+                schema.emplace_back(type);
+            }
+            return type_info::schema_size_bytes(schema);
+        };
+        REQUIRE(schema_bytes({}) == 0);
+        REQUIRE(schema_bytes({"u8", "f32[2]"}) == 9);
+        // One group of 20 bits
+        REQUIRE(schema_bytes({"b1", "u4", "i3", "u12"}) == 3);
+        // A whole byte field between bit fields ends the group before it
+        REQUIRE(schema_bytes({"u3", "u8", "u3"}) == 3);
+        REQUIRE(schema_bytes({"u3", "u5", "u8"}) == 2);
+        // Variable fields count as their count alone, and start a new group
+        REQUIRE(schema_bytes({"u4", "u8[]"}) == 5);
+        REQUIRE(schema_bytes({"u4", "u4[]", "u4"}) == 6);
+        REQUIRE(schema_bytes({"f32[]", "f32[]"}) == 8);
+        // Varints at their shortest, a byte an element
+        REQUIRE(schema_bytes({"v32"}) == 1);
+        REQUIRE(schema_bytes({"v32", "z64[4]"}) == 5);
+        REQUIRE(schema_bytes({"u4", "v64[2]", "u4"}) == 4);
+    }
+}
@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "serialisation_plan.hpp"
+
+namespace {
+
+constexpr bool native_big = std::endian::native == std::endian::big;
+
+serialisation_plan::strided_source rows_source(size_t field, const uint8_t *data, size_t bytes, size_t row_length,
+                                               size_t rows, ptrdiff_t element_size, ptrdiff_t row_stride) {
+    serialisation_plan::strided_source source;
+    source.field = field;
+    source.data = data;
+    source.bytes = bytes;
+    source.dimcount = 2;
+    source.dim[0] = row_length;
+    source.dim[1] = rows;
+    source.stride[0] = element_size;
+    source.stride[1] = row_stride;
+    return source;
+}
+
+} // namespace
+
+TEST_CASE("Serialisation plan writes fields back to back", "[serialisation_plan]") {
+    std::vector<uint8_t> a{0x01, 0x02};
+    std::vector<uint16_t> b{0x0304};
+    std::vector<uint32_t> c{0x05060708, 0x090A0B0C};
+    std::vector<int8_t> d{-1};
+
+    SECTION("Big endian") {
+        serialisation_plan plan(!native_big);
+        plan.add_fixed(a.data(), a.size());
+        plan.add_fixed(b.data(), b.size());
+        plan.add_variable(c);
+        plan.add_fixed(d.data(), d.size());
+
+        std::vector<uint8_t> out;
+        plan.write(out);
+        REQUIRE(out == std::vector<uint8_t>{0x01, 0x02, 0x03, 0x04, 0x00, 0x00, 0x00, 0x02,
+                                            0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0xFF});
+    }
+
+    SECTION("Little endian") {
+        serialisation_plan plan(native_big);
+        plan.add_fixed(a.data(), a.size());
+        plan.add_fixed(b.data(), b.size());
+        plan.add_variable(c);
+        plan.add_fixed(d.data(), d.size());
+
+        std::vector<uint8_t> out;
+        plan.write(out);
+        REQUIRE(out == std::vector<uint8_t>{0x01, 0x02, 0x04, 0x03, 0x02, 0x00, 0x00, 0x00,
+                                            0x08, 0x07, 0x06, 0x05, 0x0C, 0x0B, 0x0A, 0x09, 0xFF});
+    }
+}
+
+TEST_CASE("Serialisation plan reads back what it writes", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+
+    std::vector<double> scalar{1.5};
+    std::vector<int64_t> fixed{-2, 3, -4};
+    std::vector<float> variable{0.25f, -8.0f};
+    std::vector<uint16_t> empty;
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(scalar.data(), scalar.size());
+    plan.add_variable(variable);
+    plan.add_fixed(fixed.data(), fixed.size());
+    plan.add_variable(empty);
+
+    std::vector<uint8_t> bytes;
+    plan.write(bytes);
+    REQUIRE(bytes.size() == plan.size());
+    REQUIRE(bytes.size() == 8 + 4 + 2 * 4 + 3 * 8 + 4);
+
+    const auto written_scalar = scalar;
+    const auto written_fixed = fixed;
+    const auto written_variable = variable;
+    scalar = {0};
+    fixed = {0, 0, 0};
+    variable = {1, 2, 3, 4};
+    empty = {7};
+
+    bytes.push_back(0xAA);
+    REQUIRE(plan.read(bytes) == bytes.size() - 1);
+    REQUIRE(scalar == written_scalar);
+    REQUIRE(fixed == written_fixed);
+    REQUIRE(variable == written_variable);
+    REQUIRE(empty.empty());
+}
+
+TEST_CASE("Serialisation plan rejects short input", "[serialisation_plan]") {
+    std::vector<uint32_t> fixed{1, 2};
+    std::vector<uint8_t> variable;
+
+    serialisation_plan plan(false);
+    plan.add_fixed(fixed.data(), fixed.size());
+    plan.add_variable(variable);
+
+    REQUIRE_THROWS_AS(plan.read(std::vector<uint8_t>(7)), std::runtime_error);
+
+    // A count larger than the bytes that follow is caught before the vector is resized to it
+    std::vector<uint8_t> bytes(8 + 4);
+    bytes[8] = 0xFF;
+    bytes[9] = 0xFF;
+    REQUIRE_THROWS_AS(plan.read(bytes), std::runtime_error);
+    REQUIRE(variable.empty());
+}
+
+TEST_CASE("Serialisation plan writes strided sources in place of their fields", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+
+    std::vector<uint8_t> head{0x7F};
+    std::vector<uint16_t> fixed(4);
+    std::vector<uint16_t> variable{0xFFFF};
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(head.data(), head.size());
+    plan.add_fixed(fixed.data(), fixed.size());
+    plan.add_variable(variable);
+
+    // Two rows of two elements, each row padded to three, as a jit matrix may be
+    const std::vector<uint16_t> padded{0x0102, 0x0304, 0xDEAD, 0x0506, 0x0708, 0xDEAD};
+    const auto *data = reinterpret_cast<const uint8_t *>(padded.data());
+    const ptrdiff_t stride = 3 * sizeof(uint16_t);
+    const size_t bytes = padded.size() * sizeof(uint16_t);
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> expected;
+
+    SECTION("Fixed field") {
+        fixed = {0x0102, 0x0304, 0x0506, 0x0708};
+        plan.write(expected);
+        fixed.assign(4, 0);
+
+        const auto source = rows_source(1, data, bytes, 2, 2, 2, stride);
+        plan.write(out, {&source, 1});
+        CHECK(out == expected);
+        CHECK(fixed == std::vector<uint16_t>(4, 0));
+    }
+
+    SECTION("Variable field") {
+        variable = {0x0102, 0x0304, 0x0506, 0x0708};
+        plan.write(expected);
+        variable.clear();
+
+        const auto source = rows_source(2, data, bytes, 2, 2, 2, stride);
+        CHECK(plan.size({&source, 1}) == expected.size());
+        plan.write(out, {&source, 1});
+        CHECK(out == expected);
+    }
+
+    SECTION("Contiguous rows") {
+        variable = {0x0102, 0x0304, 0xDEAD, 0x0506, 0x0708, 0xDEAD};
+        plan.write(expected);
+
+        const auto source = rows_source(2, data, bytes, 3, 2, 2, stride);
+        plan.write(out, {&source, 1});
+        CHECK(out == expected);
+    }
+
+    SECTION("Two planes, planar") {
+        variable = {0x0102, 0x0506, 0x0304, 0x0708};
+        plan.write(expected);
+
+        auto source = rows_source(2, data, bytes, 1, 2, 4, stride);
+        source.planes = 2;
+        source.planar = true;
+        plan.write(out, {&source, 1});
+        CHECK(out == expected);
+    }
+
+    SECTION("A fixed field's source must fit it exactly") {
+        const auto source = rows_source(1, data, bytes, 3, 2, 2, stride);
+        CHECK_THROWS_AS(plan.write(out, {&source, 1}), std::runtime_error);
+    }
+
+    SECTION("A source must lie within its data") {
+        const auto source = rows_source(2, data, bytes, 3, 3, 2, stride);
+        CHECK_THROWS_AS(plan.write(out, {&source, 1}), std::runtime_error);
+        CHECK(out.empty());
+    }
+}
+
+TEST_CASE("Serialisation plan copies serialised sources as they are", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+    const size_t chunk_size = GENERATE(1, 3, 4096);
+
+    std::vector<uint8_t> head{0x7F};
+    std::vector<uint16_t> fixed{0x0102, 0x0304};
+    std::vector<uint32_t> variable{0x05060708, 0x090A0B0C, 0x0D0E0F10};
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(head.data(), head.size());
+    plan.add_fixed(fixed.data(), fixed.size());
+    plan.add_variable(variable);
+
+    std::vector<uint8_t> expected;
+    plan.write(expected);
+
+    // The elements of each field as written, less the count
+    const size_t variable_at = 1 + 4 + plan.prefix_size(2);
+    const std::vector<uint8_t> fixed_bytes(expected.begin() + 1, expected.begin() + 5);
+    const std::vector<uint8_t> variable_bytes(expected.begin() + static_cast<ptrdiff_t>(variable_at), expected.end());
+    CHECK(plan.prefix_size(1) == 0);
+
+    std::vector<serialisation_plan::strided_source> sources(2);
+    sources[0].field = 1;
+    sources[0].data = fixed_bytes.data();
+    sources[0].bytes = fixed_bytes.size();
+    sources[0].dim[0] = 2;
+    sources[0].stride[0] = 2;
+    sources[0].serialised = true;
+    sources[1].field = 2;
+    sources[1].data = variable_bytes.data();
+    sources[1].bytes = variable_bytes.size();
+    sources[1].dim[0] = 3;
+    sources[1].stride[0] = 4;
+    sources[1].serialised = true;
+
+    fixed.assign(2, 0);
+    variable.clear();
+
+    SECTION("Whole") {
+        std::vector<uint8_t> out;
+        plan.write(out, sources);
+        CHECK(out == expected);
+    }
+
+    SECTION("In chunks") {
+        std::vector<uint8_t> chunk(chunk_size);
+        std::vector<uint8_t> joined;
+        plan.write_chunked(chunk, [&](std::span<const uint8_t> piece) {
+            joined.insert(joined.end(), piece.begin(), piece.end());
+        }, sources);
+        CHECK(joined == expected);
+    }
+
+    SECTION("Read back into the fields") {
+        plan.read_elements(1, fixed_bytes);
+        plan.read_elements(2, variable_bytes);
+        CHECK(fixed == std::vector<uint16_t>{0x0102, 0x0304});
+        CHECK(variable == std::vector<uint32_t>{0x05060708, 0x090A0B0C, 0x0D0E0F10});
+        CHECK_THROWS_AS(plan.read_elements(1, variable_bytes), std::runtime_error);
+    }
+
+    SECTION("An empty field") {
+        sources[1].data = nullptr;
+        sources[1].bytes = 0;
+        sources[1].dim[0] = 0;
+        std::vector<uint8_t> out;
+        plan.write(out, sources);
+        CHECK(out.size() == variable_at);
+        CHECK(std::equal(out.begin(), out.begin() + 5, expected.begin()));
+    }
+}
+
+TEST_CASE("Serialisation plan writes in chunks what it writes whole", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+    const size_t chunk_size = GENERATE(1, 3, 7, 64, 4096);
+
+    std::vector<uint8_t> bytes{1, 2, 3};
+    std::vector<double> doubles{1.5, -2.25, 1e300};
+    std::vector<uint16_t> variable{0x0102, 0x0304, 0x0506};
+    std::vector<uint32_t> matrix_field;
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(bytes.data(), bytes.size());
+    plan.add_variable(variable);
+    plan.add_fixed(doubles.data(), doubles.size());
+    plan.add_variable(matrix_field);
+
+    // Three rows of five cells of one or two planes, rows padded and cells packed or padded
+    const size_t planes = GENERATE(1, 2);
+    const ptrdiff_t cell_stride = GENERATE(8, 12);
+    std::vector<uint32_t> padded(3 * 16);
+    for (size_t i = 0; i < padded.size(); ++i) {
+        padded[i] = static_cast<uint32_t>(i * 0x01010101u);
+    }
+    auto source = rows_source(3, reinterpret_cast<const uint8_t *>(padded.data()), padded.size() * 4, 5, 3, cell_stride, 64);
+    source.planes = planes;
+    source.planar = GENERATE(false, true);
+
+    std::vector<uint8_t> whole;
+    plan.write(whole, {&source, 1});
+
+    std::vector<uint8_t> chunk(chunk_size);
+    std::vector<uint8_t> joined;
+    size_t chunks = 0;
+    plan.write_chunked(chunk, [&](std::span<const uint8_t> piece) {
+        CHECK(piece.size() <= chunk_size);
+        joined.insert(joined.end(), piece.begin(), piece.end());
+        ++chunks;
+    }, {&source, 1});
+    CHECK(joined == whole);
+    CHECK(chunks == (whole.size() + chunk_size - 1) / chunk_size);
+}
+
+TEST_CASE("Serialisation plan reads a piece at a time what it reads whole", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+    const size_t piece_size = GENERATE(1, 2, 5, 13, 1000);
+
+    std::vector<int16_t> fixed{-1, 2, -3};
+    std::vector<double> variable{0.5, -1.5, 2.5, 1e-300};
+    std::vector<uint8_t> empty;
+    std::vector<uint32_t> last{0xDEADBEEF};
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(fixed.data(), fixed.size());
+    plan.add_variable(variable);
+    plan.add_variable(empty);
+    plan.add_fixed(last.data(), last.size());
+
+    std::vector<uint8_t> bytes;
+    plan.write(bytes);
+    fixed.assign(3, 0);
+    variable.clear();
+    last[0] = 0;
+
+    serialisation_plan::reader reader(plan, bytes.size());
+    for (size_t i = 0; i < bytes.size(); i += piece_size) {
+        CHECK_FALSE(reader.complete());
+        reader.feed(std::span(bytes).subspan(i, std::min(piece_size, bytes.size() - i)));
+    }
+    CHECK(reader.complete());
+    CHECK(reader.remaining() == 0);
+    CHECK(fixed == std::vector<int16_t>{-1, 2, -3});
+    CHECK(variable == std::vector<double>{0.5, -1.5, 2.5, 1e-300});
+    CHECK(empty.empty());
+    CHECK(last[0] == 0xDEADBEEF);
+}
+
+TEST_CASE("Serialisation plan readers check what they are fed", "[serialisation_plan]") {
+    std::vector<uint32_t> variable{1, 2, 3};
+    serialisation_plan plan(false);
+    plan.add_variable(variable);
+
+    std::vector<uint8_t> bytes;
+    plan.write(bytes);
+
+    SECTION("More than announced") {
+        serialisation_plan::reader reader(plan, bytes.size() - 1);
+        CHECK_THROWS_AS(reader.feed(bytes), std::runtime_error);
+    }
+    SECTION("A count larger than what is left to come") {
+        serialisation_plan::reader reader(plan, bytes.size() - 4);
+        CHECK_THROWS_AS(reader.feed(std::span(bytes).first(bytes.size() - 4)), std::runtime_error);
+    }
+}
+
+TEST_CASE("Serialisation plan patches single fields into a written record", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+
+    std::vector<uint8_t> head{1, 2};
+    std::vector<float> variable{1.0f, 2.0f};
+    std::vector<uint64_t> tail{3};
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(head.data(), head.size());
+    plan.add_variable(variable);
+    plan.add_fixed(tail.data(), tail.size());
+
+    std::vector<uint8_t> image;
+    plan.write(image);
+    CHECK(plan.field_size(0) == 2);
+    CHECK(plan.field_size(1) == 4 + 8);
+    CHECK(plan.field_size(2) == 8);
+
+    variable = {-5.5f, 0.25f};
+    tail[0] = 0x0102030405060708;
+    plan.write_field(1, image.data() + 2);
+    plan.write_field(2, image.data() + 2 + 12);
+
+    std::vector<uint8_t> expected;
+    plan.write(expected);
+    CHECK(image == expected);
+    CHECK_THROWS_AS(plan.write_field(3, image.data()), std::out_of_range);
+}
+
+TEST_CASE("Serialisation plan encodes varint fields", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+
+    std::vector<uint32_t> counters{0, 1, 127, 128, 300};
+    std::vector<int64_t> deltas{-1, 1, -64, 64, INT64_MIN};
+    std::vector<uint16_t> raw{0x0102};
+
+    serialisation_plan plan(swap);
+    plan.add_fixed(counters.data(), counters.size(), serialisation_plan::encoding::varint);
+    plan.add_variable(deltas, serialisation_plan::encoding::zigzag);
+    plan.add_fixed(raw.data(), raw.size());
+
+    std::vector<uint8_t> bytes;
+    plan.write(bytes);
+    const uint8_t prefix[4] = {5, 0, 0, 0};
+    std::vector<uint8_t> expected{0x00, 0x01, 0x7F, 0x80, 0x01, 0xAC, 0x02};
+    if (swap == (std::endian::native == std::endian::little)) {
+        expected.insert(expected.end(), std::rbegin(prefix), std::rend(prefix));
+    } else {
+        expected.insert(expected.end(), std::begin(prefix), std::end(prefix));
+    }
+    expected.insert(expected.end(), {0x01, 0x02, 0x7F, 0x80, 0x01});
+    expected.insert(expected.end(), 9, 0xFF);
+    expected.push_back(0x01);
+    const auto *raw_bytes = reinterpret_cast<const uint8_t *>(raw.data());
+    if (swap) {
+        expected.insert(expected.end(), {raw_bytes[1], raw_bytes[0]});
+    } else {
+        expected.insert(expected.end(), {raw_bytes[0], raw_bytes[1]});
+    }
+    CHECK(bytes == expected);
+    CHECK(plan.size() == bytes.size());
+    CHECK(plan.field_size(0) == 7);
+    CHECK(plan.field_size(1) == 4 + 15);
+
+    SECTION("Read whole") {
+        counters.assign(5, 0);
+        deltas.clear();
+        plan.read(bytes);
+        CHECK(counters == std::vector<uint32_t>{0, 1, 127, 128, 300});
+        CHECK(deltas == std::vector<int64_t>{-1, 1, -64, 64, INT64_MIN});
+    }
+
+    SECTION("Read a piece at a time") {
+        const size_t piece_size = GENERATE(1, 2, 3, 11, 100);
+        counters.assign(5, 0);
+        deltas.clear();
+        serialisation_plan::reader reader(plan, bytes.size());
+        for (size_t i = 0; i < bytes.size(); i += piece_size) {
+            reader.feed(std::span(bytes).subspan(i, std::min(piece_size, bytes.size() - i)));
+        }
+        CHECK(reader.complete());
+        CHECK(counters == std::vector<uint32_t>{0, 1, 127, 128, 300});
+        CHECK(deltas == std::vector<int64_t>{-1, 1, -64, 64, INT64_MIN});
+    }
+
+    SECTION("Write in chunks") {
+        std::vector<uint8_t> chunk(GENERATE(1, 4, 64));
+        std::vector<uint8_t> joined;
+        plan.write_chunked(chunk, [&](std::span<const uint8_t> piece) {
+            joined.insert(joined.end(), piece.begin(), piece.end());
+        });
+        CHECK(joined == bytes);
+    }
+
+    SECTION("Truncated and malformed input") {
+        CHECK_THROWS_AS(plan.read(std::span(bytes).first(3)), std::runtime_error);
+        std::vector<uint8_t> malformed(bytes.begin(), bytes.begin() + 7 + 4);
+        malformed.insert(malformed.end(), 12, 0xFF);
+        serialisation_plan::reader reader(plan, malformed.size());
+        CHECK_THROWS_AS(reader.feed(malformed), std::runtime_error);
+    }
+
+    SECTION("Varint fields can't take a source") {
+        const std::vector<uint32_t> data{1, 2, 3, 4, 5};
+        const auto source = rows_source(0, reinterpret_cast<const uint8_t *>(data.data()), 20, 5, 1, 4, 20);
+        CHECK_THROWS_AS(plan.write(bytes, {&source, 1}), std::runtime_error);
+    }
+
+    CHECK_THROWS_AS(plan.add_variable(raw, serialisation_plan::encoding::varint), std::invalid_argument);
+}
+
+TEST_CASE("Serialisation plan packs bit fields into groups", "[serialisation_plan]") {
+    const bool swap = GENERATE(false, true);
+    const bool big = native_big != swap;
+
+    std::vector<uint8_t> flag{1};
+    std::vector<uint8_t> mode{5};
+    std::vector<int8_t> offset{-3};
+    std::vector<uint16_t> levels{0xABC, 0x123};
+    std::vector<uint8_t> whole{0x55};
+    std::vector<uint8_t> steps{31, 1, 0};
+    std::vector<uint8_t> last{1};
+
+    serialisation_plan plan(swap);
+    plan.add_bit_field(flag.data(), 1, 1);
+    plan.add_bit_field(mode.data(), 1, 3);
+    plan.add_bit_field(offset.data(), 1, 4);
+    plan.add_bit_field(levels.data(), 2, 12);
+    plan.add_fixed(whole.data(), 1);
+    plan.add_bit_field(steps, 5);
+    plan.add_bit_field(last.data(), 1, 1);
+
+    // 1 101 1101 101010111100 000100100011, then 11111 00001 00000 1 after the count
+    const std::vector<uint8_t> expected = big
+        ? std::vector<uint8_t>{0xDD, 0xAB, 0xC1, 0x23, 0x55, 0, 0, 0, 3, 0xF8, 0x41}
+        : std::vector<uint8_t>{0xDB, 0xBC, 0x3A, 0x12, 0x55, 3, 0, 0, 0, 0x3F, 0x80};
+
+    std::vector<uint8_t> bytes;
+    plan.write(bytes);
+    CHECK(bytes == expected);
+    CHECK(plan.size() == expected.size());
+    CHECK(plan.field_size(0) == 4);
+    CHECK(plan.field_size(3) == 0);
+    CHECK(plan.field_size(5) == 4 + 2);
+    CHECK(plan.group_of(3) == 0);
+    CHECK(plan.group_of(4) == 4);
+    CHECK(plan.group_of(6) == 5);
+
+    const auto clear = [&] {
+        flag = {0};
+        mode = {0};
+        offset = {0};
+        levels = {0, 0};
+        whole = {0};
+        steps.clear();
+        last = {0};
+    };
+    const auto check_fields = [&] {
+        CHECK(flag == std::vector<uint8_t>{1});
+        CHECK(mode == std::vector<uint8_t>{5});
+        CHECK(offset == std::vector<int8_t>{-3});
+        CHECK(levels == std::vector<uint16_t>{0xABC, 0x123});
+        CHECK(whole == std::vector<uint8_t>{0x55});
+        CHECK(steps == std::vector<uint8_t>{31, 1, 0});
+        CHECK(last == std::vector<uint8_t>{1});
+    };
+
+    SECTION("Read whole") {
+        clear();
+        plan.read(bytes);
+        check_fields();
+    }
+
+    SECTION("Read a piece at a time") {
+        const size_t piece_size = GENERATE(1, 2, 3, 5, 100);
+        clear();
+        serialisation_plan::reader reader(plan, bytes.size());
+        for (size_t i = 0; i < bytes.size(); i += piece_size) {
+            reader.feed(std::span(bytes).subspan(i, std::min(piece_size, bytes.size() - i)));
+        }
+        CHECK(reader.complete());
+        check_fields();
+    }
+
+    SECTION("Write in chunks") {
+        std::vector<uint8_t> chunk(GENERATE(1, 3, 64));
+        std::vector<uint8_t> joined;
+        plan.write_chunked(chunk, [&](std::span<const uint8_t> piece) {
+            joined.insert(joined.end(), piece.begin(), piece.end());
+        });
+        CHECK(joined == bytes);
+    }
+
+    SECTION("Patching a field rewrites its group") {
+        levels[1] = 0xFFF;
+        plan.write_field(3, bytes.data());
+        std::vector<uint8_t> rewritten;
+        plan.write(rewritten);
+        CHECK(bytes == rewritten);
+    }
+
+    SECTION("Truncated input") {
+        CHECK_THROWS_AS(plan.read(std::span(bytes).first(3)), std::runtime_error);
+        CHECK_THROWS_AS(plan.read(std::span(bytes).first(bytes.size() - 1)), std::runtime_error);
+    }
+
+    SECTION("Bit fields can't take a source") {
+        const auto source = rows_source(0, flag.data(), 1, 1, 1, 1, 1);
+        CHECK_THROWS_AS(plan.write(bytes, {&source, 1}), std::runtime_error);
+    }
+
+    CHECK_THROWS_AS(plan.add_bit_field(flag.data(), 1, 9), std::invalid_argument);
+    CHECK_THROWS_AS(plan.add_bit_field(flag.data(), 1, 0), std::invalid_argument);
+}
@@ -2,6 +2,8 @@
 // Created by Obi Davis on 26/04/2024.
 //
 
+#include <random>
+#include <span>
 #include <vector>
 
 #include "catch2/catch_test_macros.hpp"
@@ -110,4 +112,105 @@ TEST_CASE("SLIP encoding and decoding", "[slip]") {
         REQUIRE(decoder.packet_complete());
         REQUIRE(decoded == data.decoded);
     }
-}
\ No newline at end of file
+
+    SECTION("Bulk decoding") {
+        const size_t chunk_size = GENERATE(1, 3, 64);
+        std::vector<uint8_t> stream(data.encoded.begin(), data.encoded.end());
+        stream.insert(stream.end(), data.encoded.begin(), data.encoded.end());
+
+        SLIPDecoder decoder;
+        std::vector<std::vector<int>> frames;
+        for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+            const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+            decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+                frames.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == data.decoded);
+        REQUIRE(frames[1] == data.decoded);
+    }
+}
+
+static std::vector<uint8_t> random_slip_payload(size_t size, int special_one_in, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> payload(size);
+    for (auto &byte : payload) {
+        byte = static_cast<uint8_t>(rng());
+        if (special_one_in && rng() % special_one_in == 0) {
+            constexpr uint8_t specials[] = {SLIP_END, SLIP_ESC, SLIP_ESC_END, SLIP_ESC_ESC};
+            byte = specials[rng() % 4];
+        }
+    }
+    return payload;
+}
+
+TEST_CASE("SLIP contiguous codec matches generic codec", "[slip]") {
+    const size_t size = GENERATE(0, 1, 15, 16, 17, 100, 4096);
+    const int special_one_in = GENERATE(0, 2, 300);
+    const auto payload = random_slip_payload(size, special_one_in, static_cast<unsigned>(size * 13 + special_one_in));
+
+    std::vector<uint8_t> expected(slip_encoded_max_length(size));
+    expected.resize(std::distance(expected.begin(), slip_encode_frame(payload.begin(), payload.end(), expected.begin())));
+
+    SECTION("Exact encoded length") {
+        REQUIRE(slip_encoded_length(payload) == expected.size());
+    }
+
+    SECTION("Encoding") {
+        std::vector<uint8_t> encoded(slip_encoded_length(payload));
+        encoded.resize(slip_encode_frame(payload, encoded.data()));
+        REQUIRE(encoded == expected);
+    }
+
+    SECTION("Decoding") {
+        std::vector<uint8_t> decoded(expected.size());
+        decoded.resize(slip_decode_frame(expected, decoded.data()));
+        REQUIRE(decoded == payload);
+    }
+
+    SECTION("Decoding arbitrary input, including stray escapes") {
+        std::vector<uint8_t> reference(payload.size());
+        reference.resize(std::distance(reference.begin(), slip_decode_frame(payload.begin(), payload.end(), reference.begin())));
+
+        std::vector<uint8_t> decoded(payload.size());
+        decoded.resize(slip_decode_frame(payload, decoded.data()));
+        REQUIRE(decoded == reference);
+    }
+
+    SECTION("Decoding in place") {
+        auto buffer = expected;
+        buffer.resize(slip_decode_frame(buffer, buffer.data()));
+        REQUIRE(buffer == payload);
+    }
+}
+
+TEST_CASE("SLIP decoder drops frames longer than the maximum", "[slip]") {
+    SLIPDecoder decoder;
+    decoder.set_max_frame_length(4);
+
+    const std::vector<uint8_t> fits{1, SLIP_END, SLIP_ESC, 2};
+    const std::vector<uint8_t> too_long{1, 2, 3, 4, SLIP_END};
+    std::vector<uint8_t> stream(2 * (2 * fits.size() + too_long.size()) + 3);
+    auto out = stream.begin();
+    out = slip_encode_frame(fits.begin(), fits.end(), out);
+    out = slip_encode_frame(too_long.begin(), too_long.end(), out);
+    out = slip_encode_frame(fits.begin(), fits.end(), out);
+    stream.erase(out, stream.end());
+
+    auto chunk_size = GENERATE(range(size_t{1}, size_t{8}));
+    std::vector<std::vector<uint8_t>> frames;
+    size_t dropped = 0;
+    for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+        const auto chunk = std::span(stream).subspan(offset, std::min(chunk_size, stream.size() - offset));
+        dropped += decoder.process(chunk, [&frames](std::span<const uint8_t> frame) {
+            frames.emplace_back(frame.begin(), frame.end());
+        });
+    }
+
+    REQUIRE(dropped == 1);
+    REQUIRE(frames.size() == 2);
+    REQUIRE(frames[0] == fits);
+    REQUIRE(frames[1] == fits);
+}
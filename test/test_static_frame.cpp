@@ -0,0 +1,77 @@
+#include <array>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+
+#include "COBS.hpp"
+#include "LEB128.hpp"
+#include "SLIP.hpp"
+#include "static_frame.hpp"
+
+namespace {
+
+constexpr auto start_payload = frame_bytes(0x01, 0x00, 0xC0, 0xDB, 0x02);
+
+// A full 254-byte block followed by a zero, the awkward case for COBS
+constexpr auto long_payload = [] {
+    std::array<uint8_t, 300> payload{};
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = i == 254 ? 0 : static_cast<uint8_t>(i % 255 + 1);
+    }
+    return payload;
+}();
+
+template <size_t N>
+std::vector<uint8_t> runtime_cobs(const std::array<uint8_t, N> &payload) {
+    std::vector<uint8_t> out(cobs_encoded_max_length(N));
+    out.resize(cobs_encode_frame(payload.begin(), N, out.begin()));
+    return out;
+}
+
+template <size_t N>
+std::vector<uint8_t> runtime_slip(const std::array<uint8_t, N> &payload) {
+    std::vector<uint8_t> out(2 * N + 1);
+    out.resize(slip_encode_frame(payload.begin(), N, out.begin()));
+    return out;
+}
+
+template <size_t N>
+std::vector<uint8_t> runtime_leb128(const std::array<uint8_t, N> &payload) {
+    std::vector<uint8_t> out(leb128_encoded_length(N));
+    out.resize(leb128_encode_frame(payload.begin(), N, out.begin()));
+    return out;
+}
+
+template <size_t N>
+std::vector<uint8_t> as_vector(const std::array<uint8_t, N> &frame) {
+    return {frame.begin(), frame.end()};
+}
+
+} // namespace
+
+static_assert(cobs_frame<frame_bytes(0x11, 0x00, 0x22)>() == frame_bytes(0x02, 0x11, 0x02, 0x22, 0x00));
+static_assert(slip_frame<frame_bytes(0xC0, 0x01)>() == frame_bytes(0xDB, 0xDC, 0x01, 0xC0));
+static_assert(leb128_frame<frame_bytes(0x05, 0x06)>() == frame_bytes(0x02, 0x05, 0x06));
+static_assert(cobs_frame<std::array<uint8_t, 0>{}>() == frame_bytes(0x01, 0x00));
+
+TEST_CASE("Compile-time frames are exactly the size of their encoding") {
+    STATIC_REQUIRE(cobs_frame<start_payload>().size() == 7);
+    STATIC_REQUIRE(slip_frame<start_payload>().size() == 8);
+    STATIC_REQUIRE(leb128_frame<start_payload>().size() == 6);
+    CHECK(cobs_frame<long_payload>().size() == cobs_encoded_length(long_payload));
+}
+
+TEST_CASE("Compile-time frames match the runtime encoders") {
+    SECTION("COBS") {
+        CHECK(as_vector(cobs_frame<start_payload>()) == runtime_cobs(start_payload));
+        CHECK(as_vector(cobs_frame<long_payload>()) == runtime_cobs(long_payload));
+    }
+    SECTION("SLIP") {
+        CHECK(as_vector(slip_frame<start_payload>()) == runtime_slip(start_payload));
+        CHECK(as_vector(slip_frame<long_payload>()) == runtime_slip(long_payload));
+    }
+    SECTION("LEB128") {
+        CHECK(as_vector(leb128_frame<start_payload>()) == runtime_leb128(start_payload));
+        CHECK(as_vector(leb128_frame<long_payload>()) == runtime_leb128(long_payload));
+    }
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "serialisation_plan.hpp"
+#include "strided_copy.hpp"
+
+namespace {
+
+// A matrix of cells of planes elements with padding after each cell and each row, filled with
+// distinct bytes, and its elements in row-major order as the copy should produce them
+struct padded_matrix {
+    std::vector<uint8_t> memory;
+    strided_source source;
+    std::vector<uint8_t> expected;
+
+    padded_matrix(std::vector<size_t> dims, size_t planes, size_t element_size, size_t cell_padding,
+                  size_t row_padding, bool planar, bool swap) {
+        source.dimcount = dims.size();
+        source.planes = planes;
+        source.planar = planar;
+        ptrdiff_t stride = static_cast<ptrdiff_t>(planes * element_size + cell_padding);
+        for (size_t d = 0; d < dims.size(); ++d) {
+            source.dim[d] = dims[d];
+            source.stride[d] = stride;
+            stride *= static_cast<ptrdiff_t>(dims[d]);
+            if (d == 0) {
+                stride += static_cast<ptrdiff_t>(row_padding);
+            }
+        }
+        memory.resize(static_cast<size_t>(stride));
+        for (size_t i = 0; i < memory.size(); ++i) {
+            memory[i] = static_cast<uint8_t>(i * 7 + 3);
+        }
+        source.data = memory.data();
+        source.bytes = memory.size();
+
+        const size_t cells = source.cells();
+        expected.resize(cells * planes * element_size);
+        std::vector<size_t> index(dims.size());
+        for (size_t cell = 0; cell < cells; ++cell) {
+            size_t remainder = cell;
+            ptrdiff_t offset = 0;
+            for (size_t d = 0; d < dims.size(); ++d) {
+                offset += static_cast<ptrdiff_t>(remainder % dims[d]) * source.stride[d];
+                remainder /= dims[d];
+            }
+            for (size_t p = 0; p < planes; ++p) {
+                const size_t element = planar ? p * cells + cell : cell * planes + p;
+                uint8_t *out = expected.data() + element * element_size;
+                std::memcpy(out, memory.data() + offset + p * element_size, element_size);
+                if (swap) {
+                    std::reverse(out, out + element_size);
+                }
+            }
+        }
+    }
+};
+
+template <size_t Size>
+std::vector<uint8_t> copy_out(const strided_source &source, bool swap) {
+    source.check(Size);
+    std::vector<uint8_t> out(source.count() * Size);
+    copy_strided(out.data(), source, Size, bytestream::detail::copy_elements_for<Size>(swap),
+                 bytestream::detail::deinterleave_elements_for<Size>(swap));
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("Strided copy matches an element by element copy", "[strided_copy]") {
+    const auto dims = GENERATE(std::vector<size_t>{37}, std::vector<size_t>{19, 5}, std::vector<size_t>{6, 4, 3});
+    const size_t planes = GENERATE(1, 3, 4);
+    const size_t cell_padding = GENERATE(0, 2);
+    const size_t row_padding = GENERATE(0, 16);
+    const bool planar = GENERATE(false, true);
+    const bool swap = GENERATE(false, true);
+
+    SECTION("1 byte elements") {
+        const padded_matrix m(dims, planes, 1, cell_padding, row_padding, planar, swap);
+        REQUIRE(copy_out<1>(m.source, swap) == m.expected);
+    }
+    SECTION("4 byte elements") {
+        const padded_matrix m(dims, planes, 4, cell_padding, row_padding, planar, swap);
+        REQUIRE(copy_out<4>(m.source, swap) == m.expected);
+    }
+    SECTION("8 byte elements") {
+        const padded_matrix m(dims, planes, 8, cell_padding, row_padding, planar, swap);
+        REQUIRE(copy_out<8>(m.source, swap) == m.expected);
+    }
+}
+
+TEST_CASE("Strided sources are bounds checked", "[strided_copy]") {
+    padded_matrix m({8, 4}, 4, 4, 0, 16, false, false);
+    REQUIRE_NOTHROW(m.source.check(4));
+
+    SECTION("Data shorter than the strides reach") {
+        m.source.bytes -= 1 + 16;
+        CHECK_THROWS_AS(m.source.check(4), std::runtime_error);
+    }
+    SECTION("Elements larger than the cells") {
+        CHECK_THROWS_AS(m.source.check(8), std::runtime_error);
+    }
+    SECTION("Too many dimensions") {
+        m.source.dimcount = strided_source::max_dims + 1;
+        CHECK_THROWS_AS(m.source.check(4), std::runtime_error);
+    }
+    SECTION("Element count overflows") {
+        m.source.dim[0] = SIZE_MAX / 2;
+        CHECK_THROWS_AS(m.source.check(4), std::runtime_error);
+    }
+    SECTION("Empty matrices need no data") {
+        m.source.dim[1] = 0;
+        m.source.data = nullptr;
+        m.source.bytes = 0;
+        CHECK_NOTHROW(m.source.check(4));
+        CHECK(m.source.count() == 0);
+    }
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "LEB128.hpp"
+#include "varint.hpp"
+
+namespace {
+
+// Values of every encoded length, with runs of small ones long enough for the vector path
+template <typename T>
+std::vector<T> mixed_values(size_t count) {
+    std::vector<T> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned shift = static_cast<unsigned>((i / 20) * 7 % (sizeof(T) * 8));
+        T value = static_cast<T>(i % 60 + (i % 3 ? 0 : (T{1} << shift)));
+        if constexpr (std::is_signed_v<T>) {
+            value = i % 2 ? static_cast<T>(-value) : value;
+        }
+        values[i] = value;
+    }
+    values.push_back(std::numeric_limits<T>::max());
+    values.push_back(std::numeric_limits<T>::min());
+    return values;
+}
+
+template <typename T, bool Zigzag>
+void check_round_trip() {
+    using namespace bytestream::detail;
+    const size_t count = GENERATE(0, 1, 15, 16, 17, 33, 100, 1000);
+    const auto values = mixed_values<T>(count);
+    const auto *src = reinterpret_cast<const uint8_t *>(values.data());
+
+    std::vector<uint8_t> encoded(values.size() * 10 + 1, 0xEE);
+    const uint8_t *end = encode_varints<T, Zigzag>(encoded.data(), src, values.size());
+    const auto length = static_cast<size_t>(end - encoded.data());
+    REQUIRE(length == varints_size<T, Zigzag>(src, values.size()));
+    REQUIRE(encoded[length] == 0xEE);
+
+    // Every value as the scalar LEB128 encoder writes it
+    std::vector<uint8_t> expected;
+    for (const T value : values) {
+        leb128_encode(varint_word<T, Zigzag>(value), std::back_inserter(expected));
+    }
+    encoded.resize(length);
+    REQUIRE(encoded == expected);
+
+    std::vector<T> decoded(values.size());
+    REQUIRE(decode_varints<T, Zigzag>(reinterpret_cast<uint8_t *>(decoded.data()), encoded.data(),
+                                      encoded.data() + encoded.size(), decoded.size())
+            == encoded.data() + encoded.size());
+    REQUIRE(decoded == values);
+
+    if (!encoded.empty()) {
+        REQUIRE(decode_varints<T, Zigzag>(reinterpret_cast<uint8_t *>(decoded.data()), encoded.data(),
+                                          encoded.data() + encoded.size() - 1, decoded.size()) == nullptr);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Varint arrays round trip", "[varint]") {
+    SECTION("v32") { check_round_trip<uint32_t, false>(); }
+    SECTION("v64") { check_round_trip<uint64_t, false>(); }
+    SECTION("z32") { check_round_trip<int32_t, true>(); }
+    SECTION("z64") { check_round_trip<int64_t, true>(); }
+}
+
+TEST_CASE("Zigzag encoding", "[varint]") {
+    using namespace bytestream::detail;
+    REQUIRE(zigzag_encode(int32_t{0}) == 0);
+    REQUIRE(zigzag_encode(int32_t{-1}) == 1);
+    REQUIRE(zigzag_encode(int32_t{1}) == 2);
+    REQUIRE(zigzag_encode(int32_t{-2}) == 3);
+    REQUIRE(zigzag_encode(std::numeric_limits<int32_t>::max()) == 0xFFFFFFFE);
+    REQUIRE(zigzag_encode(std::numeric_limits<int32_t>::min()) == 0xFFFFFFFF);
+    REQUIRE(zigzag_decode<int64_t>(zigzag_encode(int64_t{-123456789012})) == -123456789012);
+}
+
+TEST_CASE("Varint decoding rejects values too large for their type", "[varint]") {
+    using namespace bytestream::detail;
+    // 2^32 is five bytes but doesn't fit in 32 bits; eleven bytes don't fit in 64
+    const std::vector<uint8_t> too_wide{0x80, 0x80, 0x80, 0x80, 0x10, 0, 0, 0, 0, 0, 0};
+    uint32_t narrow;
+    REQUIRE(decode_varints<uint32_t, false>(reinterpret_cast<uint8_t *>(&narrow), too_wide.data(),
+                                            too_wide.data() + too_wide.size(), 1) == nullptr);
+    uint64_t wide;
+    REQUIRE(decode_varints<uint64_t, false>(reinterpret_cast<uint8_t *>(&wide), too_wide.data(),
+                                            too_wide.data() + too_wide.size(), 1) == too_wide.data() + 5);
+    REQUIRE(wide == uint64_t{1} << 32);
+
+    const std::vector<uint8_t> too_long(11, 0xFF);
+    REQUIRE(decode_varints<uint64_t, false>(reinterpret_cast<uint8_t *>(&wide), too_long.data(),
+                                            too_long.data() + too_long.size(), 1) == nullptr);
+}
@@ -0,0 +1,141 @@
+#include <array>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "COBS.hpp"
+#include "SLIP.hpp"
+#include "views.hpp"
+
+namespace views = bytestream::views;
+
+namespace {
+
+std::vector<uint8_t> random_payload(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> payload(size);
+    for (auto &byte : payload) {
+        // Plenty of zeros and SLIP specials, and long enough runs without them for full COBS blocks
+        switch (rng() % 8) {
+            case 0: byte = 0; break;
+            case 1: byte = rng() % 2 ? SLIP_END : SLIP_ESC; break;
+            default: byte = static_cast<uint8_t>(rng() % 255 + 1);
+        }
+    }
+    if (size > 600) {
+        std::fill_n(payload.begin() + 100, 500, 0x55);
+    }
+    return payload;
+}
+
+template <std::ranges::range R>
+std::vector<uint8_t> to_vector(R &&range) {
+    std::vector<uint8_t> out;
+    for (const auto byte : range) {
+        out.push_back(byte);
+    }
+    return out;
+}
+
+template <std::ranges::range R>
+std::vector<std::vector<uint8_t>> collect_frames(R &&frames) {
+    std::vector<std::vector<uint8_t>> out;
+    for (auto frame : frames) {
+        out.push_back(to_vector(frame));
+    }
+    return out;
+}
+
+constexpr bool constexpr_round_trip() {
+    constexpr std::array<uint8_t, 6> payload{0x11, 0x00, 0x22, SLIP_END, 0x00, SLIP_ESC};
+
+    std::array<uint8_t, cobs_encoded_max_length(payload.size())> expected{};
+    const auto expected_end = cobs_encode_frame(payload.begin(), payload.end(), expected.begin());
+    if (!std::ranges::equal(payload | views::cobs_encode, std::ranges::subrange(expected.begin(), expected_end))) {
+        return false;
+    }
+
+    auto cobs_frames = payload | views::cobs_encode | views::cobs_decode | views::split_frames;
+    auto slip_frames = payload | views::slip_encode | views::slip_decode | views::split_frames;
+    return std::ranges::equal(*cobs_frames.begin(), payload) && std::ranges::equal(*slip_frames.begin(), payload);
+}
+
+static_assert(constexpr_round_trip());
+static_assert(std::ranges::forward_range<decltype(std::declval<std::vector<uint8_t> &>() | views::cobs_decode)>);
+static_assert(std::ranges::forward_range<decltype(std::declval<std::vector<uint8_t> &>() | views::slip_encode)>);
+
+} // namespace
+
+TEST_CASE("COBS encoding view matches contiguous encoder", "[views]") {
+    const size_t size = GENERATE(0, 1, 253, 254, 255, 508, 2000);
+    const auto payload = random_payload(size, static_cast<unsigned>(size));
+
+    std::vector<uint8_t> expected(cobs_encoded_max_length(size));
+    expected.resize(cobs_encode_frame(payload, expected.data()));
+    REQUIRE(to_vector(payload | views::cobs_encode) == expected);
+
+    std::vector<uint8_t> no_zeros(size, 0x42);
+    expected.resize(cobs_encoded_max_length(size));
+    expected.resize(cobs_encode_frame(no_zeros, expected.data()));
+    REQUIRE(to_vector(no_zeros | views::cobs_encode) == expected);
+}
+
+TEST_CASE("SLIP encoding view matches contiguous encoder", "[views]") {
+    const size_t size = GENERATE(0, 1, 100, 2000);
+    const auto payload = random_payload(size, static_cast<unsigned>(size));
+
+    std::vector<uint8_t> expected(slip_encoded_length(payload));
+    slip_encode_frame(payload, expected.data());
+    REQUIRE(to_vector(payload | views::slip_encode) == expected);
+}
+
+TEST_CASE("Decoding views split a stream into frames", "[views]") {
+    std::vector<std::vector<uint8_t>> payloads;
+    for (const size_t size : {0, 1, 300, 700, 5}) {
+        payloads.push_back(random_payload(size, static_cast<unsigned>(size + 7)));
+    }
+
+    SECTION("COBS") {
+        // Encoded straight from the payloads, with no intermediate buffers
+        const auto stream = to_vector(payloads | std::views::transform(views::cobs_encode) | std::views::join);
+        REQUIRE(collect_frames(stream | views::cobs_decode | views::split_frames) == payloads);
+    }
+
+    SECTION("SLIP") {
+        const auto stream = to_vector(payloads | std::views::transform(views::slip_encode) | std::views::join);
+        REQUIRE(collect_frames(stream | views::slip_decode | views::split_frames) == payloads);
+    }
+}
+
+TEST_CASE("Decoding views drop corrupt and unfinished frames", "[views]") {
+    SECTION("COBS zero inside a block") {
+        const std::vector<uint8_t> stream{0x03, 0x11, 0x00, 0x02, 0x22, 0x00, 0x02, 0x33};
+        const auto frames = collect_frames(stream | views::cobs_decode | views::split_frames);
+        REQUIRE(frames == std::vector<std::vector<uint8_t>>{{0x22}});
+    }
+
+    SECTION("SLIP bad escape") {
+        const std::vector<uint8_t> stream{0x11, SLIP_ESC, 0x01, SLIP_END, 0x22, SLIP_END, 0x33};
+        const auto frames = collect_frames(stream | views::slip_decode | views::split_frames);
+        REQUIRE(frames == std::vector<std::vector<uint8_t>>{{0x22}});
+    }
+}
+
+TEST_CASE("Decoding views accept single-pass input", "[views]") {
+    std::istringstream input(std::string{0x03, 0x11, 0x22, 0x00});
+    auto bytes = std::views::istream<char>(input >> std::noskipws);
+
+    std::vector<views::frame_byte> decoded;
+    for (const auto element : bytes | views::cobs_decode) {
+        decoded.push_back(element);
+    }
+    REQUIRE(decoded == std::vector<views::frame_byte>{
+        {views::frame_byte::tag::data, 0x11},
+        {views::frame_byte::tag::data, 0x22},
+        {views::frame_byte::tag::end, 0},
+    });
+}
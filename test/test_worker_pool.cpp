@@ -0,0 +1,33 @@
+#include <atomic>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/generators/catch_generators.hpp"
+
+#include "worker_pool.hpp"
+
+TEST_CASE("Worker pool runs every piece once", "[worker_pool]") {
+    const size_t threads = GENERATE(1, 2, 4, 8);
+    worker_pool pool(threads);
+    REQUIRE(pool.size() == threads);
+
+    std::vector<std::atomic<int>> runs(1000);
+    pool.run(runs.size(), [&runs](size_t i) { runs[i].fetch_add(1, std::memory_order_relaxed); });
+    for (const auto &count : runs) {
+        CHECK(count.load() == 1);
+    }
+}
+
+// Jobs back to back, each a lambda on the stack that is gone once run() returns, so a worker still
+// holding the last one when the next starts shows up as a wrong count, or to TSan and ASan
+TEST_CASE("Worker pool jobs back to back", "[worker_pool]") {
+    worker_pool pool(8);
+    for (size_t job = 0; job < 20000; ++job) {
+        const size_t count = 2 + job % 7;
+        std::vector<std::atomic<size_t>> runs(count);
+        pool.run(count, [&runs, job](size_t i) { runs[i].fetch_add(job + 1, std::memory_order_relaxed); });
+        for (const auto &value : runs) {
+            REQUIRE(value.load() == job + 1);
+        }
+    }
+}